@@ -0,0 +1,2043 @@
+// ==========================================
+//           HEADLESS BENCHMARK SUITE
+// ==========================================
+// Drives the simulation core against generated desktops and prints one JSON
+// object per line, so two runs can be diffed between commits:
+//
+//   g++ -O2 -std=c++17 -pthread Bench.cpp -o bench        (Linux / MinGW)
+//   cl /O2 /std:c++17 /EHsc Bench.cpp                        (MSVC)
+//
+//   ./bench                 all cases
+//   ./bench occlusion       only cases whose name contains "occlusion"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Simulation.h"
+#include "Render.h"
+#include "FrameHandoff.h"
+#include "PixelKernels.h"
+#include "SpriteStore.h"
+#include "DesktopTrace.h"
+#include "Swarm.h"
+#include "WindowTable.h"
+#include "Compositor.h"
+#include "Scheduler.h"
+#include "TimerWheel.h"
+#include "SpriteConverter.h"
+
+// --- ALLOCATION COUNTER ---
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  // GCC can't tell these are the replacements
+#endif
+static std::atomic<unsigned long long> allocCount{0};
+
+// Every form that can be paired with free(): the nothrow ones too, since
+// library code (std::get_temporary_buffer in stable_sort) uses them
+static void* CountedAlloc(size_t size) noexcept {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new(size_t size) {
+    if (void* p = CountedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (void* p = CountedAlloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+// --- HARNESS ---
+static const char* filter = nullptr;
+static volatile long long sink = 0;   // Keeps results alive so the optimizer can't drop the work
+static int failures = 0;              // Correctness checks that failed; makes the exit code non-zero
+
+struct Param { const char* key; long long value; };
+
+// Runs fn(iterations) in growing batches until ~0.2 s has been spent, then
+// prints ns/op and allocations/op. Extra key/values describe the case.
+// Returns ns/op (0 if the case was filtered out).
+bool Selected(const std::string& name) {
+    return !filter || name.find(filter) != std::string::npos;
+}
+
+template <typename Fn>
+double Run(const std::string& name, std::vector<Param> params, Fn fn, const char* extra = nullptr) {
+    if (!Selected(name)) return 0;
+    typedef std::chrono::steady_clock Clock;
+
+    fn(1); // Warm-up: first-use allocations shouldn't count
+    long long iters = 1;
+    double seconds = 0;
+    unsigned long long allocs = 0;
+    while (true) {
+        unsigned long long a0 = allocCount.load();
+        Clock::time_point t0 = Clock::now();
+        fn(iters);
+        seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+        allocs = allocCount.load() - a0;
+        if (seconds > 0.2 || iters > (1ll << 40)) break;
+        iters *= (seconds < 0.02) ? 10 : 2;
+    }
+
+    printf("{\"name\":\"%s\"", name.c_str());
+    for (const auto& p : params) printf(",\"%s\":%lld", p.key, p.value);
+    printf(",\"iterations\":%lld,\"ns_per_op\":%.2f,\"allocs_per_op\":%.4f", iters, seconds * 1e9 / iters, (double)allocs / iters);
+    if (extra) printf(",%s", extra);
+    printf("}\n");
+    fflush(stdout);
+    return seconds * 1e9 / iters;
+}
+
+// --- DESKTOP GENERATOR ---
+enum MonitorLayout { LAYOUT_SINGLE, LAYOUT_DUAL, LAYOUT_GRID };
+
+std::vector<RectArea> MakeMonitors(MonitorLayout layout) {
+    switch (layout) {
+        case LAYOUT_DUAL: return { { 0, 0, 1920, 1040 }, { 1920, 0, 4480, 1400 } };
+        case LAYOUT_GRID: return { { 0, 0, 1920, 1040 }, { 1920, 0, 3840, 1040 },
+                                   { 0, 1080, 1920, 2120 }, { 1920, 1080, 3840, 2120 } };
+        default: return { { 0, 0, 1920, 1040 } };
+    }
+}
+
+// 'overlap' is the average number of windows stacked on any desktop pixel (x10)
+std::vector<RectArea> MakeWindows(const std::vector<RectArea>& monitors, int count, int overlap10, unsigned long long seed) {
+    Random rng(seed);
+    double area = 0;
+    for (const auto& m : monitors) area += (double)(m.right - m.left) * (m.bottom - m.top);
+    double each = area * overlap10 / 10.0 / (count > 0 ? count : 1);
+
+    std::vector<RectArea> windows;
+    for (int i = 0; i < count; i++) {
+        const RectArea& m = monitors[rng.Next((int)monitors.size())];
+        double aspect = 0.5 + rng.Next(1500) / 1000.0;
+        long w = (long)std::sqrt(each * aspect), h = (long)std::sqrt(each / aspect);
+        if (w < 200) w = 200;
+        if (h < 100) h = 100;
+        if (w > m.right - m.left) w = m.right - m.left;
+        if (h > m.bottom - m.top) h = m.bottom - m.top;
+        long x = m.left + rng.Next((int)(m.right - m.left - w + 1));
+        long y = m.top + rng.Next((int)(m.bottom - m.top - h + 1));
+        windows.push_back({ x, y, x + w, y + h });
+    }
+    return windows;
+}
+
+const char* LayoutName(MonitorLayout l) {
+    return l == LAYOUT_DUAL ? "dual" : (l == LAYOUT_GRID ? "grid" : "single");
+}
+
+// --- CASES ---
+// The linear scan IsPointObscured used before the spatial index, kept as the baseline
+bool LinearObscured(const std::vector<RectArea>& windows, int x, int y, int limit) {
+    int n = (limit == -1) ? (int)windows.size() : limit;
+    for (int i = 0; i < n; i++) {
+        const RectArea& r = windows[i];
+        if (x >= r.left && x <= r.right && y >= r.top && y <= r.bottom) return true;
+    }
+    return false;
+}
+
+void BenchOcclusion() {
+    std::vector<RectArea> monitors = MakeMonitors(LAYOUT_GRID);
+    for (int count : { 10, 100, 1000, 10000 }) {
+        std::vector<RectArea> windows = MakeWindows(monitors, count, 30, 1);
+        SpatialIndex index;
+        index.Build(windows, 1);
+
+        std::vector<PointXY> probes;
+        std::vector<int> limits;
+        Random rng(2);
+        for (int i = 0; i < 4096; i++) {
+            probes.push_back({ rng.Next(3840), rng.Next(2120) });
+            limits.push_back(rng.Next(count + 1) - 1);
+        }
+
+        std::vector<Param> params = { { "windows", count } };
+        Run("occlusion/linear", params, [&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; i++) {
+                const PointXY& p = probes[i & 4095];
+                hits += LinearObscured(windows, p.x, p.y, limits[i & 4095]);
+            }
+            sink += hits;
+        });
+        Run("occlusion/grid", params, [&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; i++) {
+                const PointXY& p = probes[i & 4095];
+                hits += index.IsCoveredAbove(p.x, p.y, limits[i & 4095]);
+            }
+            sink += hits;
+        });
+        Run("occlusion/grid_build", params, [&](long long n) {
+            for (long long i = 0; i < n; i++) index.Build(windows, i);
+        });
+
+        // The elevator check: topmost visible window top within reach of the feet
+        Run("support/linear_scan", params, [&](long long n) {
+            long long found = 0;
+            for (long long i = 0; i < n; i++) {
+                const PointXY& p = probes[i & 4095];
+                for (int w = 0; w < count; w++) {
+                    const RectArea& r = windows[w];
+                    if (p.x >= r.left && p.x <= r.right && p.y >= r.top - 5 && p.y <= r.top + 15 &&
+                        !index.IsCoveredAbove(p.x, r.top, w)) { found += w; break; }
+                }
+            }
+            sink += found;
+        });
+        WalkableMap walkable;
+        walkable.Build(windows, monitors, 1);
+        Run("support/walkable", params, [&](long long n) {
+            long long found = 0;
+            for (long long i = 0; i < n; i++) {
+                const PointXY& p = probes[i & 4095];
+                found += walkable.WindowSupport(p.x, p.y - 15, p.y + 5);
+            }
+            sink += found;
+        });
+    }
+}
+
+// Many probes at once against the column-wise window table, one point per
+// op, checked against the grid and the walkable map before timing
+void BenchBatchQueries() {
+    using namespace PixelKernels;
+    std::vector<RectArea> monitors = MakeMonitors(LAYOUT_GRID);
+    std::vector<Isa> isas = { ISA_SCALAR };
+    if (BestIsa() == ISA_AVX2) isas.push_back(ISA_AVX2);
+
+    for (int count : { 10, 100, 1000, 10000 }) {
+        std::vector<RectArea> windows = MakeWindows(monitors, count, 30, 1);
+        SpatialIndex index;
+        index.Build(windows, 1);
+        WalkableMap walkable;
+        walkable.Build(windows, monitors, 1);
+        WindowTable table;
+        table.Build(windows, 1);
+
+        // Head probes anywhere; foot probes near a random window's top
+        const int N = 4096;
+        std::vector<int> xs(N), ys(N), limits(N), footX(N), footMin(N), footMax(N);
+        Random rng(2);
+        for (int i = 0; i < N; i++) {
+            xs[i] = rng.Next(3840);
+            ys[i] = rng.Next(2120);
+            limits[i] = rng.Next(count + 1) - 1;
+            const RectArea& w = windows[rng.Next(count)];
+            footX[i] = (int)w.left + rng.Next((int)(w.right - w.left) + 1);
+            int y = (int)w.top - 10 + rng.Next(21);
+            footMin[i] = y - 15;
+            footMax[i] = y + 5;
+        }
+
+        std::vector<int> out(N);
+        std::vector<uint8_t> covered(N);
+        for (Isa isa : isas) {
+            int wrong = 0;
+            table.TopmostBatch(xs.data(), ys.data(), nullptr, N, out.data(), isa);
+            for (int i = 0; i < N; i++) wrong += out[i] != index.TopmostAt(xs[i], ys[i]);
+            table.CoverBatch(xs.data(), ys.data(), limits.data(), N, covered.data(), isa);
+            for (int i = 0; i < N; i++) wrong += (covered[i] != 0) != index.IsCoveredAbove(xs[i], ys[i], limits[i]);
+            table.SupportBatch(footX.data(), footMin.data(), footMax.data(), N, 10, out.data(), isa);
+            for (int i = 0; i < N; i++) {
+                int span = walkable.WindowSupport(footX[i], footMin[i], footMax[i], 10);
+                wrong += out[i] != (span == -1 ? -1 : walkable.spans[span].windowIndex);
+            }
+            if (wrong) {
+                failures++;
+                printf("{\"name\":\"query/check\",\"windows\":%d,\"isa\":\"%s\",\"mismatches\":%d}\n", count, IsaName(isa), wrong);
+            }
+        }
+
+        std::vector<Param> params = { { "windows", count }, { "points", N } };
+        double gridCover = Run("query/cover/grid", params, [&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; i++) hits += index.IsCoveredAbove(xs[i & (N - 1)], ys[i & (N - 1)], limits[i & (N - 1)]);
+            sink += hits;
+        });
+        double gridSupport = Run("query/support/walkable", params, [&](long long n) {
+            long long found = 0;
+            for (long long i = 0; i < n; i++) found += walkable.WindowSupport(footX[i & (N - 1)], footMin[i & (N - 1)], footMax[i & (N - 1)], 10);
+            sink += found;
+        });
+        for (Isa isa : isas) {
+            // n points as whole batches of up to N
+            double cover = Run(std::string("query/cover/batch_") + IsaName(isa), params, [&](long long n) {
+                for (long long done = 0; done < n; done += N) {
+                    int m = (int)(n - done < N ? n - done : N);
+                    table.CoverBatch(xs.data(), ys.data(), limits.data(), m, covered.data(), isa);
+                }
+                sink += covered[0];
+            });
+            double support = Run(std::string("query/support/batch_") + IsaName(isa), params, [&](long long n) {
+                for (long long done = 0; done < n; done += N) {
+                    int m = (int)(n - done < N ? n - done : N);
+                    table.SupportBatch(footX.data(), footMin.data(), footMax.data(), m, 10, out.data(), isa);
+                }
+                sink += out[0];
+            });
+            if (cover > 0 && support > 0 && gridCover > 0 && gridSupport > 0) {
+                printf("{\"name\":\"query/points_per_sec\",\"windows\":%d,\"isa\":\"%s\",\"cover_batch\":%.0f,\"cover_grid\":%.0f,"
+                       "\"support_batch\":%.0f,\"support_walkable\":%.0f}\n",
+                       count, IsaName(isa), 1e9 / cover, 1e9 / gridCover, 1e9 / support, 1e9 / gridSupport);
+                fflush(stdout);
+            }
+        }
+    }
+}
+
+void BenchJumpSearch() {
+    for (MonitorLayout layout : { LAYOUT_SINGLE, LAYOUT_GRID }) {
+        std::vector<RectArea> monitors = MakeMonitors(layout);
+        for (int count : { 10, 100, 500 }) {
+            std::vector<RectArea> windows = MakeWindows(monitors, count, 20, 3);
+            std::vector<Param> params = { { "windows", count }, { "monitors", (long long)monitors.size() } };
+
+            WalkableMap walkable;
+            walkable.Build(windows, monitors, 0);
+            Run(std::string("walkable/build/") + LayoutName(layout), params, [&](long long n) {
+                for (long long i = 0; i < n; i++) walkable.Build(windows, monitors, i);
+                sink += walkable.spans.size();
+            });
+
+            Run(std::string("ledges/full_rebuild/") + LayoutName(layout), params, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    LedgeGraph g;
+                    g.Update(windows, monitors, walkable);
+                    sink += g.ledges.size();
+                }
+            });
+
+            // One window dragged back and forth: the common case for incremental updates
+            // (includes the walkable rebuild the simulation does first)
+            LedgeGraph graph;
+            graph.Update(windows, monitors, walkable);
+            std::vector<RectArea> moved = windows;
+            Run(std::string("ledges/drag_one/") + LayoutName(layout), params, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    RectArea& r = moved[count / 2];
+                    long dx = (i & 1) ? 7 : -7;
+                    r.left += dx; r.right += dx;
+                    walkable.Build(moved, monitors, i);
+                    graph.Update(moved, monitors, walkable);
+                }
+                sink += graph.ledges.size();
+            });
+
+            LedgePlanner planner;
+            Random rng(4);
+            int ledgeCount = (int)graph.ledges.size();
+            Run(std::string("ledges/next_hop/") + LayoutName(layout), params, [&](long long n) {
+                long long found = 0;
+                int goal = rng.Next(ledgeCount);
+                for (long long i = 0; i < n; i++) found += planner.NextHop(graph, (int)(i % ledgeCount), goal);
+                sink += found;
+            });
+        }
+    }
+}
+
+void BenchSmartSize() {
+    ManualClock clock;
+    StaticEnvironment env;
+    env.monitors = MakeMonitors(LAYOUT_SINGLE);
+    Simulation sim(clock, env);
+    sim.UpdateEnvironment();
+    Run("render/smart_size", {}, [&](long long n) {
+        long long total = 0;
+        for (long long i = 0; i < n; i++) {
+            int w, h;
+            sim.GetSmartSize(16 + (int)(i & 127), 16 + (int)((i >> 3) & 255), w, h);
+            total += w + h;
+        }
+        sink += total;
+    });
+}
+
+// Per-frame bookkeeping of the render path without the pixel work: frame
+// cache lookups plus the compositor's diff and dirty-rect merging. Sprites
+// are 8x8 with no pixels, so clearing and blending cost next to nothing.
+void BenchRenderBookkeeping() {
+    FrameCache<int> cache;
+    for (int s = 0; s < STATE_COUNT; s++)
+        for (int f = 0; f < 4; f++)
+            for (int facing = 0; facing < 2; facing++)
+                cache.Insert({ s, f, facing == 1, 240, 135 }, s * 8 + f, 240 * 135 * 4);
+
+    std::vector<RectArea> monitors = MakeMonitors(LAYOUT_DUAL);
+    for (int count : { 1, 100, 1000 }) {
+        Compositor comp;
+        comp.SetMonitors(monitors);
+        Random rng(9);
+        std::vector<CompositeItem> items;
+        for (int i = 0; i < count; i++) items.push_back({ i, nullptr, 8, 8, rng.Next(4400), rng.Next(1400), 0 });
+        auto submit = [&]() {
+            comp.Begin();
+            for (const auto& it : items) comp.Add(it);
+            comp.End();
+        };
+        submit();
+        int changes = 1 + count / 10;
+        Run("render/frame_lookup_and_diff", { { "sprites", count }, { "changes", changes } }, [&](long long n) {
+            long long total = 0;
+            for (long long i = 0; i < n; i++) {
+                FrameKey key = { (int)(i >> 6) % STATE_COUNT, (int)(i >> 4) & 3, ((i >> 8) & 1) == 1, 240, 135 };
+                total += *cache.Find(key);
+                for (int k = 0; k < changes; k++) {
+                    CompositeItem& it = items[rng.Next(count)];
+                    it.x += rng.Next(9) - 4;
+                    it.content++;
+                }
+                submit();
+                total += comp.SurfaceDirty(0);
+            }
+            sink += total;
+        });
+    }
+}
+
+// Title rules: hand-picked overlaps and the rule file format, then random
+// rules and titles against one find() per rule in rule order
+int NaiveTitleMatch(const std::vector<TitleRule>& rules, std::wstring title) {
+    for (auto& c : title) c = (wchar_t)towlower(c);
+    for (size_t r = 0; r < rules.size(); r++) {
+        std::wstring p = rules[r].pattern;
+        for (auto& c : p) c = (wchar_t)towlower(c);
+        if (title.find(p) != std::wstring::npos) return (int)r;
+    }
+    return -1;
+}
+
+void CheckTitleMatcher() {
+    if (!Selected("title/check")) return;
+    int bad = 0, cases = 0;
+    TitleMatcher matcher;
+    auto expect = [&](const std::wstring& title, int rule) {
+        cases++;
+        if (matcher.Match(title) != rule) bad++;
+    };
+
+    // Suffixes and patterns inside patterns: only the failure links find "she" and "he" in "usher"
+    matcher.Build({ { L"hers", SITTING }, { L"she", IDLE }, { L"he", SLEEPING }, { L"his", WALKING } });
+    expect(L"usher", 1);
+    expect(L"hers", 0);
+    expect(L"ahe", 2);
+    expect(L"this", 3);
+    expect(L"hi", -1);
+    expect(L"", -1);
+    // First listed wins, wherever in the title it matches
+    matcher.Build({ { L"tube", SITTING }, { L"youtube", WATCHING_MOVIE }, { L"you", IDLE } });
+    expect(L"Cats - YouTube", 0);
+    expect(L"you and me", 2);
+    matcher.Build({ { L"youtube", WATCHING_MOVIE }, { L"tube", SITTING } });
+    expect(L"tube then youtube", 0);
+    expect(L"tubes", 1);
+    // Case-insensitive on both sides
+    matcher.Build({ { L"NetFlix", WATCHING_MOVIE } });
+    expect(L"Stranger Things | NETFLIX", 0);
+    expect(L"netflx", -1);
+    // Nothing to match
+    matcher.Build({});
+    expect(L"anything", -1);
+
+    // The rule file: comments, blank lines, '=' in a pattern, unknown states, CRLF
+    std::vector<TitleRule> parsed = ParseTitleRules(
+        L"# Movie night\r\n"
+        L"\r\n"
+        L"   \r\n"
+        L"  YouTube = watching_movie  \r\n"
+        L"a=b = SITTING\r\n"
+        L"netflix = DANCING\r\n"
+        L"= IDLE\r\n"
+        L"vlc # = SLEEPING\r\n"
+        L"mail = idle # after work\r\n"
+        L"last = Sleeping");
+    std::vector<TitleRule> want = { { L"YouTube", WATCHING_MOVIE }, { L"a=b", SITTING },
+                                    { L"mail", IDLE }, { L"last", SLEEPING } };
+    cases++;
+    if (parsed.size() != want.size()) bad++;
+    for (size_t i = 0; i < parsed.size() && i < want.size(); i++) {
+        if (parsed[i].pattern != want[i].pattern || parsed[i].state != want[i].state) { bad++; break; }
+    }
+
+    // Random: a small alphabet so patterns overlap, nest and repeat
+    Random rng(8);
+    const wchar_t alphabet[] = L"abcAB";
+    auto word = [&](int minLen, int maxLen) {
+        std::wstring w;
+        int len = minLen + rng.Next(maxLen - minLen + 1);
+        for (int k = 0; k < len; k++) w += alphabet[rng.Next(5)];
+        return w;
+    };
+    for (int round = 0; round < 2000; round++) {
+        std::vector<TitleRule> rules;
+        int count = 1 + rng.Next(20);
+        for (int r = 0; r < count; r++) rules.push_back({ word(1, 4), (State)rng.Next(STATE_COUNT) });
+        matcher.Build(rules);
+        for (int t = 0; t < 20; t++) {
+            std::wstring title = word(0, 30);
+            cases++;
+            if (matcher.Match(title) != NaiveTitleMatch(rules, title)) bad++;
+        }
+    }
+
+    if (bad) failures++;
+    printf("{\"name\":\"title/check\",\"cases\":%d,\"mismatches\":%d}\n", cases, bad);
+}
+
+void BenchTitles() {
+    CheckTitleMatcher();
+    const std::wstring titles[] = {
+        L"Desktop Walker - README.md - Visual Studio Code",
+        L"Funny Cats Compilation 2024 - YouTube - Google Chrome",
+        L"Inbox (3) - someone@example.com - Mail",
+        L"Stranger Things | Netflix - Mozilla Firefox",
+    };
+    for (int ruleCount : { 2, 50, 500 }) {
+        std::vector<TitleRule> rules = DefaultTitleRules();
+        Random rng(5);
+        while ((int)rules.size() < ruleCount) {
+            std::wstring p;
+            int len = 4 + rng.Next(8);
+            for (int k = 0; k < len; k++) p += (wchar_t)(L'a' + rng.Next(26));
+            rules.push_back({ p, SITTING });
+        }
+        TitleMatcher matcher;
+        matcher.Build(rules);
+        std::vector<Param> params = { { "rules", ruleCount } };
+
+        Run("title/aho_corasick", params, [&](long long n) {
+            long long total = 0;
+            for (long long i = 0; i < n; i++) total += matcher.Match(titles[i & 3]);
+            sink += total;
+        });
+        // What the old per-tick code did: copy, lowercase, one find() per pattern
+        Run("title/naive_find", params, [&](long long n) {
+            long long total = 0;
+            for (long long i = 0; i < n; i++) {
+                std::wstring t = titles[i & 3];
+                for (auto& c : t) c = (wchar_t)towlower(c);
+                for (size_t r = 0; r < rules.size(); r++) {
+                    if (t.find(rules[r].pattern) != std::wstring::npos) { total += (long long)r; break; }
+                }
+            }
+            sink += total;
+        });
+    }
+}
+
+// FNV-1a over the character state: same seed + same desktop must give the same value
+unsigned long long StateHash(const Simulation& sim) {
+    long long fields[] = { sim.posX, sim.posY, sim.velY, sim.targetX, sim.targetY,
+                           (long long)sim.currentState, sim.currentFrameIndex, sim.facingRight };
+    unsigned long long h = 1469598103934665603ull;
+    for (long long f : fields) { h ^= (unsigned long long)f; h *= 1099511628211ull; }
+    return h;
+}
+
+// Physics at different tick rates must follow the same path: a fall lands on
+// the same ledge within one tick of when it really gets there, a leap passes
+// through the same points, a walk covers the same distance
+struct TimestepRun {
+    int landY = -1, landIndex = -2;
+    unsigned long long landAt = 0;        // ms after the fall started
+    int leapX = 0, leapY = 0;             // 500 ms into the leap
+    unsigned long long arriveAt = 0;
+    int walked = 0;                       // px after 1000 ms
+};
+
+TimestepRun RunTimestep(int dt) {
+    ManualClock clock;
+    clock.time = 1000;
+    StaticEnvironment env;
+    env.monitors = { { 0, 0, 1920, 1080 } };
+    // Thin strips, each only a few pixels tall, stacked under the drop point. The
+    // top one is too narrow for the 10px landing inset, so the fall must pass it;
+    // at long ticks one step crosses both lower ones and must stop at the first.
+    env.windows = { { 940, 300, 959, 302 }, { 800, 420, 1100, 423 }, { 700, 700, 1200, 702 } };
+    Simulation sim(clock, env, 5);
+    sim.UpdateEnvironment();
+
+    TimestepRun run;
+    sim.posX = 950;
+    sim.posY = 100;
+    sim.Tick();   // The fall starts on the first tick
+    unsigned long long start = clock.time;
+    for (int i = 0; i < 5000 && sim.currentState == FALLING; i++) {
+        clock.Advance(dt);
+        sim.Tick();
+    }
+    run.landY = sim.posY;
+    run.landIndex = sim.walkable.SpanAt(sim.posX, sim.posY) == -1 ? -1
+                  : sim.walkable.spans[sim.walkable.SpanAt(sim.posX, sim.posY)].windowIndex;
+    run.landAt = clock.time - start;
+
+    sim.targetX = 1600;
+    sim.targetY = 1080;
+    sim.ChangeState(LEAPING, L"Test");
+    start = clock.time;
+    while (sim.currentState == LEAPING) {
+        clock.Advance(dt);
+        sim.Tick();
+        if (clock.time - start == 500) { run.leapX = sim.posX; run.leapY = sim.posY; }
+    }
+    run.arriveAt = clock.time - start;
+
+    sim.facingRight = false;
+    sim.ChangeState(WALKING, L"Test");
+    int x0 = sim.posX;
+    for (int t = 0; t < 1000; t += dt) {
+        clock.Advance(dt);
+        sim.Tick();
+    }
+    run.walked = x0 - sim.posX;
+    return run;
+}
+
+void CheckTimestep() {
+    if (!Selected("physics/timestep_check")) return;
+    // Exact times, straight from the closed forms
+    unsigned long long fallExact = 0, leapExact = 0;
+    while (100 + Motion::FallOffset(0, fallExact) / Motion::SUBPIXEL < 420) fallExact++;
+    long long ox, oy;
+    while (!Motion::LeapOffset(1600 - 950, 1080 - 420, leapExact, ox, oy)) leapExact++;
+    Motion::LeapOffset(1600 - 950, 1080 - 420, 500, ox, oy);
+    int leapX = 950 + (int)(ox / Motion::SUBPIXEL), leapY = 420 + (int)(oy / Motion::SUBPIXEL);
+    int walked = (int)(Config::WALK_SPEED * 1000 / Config::PHYSICS_STEP_MS);
+
+    int bad = 0, rates = 0;
+    for (int dt : { 1, 5, 10, 20, 25, 33, 50, 100, 125, 250, 500 }) {
+        TimestepRun r = RunTimestep(dt);
+        rates++;
+        bool ok = r.landY == 420 && r.landIndex == 1 &&
+                  r.landAt >= fallExact && r.landAt < fallExact + dt &&
+                  r.arriveAt >= leapExact && r.arriveAt < leapExact + dt;
+        // Only rates that actually sample the 500 ms / 1000 ms points
+        if (500 % dt == 0) ok = ok && r.leapX == leapX && r.leapY == leapY;
+        if (1000 % dt == 0) ok = ok && r.walked == walked;
+        if (!ok) {
+            bad++;
+            fprintf(stderr, "timestep %d ms: landed y=%d window=%d at %llu ms (exact %llu), "
+                    "leap (%d,%d) arrived %llu ms (exact %llu), walked %d (expected %d)\n",
+                    dt, r.landY, r.landIndex, r.landAt, fallExact, r.leapX, r.leapY, r.arriveAt, leapExact,
+                    r.walked, walked);
+        }
+    }
+    if (bad) failures++;
+    printf("{\"name\":\"physics/timestep_check\",\"tick_rates\":%d,\"mismatches\":%d}\n", rates, bad);
+}
+
+void BenchSimulation() {
+    CheckTimestep();
+
+    for (MonitorLayout layout : { LAYOUT_SINGLE, LAYOUT_DUAL, LAYOUT_GRID }) {
+        for (int count : { 10, 100, 1000 }) {
+            for (int overlap10 : { 5, 30 }) {
+                ManualClock clock;
+                StaticEnvironment env;
+                env.monitors = MakeMonitors(layout);
+                env.windows = MakeWindows(env.monitors, count, overlap10, 6);
+                const long long ticks = 30 * 60 * 10; // Ten minutes of game time
+
+                std::string name = std::string("sim/replay_10min/") + LayoutName(layout);
+                if (!Selected(name)) continue;
+
+                // Fixed-seed AI replay: ns per ten minutes plus a hash of where the character ended up
+                auto replay = [&]() {
+                    clock.time = 1000;
+                    Simulation sim(clock, env, 1234);
+                    for (int s = 0; s < STATE_COUNT; s++) sim.SetAnimation((State)s, 2, 200);
+                    sim.UpdateEnvironment();
+                    sim.PlaceOnFirstMonitor();
+                    for (long long t = 0; t < ticks; t++) {
+                        clock.Advance(Config::TICK_RATE);
+                        sim.Tick();
+                    }
+                    return StateHash(sim);
+                };
+                char extra[64];
+                snprintf(extra, sizeof(extra), "\"state_hash\":\"%016llx\"", replay());
+
+                std::vector<Param> params = { { "windows", count }, { "overlap_x10", overlap10 },
+                                              { "monitors", (long long)env.monitors.size() }, { "ticks", ticks } };
+                Run(name, params, [&](long long n) {
+                    for (long long i = 0; i < n; i++) sink += replay();
+                }, extra);
+            }
+        }
+    }
+
+    // Steady state: one tick on a desktop that never changes
+    ManualClock clock;
+    StaticEnvironment env;
+    env.monitors = MakeMonitors(LAYOUT_DUAL);
+    env.windows = MakeWindows(env.monitors, 100, 20, 7);
+    Simulation sim(clock, env, 99);
+    sim.UpdateEnvironment();
+    sim.PlaceOnFirstMonitor();
+    Run("sim/tick", { { "windows", 100 } }, [&](long long n) {
+        for (long long i = 0; i < n; i++) {
+            clock.Advance(Config::TICK_RATE);
+            sim.Tick();
+        }
+    });
+}
+
+// --- AI TIMERS ---
+// Random schedules, cancels and advances against a plain list: the same timers
+// fire on the same Advance, in time order, and NextDeadline/Pending agree
+void CheckTimerWheel() {
+    if (!Selected("ai/timer_wheel_check")) return;
+    struct Ref { unsigned long long deadline; int tag, handle; };
+    std::vector<Ref> ref;
+    std::vector<unsigned long long> deadlines;     // By tag
+    std::vector<int> fired;
+    Random rng(77);
+    unsigned long long now = 5000;
+    TimerWheel wheel(now);
+    int bad = 0, advances = 0, total = 0;
+    for (int step = 0; step < 300000; step++) {
+        int op = rng.Next(10);
+        if (op < 5) {
+            // Near, mid, far, beyond the top level, already overdue
+            static const unsigned long long spans[] = { 70, 5000, 300000, 40000000 };
+            int kind = rng.Next(5);
+            unsigned long long base = wheel.Now();
+            unsigned long long d = kind < 4 ? base + rng.Next((int)spans[kind]) : base - rng.Next(50);
+            int tag = (int)deadlines.size();
+            deadlines.push_back(d);
+            ref.push_back({ d, tag, wheel.Schedule(d, tag) });
+        } else if (op < 7) {
+            if (ref.empty()) continue;
+            int i = rng.Next((int)ref.size());
+            wheel.Cancel(ref[i].handle);
+            ref[i] = ref.back();
+            ref.pop_back();
+        } else {
+            now += (op == 9 && rng.Next(20) == 0) ? 1000000 + rng.Next(30000000) : rng.Next(2000);
+            fired.clear();
+            total += wheel.Advance(now, [&](int tag, int) { fired.push_back(tag); });
+            advances++;
+            size_t expected = 0;
+            for (size_t i = 0; i < ref.size(); ) {
+                if (ref[i].deadline <= now) { expected++; ref[i] = ref.back(); ref.pop_back(); }
+                else i++;
+            }
+            if (fired.size() != expected) bad++;
+            for (size_t i = 0; i < fired.size(); i++) {
+                if (deadlines[fired[i]] > now || (i > 0 && deadlines[fired[i]] < deadlines[fired[i - 1]])) { bad++; break; }
+            }
+        }
+        unsigned long long next = ~0ull;
+        for (const Ref& r : ref) next = r.deadline < next ? r.deadline : next;
+        if (wheel.NextDeadline() != next || wheel.Pending() != (int)ref.size()) bad++;
+    }
+    if (bad) failures++;
+    printf("{\"name\":\"ai/timer_wheel_check\",\"advances\":%d,\"fired\":%d,\"mismatches\":%d}\n", advances, total, bad);
+}
+
+// One 33 ms Advance with 'pending' timers spread over the next minute; every
+// one that fires is scheduled again
+void BenchTimerWheel() {
+    for (int pending : { 16, 1024, 65536 }) {
+        Random rng(3);
+        unsigned long long now = 1000;
+        TimerWheel wheel(now);
+        for (int i = 0; i < pending; i++) wheel.Schedule(now + 1 + rng.Next(60000), i);
+        char extra[64];
+        snprintf(extra, sizeof(extra), "\"fired_per_advance\":%.2f", pending * (double)Config::TICK_RATE / 30000.0);
+        Run("ai/timer_wheel", { { "pending", pending } }, [&](long long n) {
+            for (long long i = 0; i < n; i++) {
+                now += Config::TICK_RATE;
+                sink += wheel.Advance(now, [&](int tag, int) { wheel.Schedule(now + 1 + rng.Next(60000), tag); });
+            }
+        }, extra);
+    }
+}
+
+// Kolmogorov-Smirnov distance between observed roll counts and the geometric
+// distribution with per-roll chance p
+double GeometricKS(std::vector<unsigned long long> rolls, double p) {
+    std::sort(rolls.begin(), rolls.end());
+    double n = (double)rolls.size(), d = 0;
+    for (size_t i = 0; i < rolls.size(); ) {
+        size_t j = i;
+        while (j < rolls.size() && rolls[j] == rolls[i]) j++;
+        double below = 1 - std::pow(1 - p, (double)rolls[i] - 1), at = 1 - std::pow(1 - p, (double)rolls[i]);
+        d = std::max(d, std::max(std::fabs(i / n - below), std::fabs(j / n - at)));
+        i = j;
+    }
+    return d;
+}
+
+// The AI draws each dwell once instead of rolling every tick. Run the character
+// for a long time on a desktop with nothing to jump to and a floor too wide to
+// walk off, ticking when the scheduler says, and check every dwell against the
+// geometric distribution the per-tick thresholds define.
+void CheckDwellTimes() {
+    if (!Selected("ai/dwell_check")) return;
+    ManualClock clock;
+    clock.time = 1000;
+    StaticEnvironment env;
+    env.monitors = { { 0, 0, 4000000, 1080 } };
+    Simulation sim(clock, env, 2024);
+    for (int s = 0; s < STATE_COUNT; s++) sim.SetAnimation((State)s, 2, 1000);
+    sim.UpdateEnvironment();
+    sim.PlaceOnFirstMonitor();
+    TickScheduler scheduler;
+
+    struct Dwell { State state; int chance, outOf; bool gated; std::vector<unsigned long long> rolls; };
+    Dwell dwells[] = { { IDLE, Config::THRESH_IDLE_TO_SLEEP, 10000, true, {} },
+                       { WALKING, Config::CHANCE_STOP_WALKING, 10000, true, {} },
+                       { SITTING, Config::CHANCE_STAND_UP, 10000, true, {} },
+                       { SLEEPING, Config::CHANCE_WAKE_UP, 10000, true, {} },
+                       { PREPARE_JUMP, 1, 15, false, {} } };
+    Dwell& sleeping = dwells[3];
+    int exits[STATE_COUNT] = { 0 };
+    unsigned long long ticks = 0;
+    State state = sim.currentState;
+    unsigned long long since = clock.time;
+    while (sleeping.rolls.size() < 400 && ticks < 20000000) {
+        clock.Advance(scheduler.NextDelay(sim.currentState, clock.time, sim.NextFrameDeadline(), sim.NextAIDeadline()));
+        sim.Tick();
+        ticks++;
+        if (sim.currentState == state) continue;
+        // A roll every TICK_RATE from the gate on; the first one at the gate
+        unsigned long long rolls = (clock.time - since - Config::MIN_STATE_TIME) / Config::TICK_RATE + 1;
+        for (Dwell& d : dwells) if (d.state == state) d.rolls.push_back(rolls);
+        if (state == IDLE) exits[sim.currentState]++;
+        state = sim.currentState;
+        since = clock.time;
+    }
+    unsigned long long simMs = clock.time - 1000, wakeups = sim.aiWakeups;
+
+    // PREPARE_JUMP never happens here: start it by hand, at the full tick rate
+    for (int i = 0; i < 3000; i++) {
+        sim.targetX = sim.posX + 100;
+        sim.targetY = sim.posY;
+        sim.ChangeState(PREPARE_JUMP, L"Test");
+        since = clock.time;
+        while (sim.currentState == PREPARE_JUMP) {
+            clock.Advance(Config::TICK_RATE);
+            sim.Tick();
+        }
+        dwells[4].rolls.push_back((clock.time - since) / Config::TICK_RATE);
+    }
+
+    int bad = 0;
+    for (Dwell& d : dwells) {
+        double p = (double)d.chance / d.outOf, n = (double)d.rolls.size(), mean = 0;
+        for (unsigned long long r : d.rolls) mean += (double)r / n;
+        double ks = GeometricKS(d.rolls, p), limit = 1.63 / std::sqrt(n);   // 1% significance
+        bool ok = n >= 100 && ks < limit;
+        if (!ok) bad++;
+        printf("{\"name\":\"ai/dwell_check\",\"state\":\"%ls\",\"samples\":%.0f,\"mean_rolls\":%.1f,"
+               "\"expected_mean_rolls\":%.1f,\"ks\":%.4f,\"ks_limit\":%.4f,\"ok\":%s}\n",
+               GetStateName(d.state).c_str(), n, mean, 1 / p, ks, limit, ok ? "true" : "false");
+    }
+
+    // Which way IDLE went: walk, sit and sleep in the thresholds' proportions
+    int walk = exits[WALKING], sit = exits[SITTING], sleep = exits[SLEEPING];
+    double total = walk + sit + sleep, chi2 = 0;
+    double expect[] = { total * Config::THRESH_IDLE_TO_WALK / Config::THRESH_IDLE_TO_SLEEP,
+                        total * (Config::THRESH_IDLE_TO_SIT - Config::THRESH_IDLE_TO_WALK) / Config::THRESH_IDLE_TO_SLEEP,
+                        total * (Config::THRESH_IDLE_TO_SLEEP - Config::THRESH_IDLE_TO_SIT) / Config::THRESH_IDLE_TO_SLEEP };
+    int seen[] = { walk, sit, sleep };
+    for (int i = 0; i < 3; i++) chi2 += (seen[i] - expect[i]) * (seen[i] - expect[i]) / expect[i];
+    bool mixOk = chi2 < 9.21;   // 2 degrees of freedom, 1% significance
+    if (!mixOk) bad++;
+    printf("{\"name\":\"ai/dwell_check\",\"state\":\"IDLE exits\",\"walk\":%d,\"sit\":%d,\"sleep\":%d,"
+           "\"chi2\":%.2f,\"chi2_limit\":9.21,\"ok\":%s}\n", walk, sit, sleep, chi2, mixOk ? "true" : "false");
+    printf("{\"name\":\"ai/dwell_check\",\"sim_hours\":%.1f,\"ticks\":%llu,\"ai_wakeups\":%llu,\"failed\":%d}\n",
+           simMs / 3600000.0, ticks, wakeups, bad);
+    if (bad) failures++;
+}
+
+void BenchAI() {
+    CheckTimerWheel();
+    BenchTimerWheel();
+    CheckDwellTimes();
+}
+
+// --- DESKTOP TRACE ---
+// A synthetic session recorded the way Main.cpp records a real one: drags,
+// z-order changes, windows opening and closing, title switches, idle stretches
+std::vector<uint8_t> RecordSession(long long ticks, unsigned long long& finalHash) {
+    ManualClock clock;
+    clock.time = 5000;
+    StaticEnvironment desk;
+    desk.monitors = MakeMonitors(LAYOUT_DUAL);
+    desk.windows = MakeWindows(desk.monitors, 120, 20, 11);
+    TraceRecorder recorder(desk);
+    Simulation sim(clock, recorder, 4242);
+    recorder.Start(4242, clock.time);
+
+    recorder.EnvironmentUpdate();
+    sim.UpdateEnvironment();
+    recorder.Place();
+    sim.PlaceOnFirstMonitor();
+    std::vector<TitleRule> rules = { { L"youtube", WATCHING_MOVIE }, { L"vlc", WATCHING_MOVIE }, { L"word", SITTING } };
+    recorder.TitleRules(rules);
+    sim.SetTitleRules(rules);
+    for (int s = 0; s < STATE_COUNT; s++) {
+        recorder.Animation((State)s, 4, 150);
+        sim.SetAnimation((State)s, 4, 150);
+    }
+
+    const wchar_t* titles[] = { L"Inbox - Mail", L"YouTube - Cats", L"report.docx - Word", L"Terminal" };
+    Random rng(99);
+    int dragging = -1, dragLeft = 0, dragDx = 0, dragDy = 0;
+    auto event = [&](WindowEventType type) { recorder.WindowEvent(type); sim.windowCache.OnWindowEvent(type); };
+    for (long long t = 0; t < ticks; t++) {
+        // Between ticks: whatever the hooks would have reported
+        if (dragging == -1 && rng.Next(200) == 0) {
+            dragging = rng.Next((int)desk.windows.size());
+            dragLeft = 20 + rng.Next(60);
+            dragDx = rng.Next(21) - 10;
+            dragDy = rng.Next(11) - 5;
+        }
+        if (dragging != -1) {
+            RectArea& w = desk.windows[dragging];
+            w.left += dragDx; w.right += dragDx; w.top += dragDy; w.bottom += dragDy;
+            event(WINDOW_MOVED);
+            if (--dragLeft == 0) dragging = -1;
+        }
+        if (rng.Next(300) == 0 && dragging == -1) {
+            int i = rng.Next((int)desk.windows.size());
+            RectArea w = desk.windows[i];
+            desk.windows.erase(desk.windows.begin() + i);
+            desk.windows.insert(desk.windows.begin(), w);
+            event(WINDOW_ZORDER);
+        }
+        if (rng.Next(900) == 0 && dragging == -1) {
+            if (rng.Next(2) == 0 && desk.windows.size() > 10) {
+                desk.windows.erase(desk.windows.begin() + rng.Next((int)desk.windows.size()));
+                event(WINDOW_DESTROYED);
+            } else {
+                std::vector<RectArea> one = MakeWindows(desk.monitors, 1, 20, (unsigned long long)t);
+                desk.windows.insert(desk.windows.begin(), one[0]);
+                event(WINDOW_CREATED);
+            }
+        }
+        if (rng.Next(1500) == 0) {
+            desk.title = titles[rng.Next(4)];
+            recorder.TitleEvent();
+            sim.OnTitleChanged();
+        }
+
+        // Idle stretches tick slower, like the scheduler does
+        clock.Advance(dragging != -1 || sim.currentState == FALLING || sim.currentState == LEAPING ||
+                      sim.currentState == WALKING ? Config::TICK_RATE : 33 + rng.Next(220));
+        recorder.Tick(clock.time);
+        sim.Tick();
+        recorder.Checkpoint(sim);
+    }
+    finalHash = StateHash(sim);
+    return recorder.Data();
+}
+
+// Replays a trace from start to end; false if it was damaged
+bool ReplayTrace(TraceReplayer& replayer, unsigned long long& hash) {
+    ManualClock clock;
+    clock.time = replayer.StartTime();
+    Simulation sim(clock, replayer, replayer.Seed());
+    while (replayer.Step(sim, clock)) {}
+    hash = StateHash(sim);
+    return !replayer.corrupt;
+}
+
+void BenchTrace() {
+    if (!Selected("trace/")) return;
+    const long long ticks = 30 * 60 * 30;   // Half an hour at full rate, fewer wall ticks when idle
+    unsigned long long recordedHash = 0;
+    std::vector<uint8_t> trace = RecordSession(ticks, recordedHash);
+
+    TraceReplayer replayer;
+    unsigned long long replayedHash = 0;
+    bool ok = replayer.Attach(trace) && ReplayTrace(replayer, replayedHash);
+    ok = ok && replayer.ticks == (unsigned long long)ticks && replayer.divergedTicks == 0 && replayedHash == recordedHash;
+
+    // A damaged trace must be reported, not crash the replayer
+    std::vector<uint8_t> cut(trace.begin(), trace.begin() + trace.size() / 2);
+    cut.push_back(0xFF);
+    TraceReplayer damaged;
+    unsigned long long ignored;
+    bool caught = damaged.Attach(cut) && !ReplayTrace(damaged, ignored);
+    if (!ok || !caught) failures++;
+
+    char extra[256];
+    snprintf(extra, sizeof(extra), "\"bytes\":%zu,\"bytes_per_tick\":%.2f,\"replayed_ticks\":%llu,"
+             "\"diverged_ticks\":%llu,\"hash_match\":%s,\"damage_detected\":%s",
+             trace.size(), (double)trace.size() / ticks, replayer.ticks, replayer.divergedTicks,
+             replayedHash == recordedHash ? "true" : "false", caught ? "true" : "false");
+    Run("trace/replay", { { "ticks", ticks }, { "windows", 120 } }, [&](long long n) {
+        for (long long i = 0; i < n; i++) {
+            TraceReplayer r;
+            r.Attach(trace);
+            unsigned long long h;
+            ReplayTrace(r, h);
+            sink += h;
+        }
+    }, extra);
+}
+
+// --trace=<file>: replay a recorded session (Main.cpp --record) as regression test and workload
+int ReplayFile(const char* path) {
+    TraceReplayer replayer;
+    if (!replayer.Load(path)) {
+        fprintf(stderr, "%s: not a desktop trace\n", path);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    unsigned long long hash = 0;
+    bool ok = ReplayTrace(replayer, hash);
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("{\"name\":\"trace/file\",\"path\":\"%s\",\"bytes\":%zu,\"ticks\":%llu,\"ns_per_tick\":%.2f,"
+           "\"diverged_ticks\":%llu,\"first_divergence\":%llu,\"corrupt\":%s,\"state_hash\":\"%016llx\"}\n",
+           path, replayer.Bytes(), replayer.ticks, replayer.ticks ? ns / replayer.ticks : 0.0,
+           replayer.divergedTicks, replayer.firstDivergence, ok ? "false" : "true", hash);
+    return (ok && replayer.divergedTicks == 0) ? 0 : 1;
+}
+
+// --write-trace=<file>: the synthetic session above, for trying --trace without Windows
+int WriteSampleTrace(const char* path) {
+    unsigned long long hash;
+    std::vector<uint8_t> trace = RecordSession(30 * 60 * 30, hash);
+    FILE* f = fopen(path, "wb");
+    if (!f) return 1;
+    fwrite(trace.data(), 1, trace.size(), f);
+    fclose(f);
+    return 0;
+}
+
+// --- WINDOW CARRY ---
+// The window under the character is dragged fast (up to ~100 px per 33 ms
+// tick) while the session is recorded, then the trace is replayed. The
+// character has to ride along at every tick rate, with platform ids or
+// without, and when move events arrive less often than ticks (velocity
+// prediction in between). 'lag' is how far the feet were from where the
+// window really was at that tick.
+struct CarryRun {
+    long long dragTicks = 0, falls = 0, maxLag = 0, totalLag = 0;
+    unsigned long long carried = 0, predicted = 0, byShape = 0;
+    bool onCarrier = false;
+};
+
+// Straight flicks between waypoints, 250 ms each: up to ~60 px per 33 ms tick
+RectArea DragPath(long long t) {
+    static const long points[][2] = { { 300, 500 }, { 550, 300 }, { 100, 700 }, { 500, 650 }, { 300, 300 }, { 50, 550 } };
+    const int count = 6, segment = 250;
+    long long k = t / segment;
+    const long* a = points[k % count];
+    const long* b = points[(k + 1) % count];
+    double f = (double)(t % segment) / segment;
+    long left = a[0] + (long)std::lround((b[0] - a[0]) * f);
+    long top = a[1] + (long)std::lround((b[1] - a[1]) * f);
+    return { left, top, left + 1300, top + 300 };
+}
+
+const int CARRY_START_X = 950, CARRY_START_Y = 400;     // Dropped onto the carrier from here
+
+std::vector<uint8_t> RecordDrag(int tickMs, int eventMs, bool platformIds, CarryRun& run, unsigned long long& hash) {
+    ManualClock clock;
+    clock.time = 1000;
+    StaticEnvironment desk;
+    desk.monitors = MakeMonitors(LAYOUT_SINGLE);
+    // The carrier on top, a few windows far enough below that nothing is in jump range
+    desk.windows = { DragPath(0), { 0, 960, 700, 1040 }, { 800, 970, 1500, 1040 }, { 1500, 955, 1920, 1040 } };
+    if (platformIds) desk.windowIds = { 0x30a2e, 0x1c04f6, 0x2b0310, 0x50462 };
+    TraceRecorder recorder(desk);
+    Simulation sim(clock, recorder, 77);
+    recorder.Start(77, clock.time);
+    recorder.EnvironmentUpdate();
+    sim.UpdateEnvironment();
+    for (int s = 0; s < STATE_COUNT; s++) {
+        recorder.Animation((State)s, 4, 150);
+        sim.SetAnimation((State)s, 4, 150);
+    }
+    sim.posX = CARRY_START_X;
+    sim.posY = CARRY_START_Y;
+
+    auto tick = [&]() {
+        recorder.Tick(clock.time);
+        sim.Tick();
+        recorder.Checkpoint(sim);
+    };
+    // Land on it first
+    for (int t = 0; t < 1000; t += tickMs) {
+        clock.Advance(tickMs);
+        tick();
+    }
+
+    const long long dragMs = 6000;
+    bool wasOn = true;
+    for (long long t = 1; t <= dragMs; t++) {
+        clock.Advance(1);
+        if (t % eventMs == 0 || t == dragMs) {
+            desk.windows[0] = DragPath(t);
+            recorder.WindowEvent(WINDOW_MOVED);
+            sim.windowCache.OnWindowEvent(WINDOW_MOVED);
+        }
+        if (t % tickMs) continue;
+        tick();
+        run.dragTicks++;
+        RectArea truth = DragPath(t);
+        bool on = sim.posX >= truth.left && sim.posX <= truth.right;
+        if (sim.currentState == FALLING || !on) {
+            if (wasOn) run.falls++;
+            wasOn = false;
+            continue;
+        }
+        wasOn = true;
+        long long lag = std::llabs((long long)sim.posY - truth.top);
+        if (lag > run.maxLag) run.maxLag = lag;
+        run.totalLag += lag;
+    }
+    // The drag ends (MOVESIZEEND on Win32), then one more tick
+    clock.Advance(tickMs);
+    recorder.WindowEvent(WINDOW_MOVED);
+    sim.windowCache.OnWindowEvent(WINDOW_MOVED);
+    tick();
+    RectArea last = DragPath(dragMs);
+    run.onCarrier = sim.posY == last.top && sim.posX >= last.left && sim.posX <= last.right;
+    run.carried = sim.carriedTicks;
+    run.predicted = sim.predictedTicks;
+    run.byShape = sim.windowTracker.matchedByShape;
+    hash = StateHash(sim);
+    return recorder.Data();
+}
+
+void BenchCarry() {
+    if (Selected("carry/fast_drag")) {
+        struct Case { int tickMs, eventMs; };
+        for (Case c : { Case{ 33, 33 }, Case{ 33, 50 }, Case{ 100, 100 }, Case{ 100, 25 }, Case{ 250, 250 }, Case{ 250, 40 } }) {
+            for (bool ids : { true, false }) {
+                CarryRun run;
+                unsigned long long recordedHash = 0, replayedHash = 0;
+                std::vector<uint8_t> trace = RecordDrag(c.tickMs, c.eventMs, ids, run, recordedHash);
+                // Replayed like ReplayTrace, but starting where the recording did
+                TraceReplayer replayer;
+                bool replayed = replayer.Attach(trace);
+                if (replayed) {
+                    ManualClock clock;
+                    clock.time = replayer.StartTime();
+                    Simulation sim(clock, replayer, replayer.Seed());
+                    sim.posX = CARRY_START_X;
+                    sim.posY = CARRY_START_Y;
+                    while (replayer.Step(sim, clock)) {}
+                    replayed = !replayer.corrupt;
+                    replayedHash = StateHash(sim);
+                }
+                bool ok = replayed && replayer.divergedTicks == 0 && replayedHash == recordedHash &&
+                          run.falls == 0 && run.onCarrier;
+                if (!ok) failures++;
+                printf("{\"name\":\"carry/fast_drag\",\"tick_ms\":%d,\"event_ms\":%d,\"ids\":\"%s\",\"drag_ticks\":%lld,"
+                       "\"falls\":%lld,\"carried_ticks\":%llu,\"predicted_ticks\":%llu,\"matched_by_shape\":%llu,"
+                       "\"max_lag_px\":%lld,\"mean_lag_px\":%.2f,\"trace_bytes\":%zu,\"replay_diverged\":%llu,\"ok\":%s}\n",
+                       c.tickMs, c.eventMs, ids ? "platform" : "shape", run.dragTicks, run.falls, run.carried,
+                       run.predicted, run.byShape, run.maxLag,
+                       run.dragTicks ? (double)run.totalLag / run.dragTicks : 0.0, trace.size(), replayer.divergedTicks, ok ? "true" : "false");
+                fflush(stdout);
+            }
+        }
+    }
+
+    // Tracker cost per enumeration: one window dragged, the rest still
+    for (int count : { 100, 1000, 10000 }) {
+        for (bool ids : { true, false }) {
+            std::vector<RectArea> monitors = MakeMonitors(LAYOUT_DUAL);
+            std::vector<RectArea> windows = MakeWindows(monitors, count, 20, 13);
+            std::vector<WindowId> platform;
+            if (ids) for (int i = 0; i < count; i++) platform.push_back(0x10000 + 0x1a2ull * i);
+            WindowTracker tracker;
+            unsigned long long now = 0;
+            tracker.Update(windows, platform, now);
+            WindowId dragged = tracker.ids[count / 2];
+            Run(ids ? "carry/track/platform_ids" : "carry/track/by_shape", { { "windows", count } }, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    RectArea& w = windows[count / 2];
+                    w.left += 7; w.right += 7; w.top -= 3; w.bottom -= 3;
+                    tracker.Update(windows, platform, now += 16);
+                    sink += tracker.IndexOf(dragged, count / 2);
+                }
+            });
+        }
+    }
+}
+
+// --- PIXEL KERNELS ---
+// Reference straight from the definitions, no shortcuts: every ISA must match it bit for bit
+std::vector<uint32_t> ReferenceScale(const std::vector<uint32_t>& src, int sw, int sh, int dw, int dh, bool mirror) {
+    std::vector<uint32_t> out((size_t)dw * dh);
+    for (int y = 0; y < dh; y++) {
+        int sy = (int)((y + 0.5) * sh / dh);
+        for (int x = 0; x < dw; x++) {
+            int sx = (int)((x + 0.5) * sw / dw);
+            out[(size_t)y * dw + (mirror ? dw - 1 - x : x)] = src[(size_t)sy * sw + sx];
+        }
+    }
+    return out;
+}
+
+std::vector<uint32_t> MakeSprite(int w, int h, unsigned long long seed) {
+    Random rng(seed);
+    std::vector<uint32_t> px((size_t)w * h);
+    for (auto& p : px) p = PixelKernels::PremultiplyPixel(rng.Next());
+    return px;
+}
+
+unsigned long long HashPixels(const std::vector<uint32_t>& px) {
+    unsigned long long h = 1469598103934665603ull;
+    for (uint32_t p : px) { h ^= p; h *= 1099511628211ull; }
+    return h;
+}
+
+std::vector<PixelKernels::Isa> AvailableIsas() {
+    std::vector<PixelKernels::Isa> isas = { PixelKernels::ISA_SCALAR };
+    if (PixelKernels::BestIsa() >= PixelKernels::ISA_SSE2) isas.push_back(PixelKernels::ISA_SSE2);
+    if (PixelKernels::BestIsa() >= PixelKernels::ISA_AVX2) isas.push_back(PixelKernels::ISA_AVX2);
+    return isas;
+}
+
+void CheckPixelKernels() {
+    if (!Selected("pixels/check")) return;
+    using namespace PixelKernels;
+    int checked = 0, mismatches = 0;
+    std::vector<int> xmap;
+
+    // Sizes the smart size produces (integer 1-6x, fractional downscales) plus odd ones
+    const int sizes[][4] = { { 32, 32, 32, 32 }, { 32, 32, 64, 64 }, { 17, 23, 51, 69 }, { 32, 32, 192, 192 },
+                             { 24, 20, 144, 120 }, { 7, 5, 56, 40 }, { 3, 9, 9, 27 }, { 1, 1, 6, 6 },
+                             { 64, 64, 135, 135 }, { 300, 200, 135, 90 }, { 640, 480, 180, 135 }, { 31, 29, 100, 77 } };
+    for (const auto& sz : sizes) {
+        std::vector<uint32_t> src = MakeSprite(sz[0], sz[1], sz[0] * 1000 + sz[1]);
+        for (int mirror = 0; mirror < 2; mirror++) {
+            std::vector<uint32_t> want = ReferenceScale(src, sz[0], sz[1], sz[2], sz[3], mirror == 1);
+            for (Isa isa : AvailableIsas()) {
+                // Guard pixels after the row end catch stores that run past the width
+                int stride = sz[2] + 9;
+                std::vector<uint32_t> got((size_t)stride * sz[3], 0xDEADBEEF);
+                ScaleNearest(src.data(), sz[0], sz[1], sz[0], got.data(), sz[2], sz[3], stride, mirror == 1, xmap, isa);
+                bool ok = true;
+                for (int y = 0; y < sz[3] && ok; y++) {
+                    for (int x = 0; x < stride; x++) {
+                        uint32_t g = got[(size_t)y * stride + x];
+                        if (x < sz[2] ? g != want[(size_t)y * sz[2] + x] : g != 0xDEADBEEF) { ok = false; break; }
+                    }
+                }
+                checked++;
+                if (!ok) {
+                    mismatches++;
+                    fprintf(stderr, "scale %dx%d -> %dx%d mirror=%d %s: MISMATCH\n", sz[0], sz[1], sz[2], sz[3], mirror, IsaName(isa));
+                }
+            }
+        }
+    }
+
+    // Premultiply: every (channel, alpha) pair against round(c * a / 255)
+    std::vector<uint32_t> straight(256 * 256), want(256 * 256), got(256 * 256);
+    for (int a = 0; a < 256; a++) {
+        for (int c = 0; c < 256; c++) {
+            int i = a * 256 + c;
+            straight[i] = ((uint32_t)a << 24) | ((uint32_t)c << 16) | ((uint32_t)(255 - c) << 8) | (uint32_t)(c ^ 0x5A);
+            auto mul = [a](int v) { return (uint32_t)((v * a + 127) / 255); };
+            want[i] = ((uint32_t)a << 24) | (mul(c) << 16) | (mul(255 - c) << 8) | mul(c ^ 0x5A);
+        }
+    }
+    for (Isa isa : AvailableIsas()) {
+        Premultiply(straight.data(), got.data(), (int)got.size(), isa);
+        checked++;
+        if (got != want) {
+            mismatches++;
+            fprintf(stderr, "premultiply %s: MISMATCH\n", IsaName(isa));
+        }
+    }
+
+    // Blend: every (source alpha, destination channel) pair against
+    // s + round(d * (255 - sa) / 255), plus out-of-range sources that must saturate
+    std::vector<uint32_t> blendSrc(256 * 256), blendDst(256 * 256), blendWant(256 * 256);
+    Random brng(9);
+    for (int a = 0; a < 256; a++) {
+        for (int d = 0; d < 256; d++) {
+            int i = a * 256 + d;
+            uint32_t sp = PremultiplyPixel(((uint32_t)a << 24) | (brng.Next() & 0xFFFFFF));
+            if ((d & 63) == 0) sp |= 0x00F0F0F0;   // Not premultiplied: channels above alpha
+            uint32_t dp = ((uint32_t)(255 - d) << 24) | ((uint32_t)d << 16) | ((uint32_t)(d ^ 0xA5) << 8) | (uint32_t)(255 - d);
+            blendSrc[i] = sp;
+            blendDst[i] = dp;
+            uint32_t w = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t c = ((sp >> shift) & 0xFF) + (((dp >> shift) & 0xFF) * (255 - (uint32_t)a) + 127) / 255;
+                w |= (c > 255 ? 255 : c) << shift;
+            }
+            blendWant[i] = w;
+        }
+    }
+    for (Isa isa : AvailableIsas()) {
+        got = blendDst;
+        BlendOver(blendSrc.data(), got.data(), (int)got.size(), isa);
+        checked++;
+        if (got != blendWant) {
+            mismatches++;
+            fprintf(stderr, "blend %s: MISMATCH\n", IsaName(isa));
+        }
+    }
+
+    // Golden image: a fixed sprite at the largest scale, mirrored. If this hash
+    // changes, the scaler's pixel mapping changed.
+    std::vector<uint32_t> golden = MakeSprite(32, 32, 42), out(192 * 192);
+    ScaleNearest(golden.data(), 32, 32, 32, out.data(), 192, 192, 192, true, xmap, ISA_SCALAR);
+    const unsigned long long GOLDEN_HASH = 0x91678530b8912ae7ull;
+    unsigned long long hash = HashPixels(out);
+    checked++;
+    if (hash != GOLDEN_HASH) {
+        mismatches++;
+        fprintf(stderr, "golden 32x32 -> 192x192 mirrored: hash %016llx\n", hash);
+    }
+
+    if (mismatches) failures++;
+    printf("{\"name\":\"pixels/check\",\"best_isa\":\"%s\",\"checked\":%d,\"mismatches\":%d}\n",
+           IsaName(BestIsa()), checked, mismatches);
+}
+
+void BenchPixelKernels() {
+    using namespace PixelKernels;
+    CheckPixelKernels();
+
+    std::vector<int> xmap;
+    const int cases[][4] = { { 32, 32, 192, 192 }, { 48, 48, 96, 96 }, { 64, 64, 135, 135 }, { 300, 200, 135, 90 } };
+    for (const auto& c : cases) {
+        std::vector<uint32_t> src = MakeSprite(c[0], c[1], 1), dst((size_t)c[2] * c[3]);
+        std::vector<Param> params = { { "src_w", c[0] }, { "src_h", c[1] }, { "dst_w", c[2] }, { "dst_h", c[3] } };
+        for (Isa isa : AvailableIsas()) {
+            Run(std::string("pixels/scale_mirror/") + IsaName(isa), params, [&](long long n) {
+                for (long long i = 0; i < n; i++)
+                    ScaleNearest(src.data(), c[0], c[1], c[0], dst.data(), c[2], c[3], c[2], true, xmap, isa);
+                sink += dst[0];
+            });
+        }
+    }
+
+    std::vector<uint32_t> straight = MakeSprite(128, 128, 2), premul(128 * 128);
+    for (Isa isa : AvailableIsas()) {
+        Run(std::string("pixels/premultiply_128x128/") + IsaName(isa), {}, [&](long long n) {
+            for (long long i = 0; i < n; i++) Premultiply(straight.data(), premul.data(), (int)premul.size(), isa);
+            sink += premul[0];
+        });
+    }
+    std::vector<uint32_t> under = MakeSprite(128, 128, 3);
+    for (Isa isa : AvailableIsas()) {
+        Run(std::string("pixels/blend_128x128/") + IsaName(isa), {}, [&](long long n) {
+            for (long long i = 0; i < n; i++) BlendOver(premul.data(), under.data(), (int)under.size(), isa);
+            sink += under[0];
+        });
+    }
+}
+
+// --- COMPOSITOR ---
+// A moving scene on two monitors: 'count' sprites, a few walking each frame,
+// some animating in place, one now and then hidden for a frame, and the
+// bottom two swapping draw order
+struct Scene {
+    std::vector<std::vector<uint32_t>> art;   // Frames to pick from
+    std::vector<CompositeItem> items;
+    std::vector<CompositeItem> frame;         // What the last Step() drew
+    Random rng;
+
+    Scene(int count, unsigned long long seed) : rng(seed) {
+        for (int f = 0; f < 6; f++) art.push_back(MakeSprite(48 + f * 8, 64, 100 + f));
+        for (int i = 0; i < count; i++) {
+            int f = rng.Next((int)art.size());
+            CompositeItem it = { i, art[f].data(), 48 + f * 8, 64, rng.Next(4500) - 20, rng.Next(1420) - 20, (unsigned long long)f };
+            items.push_back(it);
+        }
+    }
+
+    // 'changes' sprites move or switch frames
+    void Step(Compositor& comp, int changes) {
+        int n = (int)items.size();
+        for (int k = 0; k < changes; k++) {
+            CompositeItem& it = items[rng.Next(n)];
+            if (rng.Next(2)) {
+                it.x += rng.Next(9) - 4;
+                it.y += rng.Next(5) - 2;
+            } else {
+                int f = rng.Next((int)art.size());
+                it.pixels = art[f].data();
+                it.width = 48 + f * 8;
+                it.content = (unsigned long long)f;
+            }
+        }
+        if (n > 1 && rng.Next(10) == 0) std::swap(items[0], items[1]);
+        int hidden = (n > 2 && rng.Next(4) == 0) ? 2 : -1;
+        frame.clear();
+        for (int k = 0; k < n; k++) if (k != hidden) frame.push_back(items[k]);
+        Submit(comp, frame);
+    }
+
+    static void Submit(Compositor& comp, const std::vector<CompositeItem>& list) {
+        comp.Begin();
+        for (const auto& it : list) comp.Add(it);
+        comp.End();
+    }
+};
+
+// Incremental frames must come out exactly like a full repaint of the same frame
+void CheckCompositor() {
+    if (!Selected("compose/check")) return;
+    std::vector<RectArea> monitors = MakeMonitors(LAYOUT_DUAL);
+    Compositor comp, full;
+    comp.SetMonitors(monitors);
+
+    // Drawn into padded "platform" buffers; the padding must never be touched
+    const int PAD = 16;
+    std::vector<std::vector<uint32_t>> platform;
+    for (int i = 0; i < comp.SurfaceCount(); i++) {
+        const Compositor::Surface& s = comp.GetSurface(i);
+        platform.push_back(std::vector<uint32_t>((size_t)(s.width + PAD) * s.height, 0xDEADBEEF));
+        comp.Attach(i, platform[i].data(), s.width + PAD);
+    }
+
+    Scene scene(80, 5);
+    int mismatches = 0;
+    const int frames = 200;
+    for (int f = 0; f < frames; f++) {
+        scene.Step(comp, 1 + f % 40);   // Up to 40 changes: past MAX_DIRTY_RECTS, so tiles too
+        full.SetMonitors(monitors);
+        Scene::Submit(full, scene.frame);
+        for (int i = 0; i < comp.SurfaceCount(); i++) {
+            const Compositor::Surface& a = comp.GetSurface(i);
+            const Compositor::Surface& b = full.GetSurface(i);
+            bool ok = true;
+            for (int y = 0; y < a.height && ok; y++) {
+                const uint32_t* ra = a.pixels + (size_t)y * a.stride;
+                const uint32_t* rb = b.pixels + (size_t)y * b.stride;
+                if (memcmp(ra, rb, (size_t)a.width * 4) != 0) ok = false;
+                for (int x = a.width; x < a.stride && ok; x++) ok = ra[x] == 0xDEADBEEF;
+            }
+            if (!ok) mismatches++;
+        }
+    }
+    if (mismatches) failures++;
+    printf("{\"name\":\"compose/check\",\"frames\":%d,\"surfaces\":%d,\"mismatches\":%d,"
+           "\"dirty_px_per_frame\":%.0f,\"full_repaints\":%llu}\n", frames, comp.SurfaceCount(), mismatches,
+           (double)comp.stats.dirtyPixels / comp.stats.frames, comp.stats.fullRepaints);
+    fflush(stdout);
+}
+
+void BenchCompositor() {
+    CheckCompositor();
+
+    std::vector<RectArea> monitors = MakeMonitors(LAYOUT_DUAL);
+    for (int count : { 1, 10, 100, 1000 }) {
+        std::vector<Param> params = { { "sprites", count }, { "changes", 1 + count / 10 } };
+        // Steady state: a tenth of the sprites change each frame
+        Compositor comp;
+        comp.SetMonitors(monitors);
+        Scene scene(count, 6);
+        scene.Step(comp, 0);
+        unsigned long long px0 = 0, f0 = 0;
+        double ns = Run("compose/frame/dirty", params, [&](long long n) {
+            px0 = comp.stats.dirtyPixels;
+            f0 = comp.stats.frames;
+            for (long long i = 0; i < n; i++) scene.Step(comp, 1 + count / 10);
+        });
+        // Baseline: the same frames repainted in full, which is what one
+        // upload of the whole overlay per frame would cost at least
+        Compositor full;
+        full.SetMonitors(monitors);
+        double nsFull = Run("compose/frame/full", params, [&](long long n) {
+            for (long long i = 0; i < n; i++) {
+                scene.Step(comp, 1 + count / 10);
+                full.SetMonitors(monitors);
+                Scene::Submit(full, scene.frame);
+            }
+        });
+        if (ns > 0 && nsFull > 0 && comp.stats.frames > f0) {
+            double px = (double)(comp.stats.dirtyPixels - px0) / (comp.stats.frames - f0);
+            double total = 0;
+            for (const auto& m : monitors) total += (double)(m.right - m.left) * (m.bottom - m.top);
+            printf("{\"name\":\"compose/summary\",\"sprites\":%d,\"dirty_px_per_frame\":%.0f,\"surface_px\":%.0f,"
+                   "\"speedup\":%.1f}\n", count, px, total, nsFull / ns);
+            fflush(stdout);
+        }
+    }
+}
+
+// --- SPRITE STORE ---
+// Sets of generated frames; pixel (i) of frame f of set s is a function of (s, f, i),
+// so a frame decoded again after eviction can be checked
+struct FakeSpriteSource : SpriteSource {
+    std::vector<int> frameCounts, sizes;
+    long long loads = 0;
+
+    static uint32_t PixelAt(int set, int frame, int i) {
+        return (uint32_t)((set * 7919 + frame * 104729 + i) * 2654435761u);
+    }
+    bool Load(const std::string& name, SpriteArena& arena, std::vector<SpriteFrame>& frames) override {
+        int set = std::atoi(name.c_str() + 3);   // "set<N>"
+        loads++;
+        for (int f = 0; f < frameCounts[set]; f++) {
+            int w = sizes[set], h = sizes[set];
+            uint32_t* px = arena.Allocate((size_t)w * h);
+            for (int i = 0; i < w * h; i++) px[i] = PixelAt(set, f, i);
+            frames.push_back({ px, w, h });
+        }
+        return true;
+    }
+};
+
+void BenchSpriteStore() {
+    // Eight states' worth of art: a few small sets, a couple of high-resolution ones
+    FakeSpriteSource source;
+    source.frameCounts = { 8, 4, 6, 2, 8, 3, 12, 6 };
+    source.sizes = { 64, 64, 96, 64, 256, 128, 192, 48 };
+    // Everything decoded up front, plus every frame once scaled to 2x (four times the pixels)
+    size_t eagerBytes = 0;
+    for (size_t s = 0; s < source.sizes.size(); s++) eagerBytes += (size_t)source.frameCounts[s] * source.sizes[s] * source.sizes[s] * 4 * 5;
+
+    for (size_t budgetKB : { (size_t)1024, (size_t)4096, (size_t)16384 }) {
+        std::string name = "sprites/residency";
+        if (!Selected(name)) continue;
+        SpriteStore store(budgetKB * 1024);
+        store.SetSource(&source);
+        std::vector<int> ids;
+        for (size_t s = 0; s < source.sizes.size(); s++) ids.push_back(store.AddSet("set" + std::to_string(s)));
+
+        // The renderer's side: each frame drawn at twice its size, cached and
+        // charged to its set like Main.cpp's BuildFrame, dropped on eviction
+        FrameCache<std::vector<uint32_t>> cache;
+        struct Drops : SpriteEvictListener {
+            FrameCache<std::vector<uint32_t>>* cache;
+            void Evicted(int set) override {
+                cache->Drop([set](const FrameKey& k) { return k.state == set; }, [](std::vector<uint32_t>&) {});
+            }
+        } drops;
+        drops.cache = &cache;
+        store.SetEvictListener(&drops);
+
+        // A state machine's worth of visits: long stays on a few common sets,
+        // rare visits to the big ones; every visit draws each frame once
+        Random rng(77);
+        int bad = 0;
+        size_t maxFootprint = 0, maxCached = 0;
+        for (int visit = 0; visit < 2000; visit++) {
+            int r = rng.Next(100);
+            int set = r < 40 ? 0 : r < 60 ? 1 : r < 75 ? 2 : r < 85 ? 3 : r < 90 ? 5 : r < 95 ? 7 : r < 98 ? 6 : 4;
+            store.BeginFrame();
+            for (int f = 0; f < source.frameCounts[set]; f++) {
+                const SpriteFrame* frame = store.Frame(ids[set], f, false);
+                int w = source.sizes[set] * 2, n = w * w;
+                FrameKey key = { set, f, true, w, w };
+                std::vector<uint32_t>* scaled = cache.Find(key);
+                if (!scaled) {
+                    frame = store.Frame(ids[set], f, true);
+                    if (!frame || !frame->pixels) { bad++; continue; }
+                    scaled = cache.Insert(key, std::vector<uint32_t>((size_t)n), (unsigned long long)n * 4);
+                    for (int y = 0; y < w; y++)
+                        for (int x = 0; x < w; x++) (*scaled)[(size_t)y * w + x] = frame->pixels[(y / 2) * frame->width + x / 2];
+                    store.Charge(ids[set], (size_t)n * 4);
+                }
+                if ((*scaled)[0] != FakeSpriteSource::PixelAt(set, f, 0) ||
+                    (*scaled)[n - 1] != FakeSpriteSource::PixelAt(set, f, n / 4 - 1)) bad++;
+            }
+            store.EndFrame();
+            // Over budget only while one set alone (pixels and scaled frames) is bigger than the budget
+            if (store.stats.residentBytes > store.Budget() && store.stats.residentSets > 1) bad++;
+            if (cache.stats.cachedBytes != store.stats.scaledBytes) bad++;
+            size_t footprint = store.Pool().allocatedBytes + (size_t)cache.stats.cachedBytes;
+            if (footprint > maxFootprint) maxFootprint = footprint;
+            if (cache.stats.cachedBytes > maxCached) maxCached = (size_t)cache.stats.cachedBytes;
+        }
+        // Sizes survive eviction without a decode
+        unsigned long long decodes = store.stats.decodes;
+        for (size_t s = 0; s < source.sizes.size(); s++) {
+            const SpriteFrame* frame = store.Frame(ids[s], 0, false);
+            if (!frame || frame->width != source.sizes[s]) bad++;
+        }
+        if (store.stats.decodes != decodes) bad++;
+        // Every set was drawn, so each had exactly one first decode
+        if (store.stats.firstDecodes != (int)source.sizes.size()) bad++;
+
+        if (bad) failures++;
+        printf("{\"name\":\"%s\",\"budget_kb\":%zu,\"eager_kb\":%zu,\"peak_resident_kb\":%zu,"
+               "\"peak_scaled_kb\":%zu,\"peak_heap_kb\":%zu,\"decodes\":%llu,\"evictions\":%llu,"
+               "\"scaled_dropped\":%llu,\"pixel_lookups\":%llu,\"first_decodes\":%d,\"first_decode_ms\":%.2f,"
+               "\"reload_ms\":%.2f,\"errors\":%d}\n",
+               name.c_str(), budgetKB, eagerBytes / 1024, store.stats.peakBytes / 1024, maxCached / 1024,
+               maxFootprint / 1024, store.stats.decodes, store.stats.evictions, cache.stats.dropped,
+               store.stats.pixelLookups, store.stats.firstDecodes, store.stats.firstDecodeMs, store.stats.reloadMs, bad);
+    }
+
+    // Hot path: the set is resident
+    SpriteStore store(16 * 1024 * 1024);
+    store.SetSource(&source);
+    int set = store.AddSet("set0");
+    store.Frame(set, 0, true);
+    Run("sprites/lookup_resident", {}, [&](long long n) {
+        for (long long i = 0; i < n; i++) sink += store.Frame(set, (int)(i & 7), true)->width;
+    });
+}
+
+// --- SPRITE CONVERTER ---
+struct MemoryFiles : SpriteFiles {
+    std::map<std::string, std::vector<uint8_t>> files;
+    std::mutex mutex;
+    bool Read(const std::string& path, std::vector<uint8_t>& out) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = files.find(path);
+        if (it == files.end()) return false;
+        out = it->second;
+        return true;
+    }
+    bool Write(const std::string& path, const std::vector<uint8_t>& data) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        files[path] = data;
+        return true;
+    }
+};
+
+// 8-bit RGBA PNG, what an art tool exports ('px' straight BGRA)
+std::vector<uint8_t> EncodeRgbaPng(const std::vector<uint32_t>& px, int w, int h) {
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> out(SIGNATURE, SIGNATURE + 8), raw, z;
+    uint8_t ihdr[13] = { 0 };
+    for (int s = 0; s < 4; s++) {
+        ihdr[s] = (uint8_t)(w >> (24 - 8 * s));
+        ihdr[4 + s] = (uint8_t)(h >> (24 - 8 * s));
+    }
+    ihdr[8] = 8;
+    ihdr[9] = 6;
+    Png::PutChunk(out, "IHDR", ihdr, 13);
+    for (int y = 0; y < h; y++) {
+        raw.push_back(0);
+        for (int x = 0; x < w; x++) {
+            uint32_t p = px[(size_t)y * w + x];
+            uint8_t rgba[4] = { (uint8_t)(p >> 16), (uint8_t)(p >> 8), (uint8_t)p, (uint8_t)(p >> 24) };
+            raw.insert(raw.end(), rgba, rgba + 4);
+        }
+    }
+    Png::Deflater().Compress(raw.data(), raw.size(), z);
+    Png::PutChunk(out, "IDAT", z.data(), z.size());
+    Png::PutChunk(out, "IEND", nullptr, 0);
+    return out;
+}
+
+// Hand-drawn-looking frame: transparent background, a body of flat-shaded
+// blobs from the animation's own colors, shifted a little every frame
+std::vector<uint32_t> MakeArtFrame(int size, int anim, int frame) {
+    Random shades(anim * 31 + 7);
+    std::vector<uint32_t> colors(96);
+    for (auto& c : colors) c = 0xFF000000u | (shades.Next() & 0xFFFFFF);
+    colors[0] = 0x80000000u | (colors[0] & 0xFFFFFF);     // A shadow
+    std::vector<uint32_t> px((size_t)size * size, 0);
+    Random rng(anim * 1000 + frame);
+    for (int b = 0; b < 60; b++) {
+        int r = size / 16 + rng.Next(size / 8);
+        int cx = size / 4 + rng.Next(size / 2) + frame % 4, cy = size / 4 + rng.Next(size / 2);
+        uint32_t c = colors[rng.Next((int)colors.size())];
+        for (int y = std::max(0, cy - r); y < std::min(size, cy + r); y++)
+            for (int x = std::max(0, cx - r); x < std::min(size, cx + r); x++)
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) < r * r) px[(size_t)y * size + x] = c;
+    }
+    return px;
+}
+
+// anims[a] = "a<a>" with 'frames' frames of size x size, stored in 'files' as src/a<a>/<f>.png
+std::vector<SpriteAnimation> MakeArtSet(MemoryFiles& files, int animCount, int frames, int size) {
+    std::vector<SpriteAnimation> anims(animCount);
+    for (int a = 0; a < animCount; a++) {
+        anims[a].name = "a" + std::to_string(a);
+        for (int f = 0; f < frames; f++) {
+            std::string path = "src/" + anims[a].name + "/" + std::to_string(f) + ".png";
+            files.files[path] = EncodeRgbaPng(MakeArtFrame(size, a, f), size, size);
+            anims[a].frames.push_back(path);
+        }
+    }
+    return anims;
+}
+
+void CheckSpriteConverter() {
+    if (!Selected("sprites/convert_check")) return;
+    int bad = 0;
+
+    // Deflate/inflate roundtrip: empty, incompressible, long runs
+    Random rng(5);
+    std::vector<std::vector<uint8_t>> blobs(3);
+    for (int i = 0; i < 100000; i++) blobs[1].push_back((uint8_t)rng.Next());
+    for (int i = 0; i < 300000; i++) blobs[2].push_back((uint8_t)((i / 700) % 5));
+    for (const auto& b : blobs) {
+        std::vector<uint8_t> z, back;
+        Png::Deflater().Compress(b.data(), b.size(), z);
+        if (!Png::Inflate(z.data(), z.size(), back) || back != b) bad++;
+    }
+
+    MemoryFiles files;
+    std::vector<SpriteAnimation> anims = MakeArtSet(files, 3, 6, 200);
+    anims.push_back({ "broken", { anims[0].frames[0], "src/missing.png" } });
+    ConvertOptions options;
+    options.outDir = "out";
+    options.packPath = "out/sprites.pack";
+    options.threads = 4;
+    SpriteConverter converter(files);
+    ConvertStats stats = converter.Convert(anims, options);
+    if (stats.animations != 3 || stats.frames != 18 || stats.errors.size() != 1 || files.files.count("out/broken_0.png")) bad++;
+
+    std::vector<uint8_t> scratch;
+    std::vector<int> xmap;
+    std::vector<uint32_t> scaled(80 * 80);
+    for (int a = 0; a < 3; a++) {
+        const SpriteConverter::Animation& r = converter.results[a];
+        if (r.palette.empty() || (int)r.palette.size() > options.colors || r.palette[0] != 0) bad++;
+        for (int f = 0; f < 6; f++) {
+            // The PNG written is the frame in the animation's palette...
+            Png::Image img;
+            auto it = files.files.find("out/a" + std::to_string(a) + "_" + std::to_string(f) + ".png");
+            if (it == files.files.end() || !Png::Decode(it->second.data(), it->second.size(), img, scratch) ||
+                img.width != 80 || img.height != 80) { bad++; continue; }
+            std::vector<uint32_t> src = MakeArtFrame(200, a, f);
+            PixelKernels::ScaleNearest(src.data(), 200, 200, 200, scaled.data(), 80, 80, 80, false, xmap);
+            for (int i = 0; i < 80 * 80; i++) {
+                uint8_t k = r.frames[f].indices[i];
+                // ...transparent exactly where the source is
+                if (img.pixels[i] != r.palette[k] || (k == 0) != (scaled[i] >> 24 == 0)) { bad++; break; }
+            }
+        }
+    }
+
+    // The pack holds the same frames premultiplied
+    const std::vector<uint8_t>& pack = files.files["out/sprites.pack"];
+    const PackHeader* h = (const PackHeader*)pack.data();
+    if (pack.size() < sizeof(PackHeader) || memcmp(h->magic, "DWPK", 4) != 0 || h->animCount != 3 || h->frameCount != 18) bad++;
+    else {
+        const PackAnim* packAnims = (const PackAnim*)(pack.data() + sizeof(PackHeader));
+        const PackFrame* packFrames = (const PackFrame*)(packAnims + h->animCount);
+        for (int a = 0; a < 3; a++) {
+            if (std::string(packAnims[a].name) != anims[a].name || packAnims[a].firstFrame != (uint32_t)a * 6) bad++;
+            const SpriteConverter::Animation& r = converter.results[a];
+            for (int f = 0; f < 6; f++) {
+                const PackFrame& pf = packFrames[a * 6 + f];
+                const uint32_t* px = (const uint32_t*)(pack.data() + pf.offset);
+                if (pf.width != 80 || pf.height != 80 || pf.offset % 16) { bad++; continue; }
+                for (int i = 0; i < 80 * 80; i++) {
+                    if (px[i] != PixelKernels::PremultiplyPixel(r.palette[r.frames[f].indices[i]])) { bad++; break; }
+                }
+            }
+        }
+    }
+
+    // Same bytes however many threads did it
+    MemoryFiles serialFiles;
+    serialFiles.files = files.files;
+    options.threads = 1;
+    SpriteConverter serial(serialFiles);
+    serial.Convert(anims, options);
+    if (serialFiles.files != files.files) bad++;
+
+    if (bad) failures++;
+    printf("{\"name\":\"sprites/convert_check\",\"animations\":%d,\"frames\":%d,\"errors\":%d}\n", stats.animations, stats.frames, bad);
+}
+
+void BenchSpriteConverter() {
+    CheckSpriteConverter();
+    // A big set: 8 animations x 24 frames of 320x320 art to 80x80, 64 colors
+    MemoryFiles files;
+    std::vector<SpriteAnimation> anims = MakeArtSet(files, 8, 24, 320);
+    int cores = (int)std::thread::hardware_concurrency();
+    for (int threads : { 1, cores > 1 ? cores : 0 }) {
+        if (threads == 0) continue;
+        ConvertOptions options;
+        options.outDir = "out";
+        options.threads = threads;
+        SpriteConverter converter(files);
+        ConvertStats stats;
+        double ns = Run("sprites/convert", { { "threads", threads }, { "frames", 8 * 24 } }, [&](long long n) {
+            for (long long i = 0; i < n; i++) stats = converter.Convert(anims, options);
+        });
+        if (ns == 0) continue;
+        printf("{\"name\":\"sprites/convert_phases\",\"threads\":%d,\"frames_per_s\":%.0f,\"decode_ms\":%.1f,\"palette_ms\":%.1f,\"encode_ms\":%.1f}\n",
+               threads, 8 * 24 * 1e9 / ns, stats.decodeMs, stats.paletteMs, stats.encodeMs);
+    }
+}
+
+// --- SWARM ---
+unsigned long long SwarmHash(const Swarm& swarm) {
+    unsigned long long h = 1469598103934665603ull;
+    for (int i = 0; i < swarm.Count(); i++) {
+        long long fields[] = { swarm.posX[i], swarm.posY[i], swarm.velY[i], swarm.targetX[i],
+                               swarm.targetY[i], swarm.state[i], swarm.frame[i], swarm.facingRight[i] };
+        for (long long f : fields) { h ^= (unsigned long long)f; h *= 1099511628211ull; }
+    }
+    return h;
+}
+
+// 'ticks' ticks of 'walkers' walkers on 'threads' threads; hash of where they
+// all ended up. The topmost window is dragged along DragPath the whole time,
+// its move events every 50 ms, so walkers on it are carried and predicted.
+unsigned long long SwarmReplay(StaticEnvironment env, int walkers, int threads, long long ticks, unsigned long long& carried) {
+    ManualClock clock;
+    clock.time = 1000;
+    Simulation world(clock, env, 1);
+    world.UpdateEnvironment();
+    world.RefreshSnapshot();
+    Swarm swarm(threads);
+    for (int s = 0; s < STATE_COUNT; s++) swarm.SetAnimation((State)s, 2, 200);
+    swarm.Spawn(world, walkers, 77, clock.time);
+    for (long long t = 0; t < ticks; t++) {
+        clock.Advance(Config::TICK_RATE);
+        long long ms = t * Config::TICK_RATE;
+        if (ms / 50 != (ms + Config::TICK_RATE) / 50) {
+            env.windows[0] = DragPath(ms);
+            world.windowCache.OnWindowEvent(WINDOW_MOVED);
+        }
+        world.RefreshSnapshot();
+        swarm.Tick(world, clock.time);
+    }
+    carried = swarm.CarriedTicks();
+    return SwarmHash(swarm);
+}
+
+// Walkers dropped in a row onto a window that is then dragged like
+// carry/fast_drag, on any thread count. One that has been standing on it
+// well inside its sides for two ticks must not start falling while still
+// there; walking off an end, or landing on a lagging snapshot, is allowed.
+void CheckSwarmDrag(int threads, long long& falls, unsigned long long& carried) {
+    ManualClock clock;
+    clock.time = 1000;
+    StaticEnvironment desk;
+    desk.monitors = MakeMonitors(LAYOUT_SINGLE);
+    desk.windows = { DragPath(0), { 0, 960, 700, 1040 }, { 800, 970, 1500, 1040 }, { 1500, 955, 1920, 1040 } };
+    Simulation world(clock, desk, 1);
+    world.UpdateEnvironment();
+    world.RefreshSnapshot();
+    Swarm swarm(threads);
+    const int walkers = 600;
+    swarm.Spawn(world, walkers, 77, clock.time);
+    for (int i = 0; i < walkers; i++) {
+        swarm.posX[i] = (int)desk.windows[0].left + 50 + i * 2;
+        swarm.posY[i] = CARRY_START_Y;
+    }
+    for (int t = 0; t < 1000; t += Config::TICK_RATE) {
+        clock.Advance(Config::TICK_RATE);
+        world.RefreshSnapshot();
+        swarm.Tick(world, clock.time);
+    }
+    falls = 0;
+    // DragPath moves up to 1.6 px/ms, so near a side the held rect and the
+    // real one can disagree for a move event's worth of time plus a tick
+    const long margin = 2 * (50 + Config::TICK_RATE);
+    std::vector<int> onCarrier(walkers, 0);   // Consecutive ticks standing inside its sides
+    for (long long t = 1; t <= 6000; t++) {
+        clock.Advance(1);
+        if (t % 50 == 0) {
+            desk.windows[0] = DragPath(t);
+            world.windowCache.OnWindowEvent(WINDOW_MOVED);
+        }
+        if (t % Config::TICK_RATE) continue;
+        world.RefreshSnapshot();
+        swarm.Tick(world, clock.time);
+        RectArea truth = DragPath(t);
+        for (int i = 0; i < walkers; i++) {
+            bool inside = swarm.posX[i] > truth.left + margin && swarm.posX[i] < truth.right - margin;
+            bool air = swarm.state[i] == FALLING || swarm.state[i] == LEAPING;
+            if (swarm.state[i] == FALLING && inside && onCarrier[i] >= 2) falls++;
+            bool standing = !air && swarm.state[i] != PREPARE_JUMP && inside &&
+                            std::abs(swarm.posY[i] - (int)truth.top) <= 50;
+            onCarrier[i] = standing ? onCarrier[i] + 1 : 0;
+        }
+    }
+    carried = swarm.CarriedTicks();
+}
+
+void BenchSwarm() {
+    StaticEnvironment env;
+    env.monitors = MakeMonitors(LAYOUT_DUAL);
+    env.windows = MakeWindows(env.monitors, 100, 20, 8);
+    int hw = (int)std::thread::hardware_concurrency();
+    if (hw < 1) hw = 1;
+
+    // Same seed, same walkers: the thread count must not change a single position
+    if (Selected("swarm/determinism")) {
+        const long long ticks = 30 * 60;   // One minute of game time
+        unsigned long long carried[4];
+        unsigned long long one = SwarmReplay(env, 3000, 1, ticks, carried[0]);
+        unsigned long long many = SwarmReplay(env, 3000, hw, ticks, carried[1]);
+        unsigned long long odd = SwarmReplay(env, 3000, 3, ticks, carried[2]);
+        unsigned long long again = SwarmReplay(env, 3000, hw, ticks, carried[3]);
+        bool ok = one == many && one == odd && one == again && carried[0] > 0 &&
+                  carried[0] == carried[1] && carried[0] == carried[2] && carried[0] == carried[3];
+        if (!ok) failures++;
+        printf("{\"name\":\"swarm/determinism\",\"walkers\":3000,\"ticks\":%lld,\"threads\":%d,"
+               "\"carried_ticks\":%llu,\"hash\":\"%016llx\",\"match\":%s}\n", ticks, hw, carried[0], one, ok ? "true" : "false");
+        fflush(stdout);
+    }
+    if (Selected("swarm/fast_drag")) {
+        for (int threads : { 1, hw > 1 ? hw : 4 }) {
+            long long falls;
+            unsigned long long carried;
+            CheckSwarmDrag(threads, falls, carried);
+            bool ok = falls == 0 && carried > 0;
+            if (!ok) failures++;
+            printf("{\"name\":\"swarm/fast_drag\",\"walkers\":600,\"threads\":%d,\"falls\":%lld,"
+                   "\"carried_ticks\":%llu,\"ok\":%s}\n", threads, falls, carried, ok ? "true" : "false");
+            fflush(stdout);
+        }
+    }
+
+    // One tick for N walkers, single-threaded vs. all cores (4 threads on a
+    // single core, to show the pool's overhead). Walkers spend the first
+    // seconds falling, so time a settled swarm.
+    for (int walkers : { 1, 10, 100, 1000, 10000 }) {
+        for (int threads : { 1, hw > 1 ? hw : 4 }) {
+            std::string name = "swarm/tick";
+            if (!Selected(name)) continue;
+            ManualClock clock;
+            clock.time = 1000;
+            Simulation world(clock, env, 1);
+            world.UpdateEnvironment();
+            world.RefreshSnapshot();
+            Swarm swarm(threads);
+            swarm.Spawn(world, walkers, 77, clock.time);
+            for (int t = 0; t < 300; t++) {
+                clock.Advance(Config::TICK_RATE);
+                swarm.Tick(world, clock.time);
+            }
+            Run(name, { { "walkers", walkers }, { "threads", threads } }, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    clock.Advance(Config::TICK_RATE);
+                    swarm.Tick(world, clock.time);
+                }
+                sink += swarm.posX[0];
+            });
+        }
+    }
+}
+
+// --- FRAME HANDOFF STRESS ---
+// Producer and consumer on two threads for a fixed time. Every descriptor's
+// fields are derived from its seq, so a torn read (fields from two different
+// publishes) or a seq going backwards shows up as a failure.
+FrameDesc MakeDesc(unsigned long long seq, uint64_t ns) {
+    FrameDesc d;
+    d.seq = seq;
+    d.publishNs = ns;
+    d.state = (int)(seq % STATE_COUNT);
+    d.frame = (int)(seq % 7);
+    d.facingRight = (seq & 1) != 0;
+    d.posX = (int)(seq * 3);
+    d.posY = (int)(seq ^ 0x5555);
+    d.screenH = (int)(seq & 0xFFFF);
+    d.displayEpoch = seq / 1000;
+    return d;
+}
+
+bool Consistent(const FrameDesc& d) {
+    FrameDesc e = MakeDesc(d.seq, d.publishNs);
+    return d.state == e.state && d.frame == e.frame && d.facingRight == e.facingRight && d.posX == e.posX &&
+           d.posY == e.posY && d.screenH == e.screenH && d.displayEpoch == e.displayEpoch;
+}
+
+// producerGapNs: pause between publishes (0 = flat out)
+// consumerWorkNs: simulated render time per consumed frame
+void StressHandoff(const char* name, uint64_t producerGapNs, uint64_t consumerWorkNs) {
+    if (!Selected(name)) return;
+    TripleBuffer<FrameDesc> handoff;
+    Profiler latency;
+    std::atomic<bool> stop{false};
+    unsigned long long torn = 0, backwards = 0;
+
+    std::thread consumer([&]() {
+        FrameDesc d;
+        unsigned long long lastSeq = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (!handoff.Acquire(d)) { std::this_thread::yield(); continue; }
+            uint64_t now = latency.NowNs();
+            latency.Record(STAGE_HANDOFF, d.publishNs, now - d.publishNs);
+            if (!Consistent(d)) torn++;
+            if (d.seq <= lastSeq) backwards++;
+            lastSeq = d.seq;
+            while (latency.NowNs() - now < consumerWorkNs) std::this_thread::yield();
+        }
+    });
+
+    unsigned long long seq = 0;
+    uint64_t end = latency.NowNs() + 500000000ull;
+    for (uint64_t now = latency.NowNs(); now < end; now = latency.NowNs()) {
+        handoff.Publish(MakeDesc(++seq, now));
+        while (latency.NowNs() - now < producerGapNs) std::this_thread::yield();
+    }
+    stop = true;
+    consumer.join();
+
+    if (torn || backwards) failures++;
+    printf("{\"name\":\"%s\",\"published\":%llu,\"consumed\":%llu,\"dropped\":%llu,\"torn\":%llu,\"backwards\":%llu,"
+           "\"latency_p50_ns\":%llu,\"latency_p99_ns\":%llu,\"latency_max_ns\":%llu}\n",
+           name, handoff.published.load(), handoff.consumed.load(), handoff.dropped.load(), torn, backwards,
+           (unsigned long long)latency.PercentileNs(STAGE_HANDOFF, 50), (unsigned long long)latency.PercentileNs(STAGE_HANDOFF, 99),
+           (unsigned long long)latency.MaxNs(STAGE_HANDOFF));
+    fflush(stdout);
+}
+
+void BenchHandoff() {
+    TripleBuffer<FrameDesc> handoff;
+    FrameDesc d = MakeDesc(1, 0);
+    Run("handoff/publish_acquire", {}, [&](long long n) {
+        long long total = 0;
+        for (long long i = 0; i < n; i++) {
+            d.seq = (unsigned long long)i;
+            handoff.Publish(d);
+            FrameDesc out;
+            if (handoff.Acquire(out)) total += (long long)out.seq;
+        }
+        sink += total;
+    });
+
+    StressHandoff("handoff/stress_flat_out", 0, 0);            // Both sides as fast as they go
+    StressHandoff("handoff/stress_slow_render", 0, 50000);      // Renderer far behind: most frames dropped
+    StressHandoff("handoff/stress_paced", 100000, 0);           // Ticks slower than the renderer: nothing dropped
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strncmp(argv[1], "--trace=", 8) == 0) return ReplayFile(argv[1] + 8);
+    if (argc > 1 && strncmp(argv[1], "--write-trace=", 14) == 0) return WriteSampleTrace(argv[1] + 14);
+    if (argc > 1) filter = argv[1];
+
+    BenchOcclusion();
+    BenchBatchQueries();
+    BenchJumpSearch();
+    BenchSmartSize();
+    BenchRenderBookkeeping();
+    BenchPixelKernels();
+    BenchCompositor();
+    BenchSpriteStore();
+    BenchSpriteConverter();
+    BenchTitles();
+    BenchSimulation();
+    BenchAI();
+    BenchTrace();
+    BenchCarry();
+    BenchSwarm();
+    BenchHandoff();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "Environment.h"
+#include "PixelKernels.h"
+
+// ==========================================
+//              COMPOSITOR
+// ==========================================
+// Every visible sprite (the buddy, a swarm, bubbles...) is blended into one
+// premultiplied BGRA surface per monitor instead of getting a layered window of
+// its own. Each frame is diffed against the last by item id: only the old and
+// new rects of items that appeared, vanished, moved, changed pixels or changed
+// draw order are cleared and re-blended, and the platform only uploads those.
+// Surfaces can live in memory the platform owns (a DIB section) or in our own.
+
+// One sprite for this frame, in draw order (later items on top)
+struct CompositeItem {
+    int id;                       // Stable across frames, small and unique (0 = buddy, 1+ = walkers)
+    const uint32_t* pixels;       // Premultiplied BGRA, stride = width
+    int width, height;
+    int x, y;                     // Top-left, desktop coordinates
+    unsigned long long content;   // Must change whenever the pixels do
+};
+
+// Half-open desktop rect
+struct DirtyRect {
+    int left, top, right, bottom;
+    bool Empty() const { return left >= right || top >= bottom; }
+    long long Area() const { return Empty() ? 0 : (long long)(right - left) * (bottom - top); }
+};
+
+struct CompositorStats {
+    unsigned long long frames = 0;
+    unsigned long long idleFrames = 0;      // Nothing changed on any surface
+    unsigned long long dirtyRects = 0;
+    unsigned long long dirtyPixels = 0;     // Cleared and re-blended
+    unsigned long long blendedPixels = 0;   // Sprite pixels blended into them
+    unsigned long long fullRepaints = 0;
+};
+
+class Compositor {
+public:
+    static const int MAX_DIRTY_RECTS = 16;  // Beyond this a surface switches to dirty tiles
+    static const int TILE = 32;
+    static const int CELL = 128;            // Item buckets for repainting many rects
+
+    struct Surface {
+        RectArea bounds;                    // Desktop rect it covers
+        int width = 0, height = 0, stride = 0;
+        uint32_t* pixels = nullptr;
+        std::vector<uint32_t> own;          // Used until Attach()
+        std::vector<DirtyRect> dirty;       // Re-blended this frame
+        DirtyRect dirtyBounds = { 0, 0, 0, 0 };
+        std::vector<uint8_t> tiles;         // TILE x TILE dirty map, once there are too many rects
+        int tilesX = 0, tilesY = 0;
+        bool tiled = false;
+        // Items touching each CELL x CELL cell, in draw order: cell c's are
+        // bucketItems[bucketStart[c] .. bucketStart[c + 1])
+        std::vector<int> bucketStart, bucketItems;
+        int cellsX = 0, cellsY = 0;
+    };
+
+    CompositorStats stats;
+
+    // One surface per monitor, all cleared and fully dirty
+    void SetMonitors(const std::vector<RectArea>& monitors) {
+        surfaces.assign(monitors.size(), Surface());
+        for (size_t i = 0; i < monitors.size(); i++) {
+            Surface& s = surfaces[i];
+            s.bounds = monitors[i];
+            s.width = (int)(monitors[i].right - monitors[i].left);
+            s.height = (int)(monitors[i].bottom - monitors[i].top);
+            s.stride = s.width;
+            s.own.assign((size_t)s.width * s.height, 0);
+            s.pixels = s.own.data();
+            s.tilesX = (s.width + TILE - 1) / TILE;
+            s.tilesY = (s.height + TILE - 1) / TILE;
+            s.tiles.assign((size_t)s.tilesX * s.tilesY, 0);
+            s.cellsX = (s.width + CELL - 1) / CELL;
+            s.cellsY = (s.height + CELL - 1) / CELL;
+            s.bucketStart.assign((size_t)s.cellsX * s.cellsY + 1, 0);
+        }
+        repaintAll = true;
+    }
+
+    // Draw surface i into 'pixels' (stride in pixels) from now on
+    void Attach(int i, uint32_t* pixels, int stride) {
+        Surface& s = surfaces[i];
+        s.own.clear();
+        s.own.shrink_to_fit();
+        s.pixels = pixels;
+        s.stride = stride;
+        repaintAll = true;
+    }
+
+    int SurfaceCount() const { return (int)surfaces.size(); }
+    const Surface& GetSurface(int i) const { return surfaces[i]; }
+    bool SurfaceDirty(int i) const { return !surfaces[i].dirty.empty(); }
+
+    void Begin() { items.clear(); }
+    void Add(const CompositeItem& item) { items.push_back(item); }
+
+    // Diff against the previous frame and re-blend what changed. Afterwards
+    // each surface's dirty list says what to upload (empty = nothing).
+    void End() {
+        stats.frames++;
+        for (auto& s : surfaces) s.dirty.clear();
+
+        if (repaintAll) {
+            repaintAll = false;
+            stats.fullRepaints++;
+            for (auto& s : surfaces) AddDirty(s, { (int)s.bounds.left, (int)s.bounds.top, (int)s.bounds.right, (int)s.bounds.bottom });
+        } else {
+            Diff();
+        }
+
+        bool any = false;
+        for (auto& s : surfaces) {
+            if (s.tiled) TilesToRects(s);
+            if (s.dirty.empty()) continue;
+            any = true;
+            // Testing every item against every rect is cheaper until that
+            // costs more than one pass over the cells
+            bool bucketed = s.dirty.size() > 1 && s.dirty.size() * items.size() > (size_t)s.cellsX * s.cellsY;
+            if (bucketed) BucketItems(s);
+            s.dirtyBounds = s.dirty[0];
+            for (const DirtyRect& r : s.dirty) {
+                s.dirtyBounds = Union(s.dirtyBounds, r);
+                Repaint(s, r, bucketed);
+            }
+        }
+        if (!any) stats.idleFrames++;
+
+        // This frame is the next one's "before"
+        prevItems.swap(items);
+        prevSlot.assign(prevSlot.size(), -1);
+        for (int k = 0; k < (int)prevItems.size(); k++) {
+            int id = prevItems[k].id;
+            if (id >= (int)prevSlot.size()) prevSlot.resize(id + 1, -1);
+            prevSlot[id] = k;
+        }
+    }
+
+private:
+    std::vector<Surface> surfaces;
+    std::vector<CompositeItem> items, prevItems;
+    std::vector<int> prevSlot;      // id -> index in prevItems, -1 if absent
+    std::vector<char> seen;
+    std::vector<int> openRects, nextOpen;   // TilesToRects scratch: rects ending at the current tile row
+    std::vector<int> cursor;                // BucketItems scratch: next free slot per tile
+    std::vector<int> stamp, candidates;     // Repaint scratch: items already picked for this rect
+    int rectStamp = 0;
+    bool repaintAll = true;
+
+    static DirtyRect RectOf(const CompositeItem& it) { return { it.x, it.y, it.x + it.width, it.y + it.height }; }
+
+    static DirtyRect Union(const DirtyRect& a, const DirtyRect& b) {
+        return { a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top,
+                 a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom };
+    }
+
+    static DirtyRect Intersect(const DirtyRect& a, const DirtyRect& b) {
+        return { a.left > b.left ? a.left : b.left, a.top > b.top ? a.top : b.top,
+                 a.right < b.right ? a.right : b.right, a.bottom < b.bottom ? a.bottom : b.bottom };
+    }
+
+    void Diff() {
+        seen.assign(prevItems.size(), 0);
+        int lastSlot = -1;
+        for (const CompositeItem& it : items) {
+            int p = (it.id >= 0 && it.id < (int)prevSlot.size()) ? prevSlot[it.id] : -1;
+            if (p == -1) { MarkDirty(RectOf(it)); continue; }
+            seen[p] = 1;
+            const CompositeItem& old = prevItems[p];
+            if (old.x != it.x || old.y != it.y || old.width != it.width || old.height != it.height ||
+                old.content != it.content || old.pixels != it.pixels) {
+                MarkDirty(RectOf(old));
+                MarkDirty(RectOf(it));
+            } else if (p < lastSlot) {
+                // Now drawn above something it used to be under
+                MarkDirty(RectOf(it));
+            }
+            if (p > lastSlot) lastSlot = p;
+        }
+        for (int p = 0; p < (int)prevItems.size(); p++) {
+            if (!seen[p]) MarkDirty(RectOf(prevItems[p]));
+        }
+    }
+
+    void MarkDirty(const DirtyRect& r) {
+        for (auto& s : surfaces) AddDirty(s, r);
+    }
+
+    // Clip to the surface, then fold in every rect it overlaps until none do.
+    // Past MAX_DIRTY_RECTS, mark tiles instead: lots of small sprites changing
+    // all over the screen shouldn't turn into one screen-sized rect.
+    void AddDirty(Surface& s, DirtyRect r) {
+        r = Intersect(r, { (int)s.bounds.left, (int)s.bounds.top, (int)s.bounds.right, (int)s.bounds.bottom });
+        if (r.Empty()) return;
+        if (s.tiled) { MarkTiles(s, r); return; }
+        for (size_t j = 0; j < s.dirty.size(); ) {
+            if (!Intersect(r, s.dirty[j]).Empty()) {
+                r = Union(r, s.dirty[j]);
+                s.dirty[j] = s.dirty.back();
+                s.dirty.pop_back();
+                j = 0;
+            } else {
+                j++;
+            }
+        }
+        s.dirty.push_back(r);
+        if ((int)s.dirty.size() > MAX_DIRTY_RECTS) {
+            s.tiled = true;
+            for (const DirtyRect& d : s.dirty) MarkTiles(s, d);
+            s.dirty.clear();
+        }
+    }
+
+    void MarkTiles(Surface& s, const DirtyRect& r) {
+        int x0 = (r.left - (int)s.bounds.left) / TILE, x1 = (r.right - 1 - (int)s.bounds.left) / TILE;
+        int y0 = (r.top - (int)s.bounds.top) / TILE, y1 = (r.bottom - 1 - (int)s.bounds.top) / TILE;
+        for (int ty = y0; ty <= y1; ty++)
+            for (int tx = x0; tx <= x1; tx++) s.tiles[(size_t)ty * s.tilesX + tx] = 1;
+    }
+
+    // Runs of dirty tiles per tile row become rects; a run with the same
+    // columns as one ending just above extends it downwards instead
+    void TilesToRects(Surface& s) {
+        int ox = (int)s.bounds.left, oy = (int)s.bounds.top;
+        openRects.clear();
+        for (int ty = 0; ty < s.tilesY; ty++) {
+            int top = oy + ty * TILE;
+            int bottom = top + TILE < (int)s.bounds.bottom ? top + TILE : (int)s.bounds.bottom;
+            nextOpen.clear();
+            uint8_t* row = &s.tiles[(size_t)ty * s.tilesX];
+            for (int tx = 0; tx < s.tilesX; ) {
+                if (!row[tx]) { tx++; continue; }
+                int end = tx;
+                while (end < s.tilesX && row[end]) row[end++] = 0;
+                int left = ox + tx * TILE;
+                int right = ox + end * TILE < (int)s.bounds.right ? ox + end * TILE : (int)s.bounds.right;
+                int idx = -1;
+                for (int j : openRects) {
+                    if (s.dirty[j].left == left && s.dirty[j].right == right) { idx = j; break; }
+                }
+                if (idx != -1) {
+                    s.dirty[idx].bottom = bottom;
+                } else {
+                    idx = (int)s.dirty.size();
+                    s.dirty.push_back({ left, top, right, bottom });
+                }
+                nextOpen.push_back(idx);
+                tx = end;
+            }
+            openRects.swap(nextOpen);
+        }
+        s.tiled = false;
+    }
+
+    // Cell range [x0, x1] x [y0, y1] a rect (already clipped to s) covers
+    static void CellRange(const Surface& s, const DirtyRect& r, int& x0, int& y0, int& x1, int& y1) {
+        x0 = (r.left - (int)s.bounds.left) / CELL;
+        x1 = (r.right - 1 - (int)s.bounds.left) / CELL;
+        y0 = (r.top - (int)s.bounds.top) / CELL;
+        y1 = (r.bottom - 1 - (int)s.bounds.top) / CELL;
+    }
+
+    // Counting sort of this frame's items into the cells they touch, so a
+    // dirty rect only looks at items near it instead of all of them
+    void BucketItems(Surface& s) {
+        DirtyRect bounds = { (int)s.bounds.left, (int)s.bounds.top, (int)s.bounds.right, (int)s.bounds.bottom };
+        size_t cellCount = (size_t)s.cellsX * s.cellsY;
+        std::fill(s.bucketStart.begin(), s.bucketStart.end(), 0);
+        int x0, y0, x1, y1;
+        for (const CompositeItem& it : items) {
+            DirtyRect c = Intersect(bounds, RectOf(it));
+            if (c.Empty() || !it.pixels) continue;
+            CellRange(s, c, x0, y0, x1, y1);
+            for (int cy = y0; cy <= y1; cy++)
+                for (int cx = x0; cx <= x1; cx++) s.bucketStart[(size_t)cy * s.cellsX + cx + 1]++;
+        }
+        for (size_t c = 0; c < cellCount; c++) s.bucketStart[c + 1] += s.bucketStart[c];
+        s.bucketItems.resize(s.bucketStart[cellCount]);
+        cursor.assign(s.bucketStart.begin(), s.bucketStart.end() - 1);
+        for (int k = 0; k < (int)items.size(); k++) {
+            const CompositeItem& it = items[k];
+            DirtyRect c = Intersect(bounds, RectOf(it));
+            if (c.Empty() || !it.pixels) continue;
+            CellRange(s, c, x0, y0, x1, y1);
+            for (int cy = y0; cy <= y1; cy++)
+                for (int cx = x0; cx <= x1; cx++) s.bucketItems[cursor[(size_t)cy * s.cellsX + cx]++] = k;
+        }
+    }
+
+    // Clear r, then blend every item that touches it, bottom to top
+    void Repaint(Surface& s, const DirtyRect& r, bool bucketed) {
+        stats.dirtyRects++;
+        stats.dirtyPixels += (unsigned long long)r.Area();
+        int ox = (int)s.bounds.left, oy = (int)s.bounds.top;
+        for (int y = r.top; y < r.bottom; y++) {
+            memset(s.pixels + (size_t)(y - oy) * s.stride + (r.left - ox), 0, (size_t)(r.right - r.left) * 4);
+        }
+        if (!bucketed) {
+            for (const CompositeItem& it : items) Blend(s, r, it);
+            return;
+        }
+        // Items in the cells under r, each once, in draw order
+        if (stamp.size() < items.size()) stamp.resize(items.size(), 0);
+        if (++rectStamp == 0) { std::fill(stamp.begin(), stamp.end(), 0); rectStamp = 1; }
+        candidates.clear();
+        int x0, y0, x1, y1;
+        CellRange(s, r, x0, y0, x1, y1);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                size_t cell = (size_t)cy * s.cellsX + cx;
+                for (int b = s.bucketStart[cell]; b < s.bucketStart[cell + 1]; b++) {
+                    int k = s.bucketItems[b];
+                    if (stamp[k] != rectStamp) { stamp[k] = rectStamp; candidates.push_back(k); }
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (int k : candidates) Blend(s, r, items[k]);
+    }
+
+    // The part of 'it' inside r
+    void Blend(Surface& s, const DirtyRect& r, const CompositeItem& it) {
+        DirtyRect c = Intersect(r, RectOf(it));
+        if (c.Empty() || !it.pixels) return;
+        stats.blendedPixels += (unsigned long long)c.Area();
+        int ox = (int)s.bounds.left, oy = (int)s.bounds.top;
+        for (int y = c.top; y < c.bottom; y++) {
+            const uint32_t* src = it.pixels + (size_t)(y - it.y) * it.width + (c.left - it.x);
+            uint32_t* dst = s.pixels + (size_t)(y - oy) * s.stride + (c.left - ox);
+            PixelKernels::BlendOver(src, dst, c.right - c.left);
+        }
+    }
+};
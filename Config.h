@@ -0,0 +1,59 @@
+#pragma once
+
+// ==========================================
+//           USER CONFIGURATION
+// ==========================================
+namespace Config {
+    // --- PHYSICS ---
+    const int TICK_RATE       = 33;
+    const int TICK_RATE_REST  = 250;   // Upper bound on sleep while SITTING/SLEEPING/WATCHING_MOVIE
+    const int ENV_WAKE_GRACE_MS = 500; // Full rate for this long after any window event
+    // Speeds are px per PHYSICS_STEP_MS (accelerations per step squared), not
+    // per tick, so TICK_RATE can change without changing how the character moves
+    const int PHYSICS_STEP_MS = 33;
+    const int GRAVITY         = 3;
+    const int MAX_FALL_SPEED  = 25;
+    const int WALK_SPEED      = 4;
+    const int LEAP_SPEED      = 25;
+
+    // --- AI LOGIC (Cumulative Thresholds out of 10,000) ---
+    const int THRESH_IDLE_TO_WALK  = 150;
+    const int THRESH_IDLE_TO_SIT   = 300;
+    const int THRESH_IDLE_TO_SLEEP = 350;
+
+    const int CHANCE_STOP_WALKING  = 100;
+    const int CHANCE_STAND_UP      = 50;
+    const int CHANCE_WAKE_UP       = 5;
+
+    // Jump Logic
+    const int CHANCE_CHECK_JUMP    = 500;
+    const int JUMP_UP_BIAS         = 70;
+    const float JUMP_RANGE_PCT     = 0.20f;
+    const int MIN_LEDGE_WIDTH      = 20;   // Narrower visible strips aren't worth landing on
+    const int CHANCE_PICK_ROUTE    = 10;   // % of jump checks that pick a far ledge to travel to
+
+    // --- TIMING ---
+    const int MIN_STATE_TIME     = 2000;
+    const int SNAPSHOT_RESYNC_MS = 5000;  // Re-enumerate anyway if no window events arrive
+    const int WINDOW_PREDICT_MS  = 100;   // Carry on with a moving window's velocity this long between enumerations, then hold
+    const int WINDOW_VELOCITY_MS = 250;   // Enumerations further apart than this start a new velocity estimate
+
+    // --- ANIMATION SPEEDS ---
+    const int SPEED_WALK      = 150;
+    const int SPEED_IDLE      = 800;
+    const int SPEED_SIT       = 1000;
+    const int SPEED_SLEEP     = 2000;
+    const int SPEED_MOVIE     = 1500;
+    const int SPEED_JUMP_PREP = 500;
+    const int SPEED_AIR       = 50;
+
+    // --- SPRITES ---
+    const int SPRITE_BUDGET_KB = 8192;    // Decoded sprite sets and the frames scaled from them (--sprite-budget=<KB> overrides)
+
+    // --- PROFILING ---
+    const int PROFILE_RING_SIZE = 16384;  // Trace events kept with --profile (power of two)
+
+    // --- VISUALS ---
+    const int BREATH_DEPTH    = 3;
+    const int BREATH_SPEED    = 400;
+}
@@ -0,0 +1,559 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "Environment.h"
+#include "WindowCache.h"
+#include "Simulation.h"
+#include "TitleMatcher.h"
+
+// ==========================================
+//              DESKTOP TRACE
+// ==========================================
+// Records everything the simulation learned from the platform (window lists,
+// monitor work areas, foreground titles), the events that made it look, and
+// the tick times, so a session can be replayed headless: same seed, same
+// inputs, same ticks. A replay doubles as a regression test (where the
+// character was after each tick is recorded too) and as a perf workload.
+//
+// File: "DBTR", u32 version, then varint-encoded records, each a tag byte
+// followed by its payload. Action records (tick, event...) are followed by
+// the data the platform returned while that action ran, then optionally the
+// character's position after it. Rect lists are encoded against the previous
+// list of the same kind: runs copied from it, seeks for z-order changes, and
+// literal rects as deltas, so a drag costs a few bytes, not the whole desktop.
+// Version 2 adds window ids; version 1 traces still replay (without them).
+
+const uint32_t TRACE_VERSION = 2;
+
+enum TraceTag {
+    // Actions
+    TRACE_TICK = 1,             // varint ms since the previous tick (or since start)
+    TRACE_WINDOW_EVENT = 2,     // byte WindowEventType
+    TRACE_TITLE_EVENT = 3,
+    TRACE_ENV_UPDATE = 4,       // Simulation::UpdateEnvironment (startup, display change)
+    TRACE_PLACE = 5,            // Simulation::PlaceOnFirstMonitor
+    TRACE_ANIMATION = 6,        // varint state, frames, ms per frame
+    TRACE_ALWAYS_REFRESH = 7,   // Hooks unavailable: the cache enumerates every tick
+    TRACE_TITLE_RULES = 8,      // varint count, then per rule: varint state, string
+    // Data returned to the action before it
+    TRACE_MONITORS = 16,        // Rect list
+    TRACE_WINDOWS = 17,         // Rect list
+    TRACE_TITLE = 18,           // varint 0 = same as last, else 1 then a string
+    // After a tick: what changed about the character (absent = nothing)
+    TRACE_CHECK = 19,           // varint flags (1 = moved, 2 = state), zigzag dx dy, varint state
+    TRACE_WINDOW_IDS = 20       // varint 0 = same as last, else 1, count, zigzag deltas vs. the last list
+};
+
+// Varints, zigzag and the delta-coded rect lists, shared by both directions
+class TraceCodec {
+public:
+    static void PutVarint(std::vector<uint8_t>& out, unsigned long long v) {
+        while (v >= 0x80) { out.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+        out.push_back((uint8_t)v);
+    }
+    static void PutSigned(std::vector<uint8_t>& out, long long v) {
+        PutVarint(out, ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63));
+    }
+
+    static bool GetVarint(const std::vector<uint8_t>& in, size_t& pos, unsigned long long& v) {
+        v = 0;
+        for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+            uint8_t b = in[pos++];
+            v |= (unsigned long long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    static bool GetSigned(const std::vector<uint8_t>& in, size_t& pos, long long& v) {
+        unsigned long long u;
+        if (!GetVarint(in, pos, u)) return false;
+        v = (long long)(u >> 1) ^ -(long long)(u & 1);
+        return true;
+    }
+
+    // Strings: varint length, then the UTF-16 units as varints
+    static void PutString(std::vector<uint8_t>& out, const std::wstring& s) {
+        PutVarint(out, s.size());
+        for (wchar_t c : s) PutVarint(out, (unsigned long long)(uint16_t)c);
+    }
+    static bool GetString(const std::vector<uint8_t>& in, size_t& pos, std::wstring& s) {
+        unsigned long long len, u;
+        if (!GetVarint(in, pos, len) || len > in.size() - pos) return false;
+        s.clear();
+        for (unsigned long long k = 0; k < len; k++) {
+            if (!GetVarint(in, pos, u)) return false;
+            s.push_back((wchar_t)u);
+        }
+        return true;
+    }
+
+    // Ops: varint (n << 2 | kind). COPY n rects from prev at the cursor; LITERAL
+    // n rects coded against prev at the cursor (or the last rect written);
+    // SEEK moves the cursor by zigzag(n).
+    enum { OP_COPY = 0, OP_LITERAL = 1, OP_SEEK = 2 };
+
+    static void PutRects(std::vector<uint8_t>& out, const std::vector<RectArea>& rects, const std::vector<RectArea>& prev) {
+        PutVarint(out, rects.size());
+        // Where each old rect sits, for windows that changed place in the z-order
+        std::map<std::tuple<long, long, long, long>, std::vector<int>> where;
+        bool indexed = false;
+
+        long long src = 0;
+        RectArea last = { 0, 0, 0, 0 };
+        size_t i = 0;
+        while (i < rects.size()) {
+            if (src < (long long)prev.size() && Same(rects[i], prev[src])) {
+                size_t n = 0;
+                while (i + n < rects.size() && src + (long long)n < (long long)prev.size() && Same(rects[i + n], prev[src + n])) n++;
+                PutVarint(out, (n << 2) | OP_COPY);
+                i += n;
+                src += n;
+                last = prev[src - 1];
+                continue;
+            }
+            if (!indexed) {
+                for (int j = (int)prev.size() - 1; j >= 0; j--) where[Key(prev[j])].push_back(j);
+                indexed = true;
+            }
+            auto it = where.find(Key(rects[i]));
+            if (it != where.end()) {
+                // Nearest occurrence ahead of the cursor keeps seeks short
+                int target = it->second.back();
+                for (int j : it->second) if (j >= src && (target < src || j < target)) target = j;
+                PutVarint(out, (((unsigned long long)Zig(target - src)) << 2) | OP_SEEK);
+                src = target;
+                continue;
+            }
+            // Literal run until something matches again
+            size_t n = 1;
+            while (i + n < rects.size() && !(src + (long long)n < (long long)prev.size() && Same(rects[i + n], prev[src + n])) &&
+                   where.find(Key(rects[i + n])) == where.end()) n++;
+            PutVarint(out, (n << 2) | OP_LITERAL);
+            for (size_t k = 0; k < n; k++) {
+                const RectArea& base = (src + (long long)k < (long long)prev.size()) ? prev[src + k] : last;
+                const RectArea& r = rects[i + k];
+                PutSigned(out, r.left - base.left);
+                PutSigned(out, r.top - base.top);
+                PutSigned(out, (r.right - r.left) - (base.right - base.left));
+                PutSigned(out, (r.bottom - r.top) - (base.bottom - base.top));
+                last = r;
+            }
+            i += n;
+            src += n;
+        }
+    }
+
+    static bool GetRects(const std::vector<uint8_t>& in, size_t& pos, std::vector<RectArea>& rects, const std::vector<RectArea>& prev) {
+        unsigned long long count;
+        if (!GetVarint(in, pos, count)) return false;
+        rects.clear();
+        long long src = 0;
+        RectArea last = { 0, 0, 0, 0 };
+        while (rects.size() < count) {
+            unsigned long long op;
+            if (!GetVarint(in, pos, op)) return false;
+            unsigned long long n = op >> 2;
+            if ((op & 3) != OP_SEEK && (n == 0 || n > count - rects.size())) return false;
+            switch (op & 3) {
+            case OP_COPY:
+                if (src < 0 || src + (long long)n > (long long)prev.size()) return false;
+                for (unsigned long long k = 0; k < n; k++) rects.push_back(prev[src + k]);
+                src += n;
+                last = rects.back();
+                break;
+            case OP_LITERAL:
+                for (unsigned long long k = 0; k < n; k++) {
+                    const RectArea& base = (src >= 0 && src + (long long)k < (long long)prev.size()) ? prev[src + k] : last;
+                    long long dl, dt, dw, dh;
+                    if (!GetSigned(in, pos, dl) || !GetSigned(in, pos, dt) || !GetSigned(in, pos, dw) || !GetSigned(in, pos, dh)) return false;
+                    RectArea r;
+                    r.left = base.left + (long)dl;
+                    r.top = base.top + (long)dt;
+                    r.right = r.left + (base.right - base.left) + (long)dw;
+                    r.bottom = r.top + (base.bottom - base.top) + (long)dh;
+                    rects.push_back(r);
+                    last = r;
+                }
+                src += n;
+                break;
+            case OP_SEEK:
+                src += (long long)(n >> 1) ^ -(long long)(n & 1);
+                break;
+            default:
+                return false;
+            }
+            if (rects.size() > count) return false;
+        }
+        return true;
+    }
+
+    // Ids mostly stay put (drags, resizes); z-order changes cost a few bytes each
+    static void PutIds(std::vector<uint8_t>& out, const std::vector<WindowId>& ids, const std::vector<WindowId>& prev) {
+        if (ids == prev) { PutVarint(out, 0); return; }
+        PutVarint(out, 1);
+        PutVarint(out, ids.size());
+        for (size_t i = 0; i < ids.size(); i++) PutSigned(out, (long long)(ids[i] - (i < prev.size() ? prev[i] : 0)));
+    }
+
+    static bool GetIds(const std::vector<uint8_t>& in, size_t& pos, std::vector<WindowId>& ids) {
+        unsigned long long changed, count;
+        if (!GetVarint(in, pos, changed)) return false;
+        if (!changed) return true;
+        if (!GetVarint(in, pos, count) || count > in.size() - pos) return false;
+        ids.resize((size_t)count);
+        for (size_t i = 0; i < ids.size(); i++) {
+            long long d;
+            if (!GetSigned(in, pos, d)) return false;
+            ids[i] += (WindowId)d;
+        }
+        return true;
+    }
+
+private:
+    static bool Same(const RectArea& a, const RectArea& b) {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+    static std::tuple<long, long, long, long> Key(const RectArea& r) {
+        return std::make_tuple(r.left, r.top, r.right, r.bottom);
+    }
+    static unsigned long long Zig(long long v) { return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63); }
+};
+
+// ==========================================
+//              RECORDER
+// ==========================================
+// Sits between the simulation and the real provider. Pass-through until
+// Open()/Start(); after that every answer is recorded. The platform reports
+// the actions (ticks, hook events...) as it performs them.
+
+class TraceRecorder : public EnvironmentProvider {
+public:
+    unsigned long long ticks = 0;
+    unsigned long long rawBytes = 0;    // What the rect lists would take as plain 16-byte rects
+
+    explicit TraceRecorder(EnvironmentProvider& inner) : inner(inner) {}
+    ~TraceRecorder() { Close(); }
+
+    // Record into memory only (see Data())
+    void Start(unsigned long long seed, unsigned long long startTime) {
+        buffer.clear();
+        flushedBytes = 0;
+        ticks = 0;
+        rawBytes = 0;
+        buffer.resize(8);
+        memcpy(buffer.data(), "DBTR", 4);
+        for (int i = 0; i < 4; i++) buffer[4 + i] = (uint8_t)(TRACE_VERSION >> (8 * i));
+        TraceCodec::PutVarint(buffer, seed);
+        TraceCodec::PutVarint(buffer, startTime);
+        lastTick = startTime;
+        prevMonitors.clear();
+        prevWindows.clear();
+        prevIds.clear();
+        lastTitle.clear();
+        hasCheck = false;
+        recording = true;
+    }
+
+    // Record to a file, flushed in blocks
+    bool Open(const char* path, unsigned long long seed, unsigned long long startTime) {
+        file = fopen(path, "wb");
+        if (!file) return false;
+        Start(seed, startTime);
+        return true;
+    }
+
+    void Close() {
+        if (!recording) return;
+        Flush();
+        if (file) fclose(file);
+        file = nullptr;
+        recording = false;
+    }
+
+    bool Recording() const { return recording; }
+    const std::vector<uint8_t>& Data() const { return buffer; }
+    unsigned long long Bytes() const { return flushedBytes + buffer.size(); }
+
+    // --- Actions, reported before they run ---
+    void Tick(unsigned long long now) {
+        if (!recording) return;
+        Put(TRACE_TICK);
+        TraceCodec::PutVarint(buffer, now - lastTick);
+        lastTick = now;
+        ticks++;
+    }
+    void WindowEvent(WindowEventType type) {
+        if (!recording) return;
+        Put(TRACE_WINDOW_EVENT);
+        buffer.push_back((uint8_t)type);
+    }
+    void TitleEvent() { if (recording) Put(TRACE_TITLE_EVENT); }
+    void EnvironmentUpdate() { if (recording) Put(TRACE_ENV_UPDATE); }
+    void Place() { if (recording) Put(TRACE_PLACE); }
+    void AlwaysRefresh() { if (recording) Put(TRACE_ALWAYS_REFRESH); }
+    void TitleRules(const std::vector<TitleRule>& rules) {
+        if (!recording) return;
+        Put(TRACE_TITLE_RULES);
+        TraceCodec::PutVarint(buffer, rules.size());
+        for (const auto& r : rules) {
+            TraceCodec::PutVarint(buffer, (unsigned long long)r.state);
+            TraceCodec::PutString(buffer, r.pattern);
+        }
+    }
+    void Animation(State state, int frames, int msPerFrame) {
+        if (!recording) return;
+        Put(TRACE_ANIMATION);
+        TraceCodec::PutVarint(buffer, (unsigned long long)state);
+        TraceCodec::PutVarint(buffer, (unsigned long long)frames);
+        TraceCodec::PutVarint(buffer, (unsigned long long)msPerFrame);
+    }
+
+    // --- After a tick: where the character ended up ---
+    void Checkpoint(const Simulation& sim) {
+        if (!recording) return;
+        unsigned flags = 0;
+        if (!hasCheck || sim.posX != checkX || sim.posY != checkY) flags |= 1;
+        if (!hasCheck || sim.currentState != checkState) flags |= 2;
+        if (flags) {
+            Put(TRACE_CHECK);
+            TraceCodec::PutVarint(buffer, flags);
+            if (flags & 1) {
+                TraceCodec::PutSigned(buffer, (long long)sim.posX - checkX);
+                TraceCodec::PutSigned(buffer, (long long)sim.posY - checkY);
+            }
+            if (flags & 2) TraceCodec::PutVarint(buffer, (unsigned long long)sim.currentState);
+        }
+        hasCheck = true;
+        checkX = sim.posX;
+        checkY = sim.posY;
+        checkState = sim.currentState;
+        if (file && buffer.size() >= FLUSH_BYTES) Flush();
+    }
+
+    // --- EnvironmentProvider ---
+    void GetMonitors(std::vector<RectArea>& out) override {
+        inner.GetMonitors(out);
+        if (!recording) return;
+        Put(TRACE_MONITORS);
+        TraceCodec::PutRects(buffer, out, prevMonitors);
+        prevMonitors = out;
+        rawBytes += out.size() * 16;
+    }
+    void GetWindows(std::vector<RectArea>& out) override {
+        inner.GetWindows(out);
+        if (!recording) return;
+        Put(TRACE_WINDOWS);
+        TraceCodec::PutRects(buffer, out, prevWindows);
+        prevWindows = out;
+        rawBytes += out.size() * 16;
+    }
+    void GetWindowIds(std::vector<WindowId>& out) override {
+        inner.GetWindowIds(out);
+        if (!recording || (out.empty() && prevIds.empty())) return;
+        Put(TRACE_WINDOW_IDS);
+        TraceCodec::PutIds(buffer, out, prevIds);
+        prevIds = out;
+        rawBytes += out.size() * 8;
+    }
+    std::wstring GetForegroundTitle() override {
+        std::wstring title = inner.GetForegroundTitle();
+        if (!recording) return title;
+        Put(TRACE_TITLE);
+        if (title == lastTitle) {
+            TraceCodec::PutVarint(buffer, 0);
+        } else {
+            TraceCodec::PutVarint(buffer, 1);
+            TraceCodec::PutString(buffer, title);
+            lastTitle = title;
+        }
+        return title;
+    }
+
+private:
+    static const size_t FLUSH_BYTES = 64 * 1024;
+
+    EnvironmentProvider& inner;
+    bool recording = false;
+    FILE* file = nullptr;
+    std::vector<uint8_t> buffer;    // Unflushed bytes (everything, without a file)
+    unsigned long long flushedBytes = 0;
+    unsigned long long lastTick = 0;
+    std::vector<RectArea> prevMonitors;
+    std::vector<RectArea> prevWindows;
+    std::vector<WindowId> prevIds;
+    std::wstring lastTitle;
+    bool hasCheck = false;
+    int checkX = 0, checkY = 0;
+    State checkState = FALLING;
+
+    void Put(TraceTag tag) { buffer.push_back((uint8_t)tag); }
+
+    void Flush() {
+        if (!file) return;
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        flushedBytes += buffer.size();
+        buffer.clear();
+    }
+};
+
+// ==========================================
+//              REPLAYER
+// ==========================================
+// The recorded desktop as an EnvironmentProvider: it answers with whatever
+// was last recorded, so a simulation that asks at different moments than the
+// original still sees the desktop as it was at that tick.
+
+class TraceReplayer : public EnvironmentProvider {
+public:
+    unsigned long long ticks = 0;
+    unsigned long long divergedTicks = 0;      // Ticks that ended somewhere other than recorded
+    unsigned long long firstDivergence = 0;    // Tick number (1-based), 0 if none
+    bool corrupt = false;
+
+    bool Load(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f) return false;
+        data.clear();
+        uint8_t block[65536];
+        size_t n;
+        while ((n = fread(block, 1, sizeof(block), f)) > 0) data.insert(data.end(), block, block + n);
+        fclose(f);
+        return Begin();
+    }
+
+    bool Attach(const std::vector<uint8_t>& bytes) {
+        data = bytes;
+        return Begin();
+    }
+
+    unsigned long long Seed() const { return seed; }
+    unsigned long long StartTime() const { return startTime; }
+    size_t Bytes() const { return data.size(); }
+
+    // Run the next action against 'sim' (built on this replayer and 'clock').
+    // False at the end of the trace, or if it is damaged (see 'corrupt').
+    bool Step(Simulation& sim, ManualClock& clock) {
+        if (pos >= data.size()) return false;
+        uint8_t action = data[pos++];
+        unsigned long long a = 0, b = 0, c = 0;
+        switch (action) {
+        case TRACE_TICK: if (!TraceCodec::GetVarint(data, pos, a)) return Fail(); break;
+        case TRACE_WINDOW_EVENT: if (pos >= data.size()) return Fail(); a = data[pos++]; break;
+        case TRACE_ANIMATION:
+            if (!TraceCodec::GetVarint(data, pos, a) || !TraceCodec::GetVarint(data, pos, b) ||
+                !TraceCodec::GetVarint(data, pos, c) || a >= STATE_COUNT) return Fail();
+            break;
+        case TRACE_TITLE_RULES:
+            if (!TraceCodec::GetVarint(data, pos, a) || a > data.size() - pos) return Fail();
+            rules.resize((size_t)a);
+            for (auto& r : rules) {
+                if (!TraceCodec::GetVarint(data, pos, b) || b >= STATE_COUNT || !TraceCodec::GetString(data, pos, r.pattern)) return Fail();
+                r.state = (State)b;
+            }
+            break;
+        case TRACE_TITLE_EVENT: case TRACE_ENV_UPDATE: case TRACE_PLACE: case TRACE_ALWAYS_REFRESH: break;
+        default: return Fail();
+        }
+
+        // What the platform said while this action ran, and where it left the character
+        bool check = false;
+        unsigned long long flags = 0;
+        long long dx = 0, dy = 0;
+        unsigned long long state = 0;
+        while (pos < data.size() && data[pos] >= TRACE_MONITORS) {
+            uint8_t tag = data[pos++];
+            if (tag == TRACE_MONITORS) {
+                if (!TraceCodec::GetRects(data, pos, scratch, monitors)) return Fail();
+                monitors.swap(scratch);
+            } else if (tag == TRACE_WINDOWS) {
+                if (!TraceCodec::GetRects(data, pos, scratch, windows)) return Fail();
+                windows.swap(scratch);
+            } else if (tag == TRACE_WINDOW_IDS) {
+                if (!TraceCodec::GetIds(data, pos, windowIds)) return Fail();
+            } else if (tag == TRACE_TITLE) {
+                unsigned long long changed;
+                if (!TraceCodec::GetVarint(data, pos, changed)) return Fail();
+                if (changed && !TraceCodec::GetString(data, pos, title)) return Fail();
+            } else if (tag == TRACE_CHECK) {
+                check = true;
+                if (!TraceCodec::GetVarint(data, pos, flags)) return Fail();
+                if ((flags & 1) && (!TraceCodec::GetSigned(data, pos, dx) || !TraceCodec::GetSigned(data, pos, dy))) return Fail();
+                if ((flags & 2) && !TraceCodec::GetVarint(data, pos, state)) return Fail();
+            } else {
+                return Fail();
+            }
+        }
+
+        switch (action) {
+        case TRACE_TICK:
+            clock.time = (lastTick += a);
+            sim.Tick();
+            ticks++;
+            if (check) {
+                if (flags & 1) { expectX += (int)dx; expectY += (int)dy; }
+                if (flags & 2) expectState = (State)state;
+            }
+            if (sim.posX != expectX || sim.posY != expectY || sim.currentState != expectState) {
+                divergedTicks++;
+                if (!firstDivergence) firstDivergence = ticks;
+            }
+            break;
+        case TRACE_WINDOW_EVENT: sim.windowCache.OnWindowEvent((WindowEventType)a); break;
+        case TRACE_TITLE_EVENT: sim.OnTitleChanged(); break;
+        case TRACE_ENV_UPDATE: sim.UpdateEnvironment(); break;
+        case TRACE_PLACE: sim.PlaceOnFirstMonitor(); break;
+        case TRACE_ANIMATION: sim.SetAnimation((State)a, (int)b, (int)c); break;
+        case TRACE_ALWAYS_REFRESH: sim.windowCache.SetAlwaysRefresh(true); break;
+        case TRACE_TITLE_RULES: sim.SetTitleRules(rules); break;
+        }
+        return true;
+    }
+
+    // --- EnvironmentProvider ---
+    void GetMonitors(std::vector<RectArea>& out) override { out = monitors; }
+    void GetWindows(std::vector<RectArea>& out) override { out = windows; }
+    void GetWindowIds(std::vector<WindowId>& out) override { out = windowIds; }
+    std::wstring GetForegroundTitle() override { return title; }
+
+private:
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    unsigned long long seed = 0, startTime = 0, lastTick = 0;
+    std::vector<RectArea> monitors, windows, scratch;
+    std::vector<WindowId> windowIds;
+    std::wstring title;
+    std::vector<TitleRule> rules;
+    int expectX = 0, expectY = 0;
+    State expectState = FALLING;
+
+    bool Begin() {
+        pos = 0;
+        corrupt = false;
+        ticks = divergedTicks = firstDivergence = 0;
+        monitors.clear();
+        windows.clear();
+        windowIds.clear();
+        title.clear();
+        expectX = expectY = 0;
+        expectState = FALLING;
+        if (data.size() < 8 || memcmp(data.data(), "DBTR", 4) != 0) return Fail();
+        uint32_t version = 0;
+        for (int i = 0; i < 4; i++) version |= (uint32_t)data[4 + i] << (8 * i);
+        if (version < 1 || version > TRACE_VERSION) return Fail();
+        pos = 8;
+        if (!TraceCodec::GetVarint(data, pos, seed) || !TraceCodec::GetVarint(data, pos, startTime)) return Fail();
+        lastTick = startTime;
+        return true;
+    }
+
+    bool Fail() {
+        corrupt = true;
+        pos = data.size();
+        return false;
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// ==========================================
+//          DESKTOP ENVIRONMENT
+// ==========================================
+// What the simulation knows about the desktop, independent of Win32.
+
+struct RectArea { long left, top, right, bottom; };
+struct PointXY { int x, y; };
+typedef unsigned long long WindowId;    // Platform handle (HWND), stable for a window's lifetime
+
+// --- ENVIRONMENT ---
+class EnvironmentProvider {
+public:
+    virtual ~EnvironmentProvider() {}
+    virtual void GetMonitors(std::vector<RectArea>& out) = 0;   // work areas
+    virtual void GetWindows(std::vector<RectArea>& out) = 0;    // sorted Top-to-Bottom (0 is top)
+    // Parallel to the last GetWindows answer; empty if the platform can't tell windows apart
+    virtual void GetWindowIds(std::vector<WindowId>& out) { out.clear(); }
+    virtual std::wstring GetForegroundTitle() = 0;
+};
+
+// Headless environment: a fixed desktop the caller edits directly.
+class StaticEnvironment : public EnvironmentProvider {
+public:
+    std::vector<RectArea> monitors;
+    std::vector<RectArea> windows;
+    std::vector<WindowId> windowIds;    // Empty, or one per window
+    std::wstring title;
+
+    void GetMonitors(std::vector<RectArea>& out) override { out = monitors; }
+    void GetWindows(std::vector<RectArea>& out) override { out = windows; }
+    void GetWindowIds(std::vector<WindowId>& out) override { out = windowIds; }
+    std::wstring GetForegroundTitle() override { return title; }
+};
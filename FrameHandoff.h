@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// ==========================================
+//              FRAME HANDOFF
+// ==========================================
+// Single-producer / single-consumer triple buffer between the simulation
+// thread and the render thread. The simulation publishes a complete frame
+// descriptor every tick and never waits; the renderer picks up the newest one
+// whenever it gets round to it. Descriptors the renderer was too slow for are
+// overwritten (counted as dropped), never read half-written.
+
+// Everything the renderer needs from one simulation tick, by value
+struct FrameDesc {
+    unsigned long long seq = 0;           // 1, 2, 3... per publish
+    uint64_t publishNs = 0;               // Profiler clock, for handoff latency
+    int state = 0;
+    int frame = 0;
+    bool facingRight = true;
+    int posX = 0, posY = 0;
+    int screenH = 1080;                   // Reference height for the smart size
+    unsigned long long displayEpoch = 0;  // Changes when cached surfaces must be dropped
+};
+
+// One swarm walker, as much as the renderer needs
+struct WalkerDesc {
+    int state, frame;
+    bool facingRight;
+    int posX, posY;
+};
+
+// All swarm walkers from one tick. Copying into a slot reuses its capacity,
+// so once the count settles publishing doesn't allocate.
+struct SwarmDesc {
+    unsigned long long seq = 0;
+    std::vector<WalkerDesc> walkers;
+};
+
+template <typename T>
+class TripleBuffer {
+public:
+    std::atomic<unsigned long long> published{0};
+    std::atomic<unsigned long long> consumed{0};
+    std::atomic<unsigned long long> dropped{0};   // Overwritten before the consumer saw them
+
+    // Producer: copy in and make it the newest value
+    void Publish(const T& value) {
+        slots[back].value = value;
+        int prev = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = prev & INDEX;
+        if (prev & FRESH) dropped.fetch_add(1, std::memory_order_relaxed);
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer: the newest value, if one arrived since the last call
+    bool Acquire(T& out) {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+        int prev = middle.exchange(front, std::memory_order_acq_rel);
+        front = prev & INDEX;
+        out = slots[front].value;
+        consumed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    // Own cache line each, so the two threads never share one
+    struct alignas(64) Slot { T value; };
+
+    Slot slots[3];
+    alignas(64) std::atomic<int> middle{1};   // Shared slot index, FRESH once published
+    alignas(64) int back = 0;                 // Producer's slot
+    alignas(64) int front = 2;                // Consumer's slot
+};
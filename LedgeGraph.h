@@ -0,0 +1,252 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "Config.h"
+#include "Environment.h"
+#include "WalkableMap.h"
+
+// ==========================================
+//              LEDGE GRAPH
+// ==========================================
+// Nodes are the walkable spans at least MIN_LEDGE_WIDTH wide (see
+// WalkableMap.h) plus monitor floors. Edges are jumps that fit the
+// JUMP_RANGE_PCT rules. When the snapshot changes, ledges of windows the
+// walkable map carried over keep their ledges and the edges between them.
+
+struct Ledge {
+    long left, right;   // Visible span of the top edge
+    long y;
+    int windowIndex;    // Index into the snapshot, -1 for a monitor floor
+
+    int AnchorX() const { return (int)((left + right) / 2); }
+};
+
+class LedgeGraph {
+public:
+    std::vector<Ledge> ledges;               // Window order, then floors
+    std::vector<std::vector<int>> edges;     // Ledge -> ledges you can jump to
+    unsigned long long version = 0;          // Bumps whenever ledges/edges change
+
+    unsigned long long fullRebuilds = 0;
+    unsigned long long incrementalUpdates = 0;
+    unsigned long long ledgesReused = 0;
+
+    int MaxRange() const { return maxRange; }
+
+    // 'walkable' must already be built from the same windows and monitors.
+    // Patching needs the build right after the one this graph last saw.
+    void Update(const std::vector<RectArea>& windows, const std::vector<RectArea>& monitors, const WalkableMap& walkable) {
+        if (built && walkable.Patched() && walkable.builds == walkableBuild + 1) {
+            Incremental(windows, monitors, walkable);
+        } else {
+            Rebuild(windows, monitors, walkable);
+        }
+        walkableBuild = walkable.builds;
+        built = true;
+        version++;
+    }
+
+    // Ledge the character is standing on, or -1
+    int LedgeAt(int x, int y) const {
+        auto it = std::lower_bound(byY.begin(), byY.end(), y,
+            [this](int id, int v) { return ledges[id].y < v; });
+        for (; it != byY.end() && ledges[*it].y == y; ++it) {
+            const Ledge& l = ledges[*it];
+            if (x >= l.left && x <= l.right) return *it;
+        }
+        return -1;
+    }
+
+private:
+    bool built = false;
+    unsigned long long walkableBuild = 0;
+    int maxRange = 0;
+    std::vector<int> windowFirst;   // First ledge of each window (count via windowCount)
+    std::vector<int> windowCount;
+    std::vector<int> byY;           // Ledge ids sorted by (y, left)
+
+    // Same range rule the jump search always used
+    static int ComputeMaxRange(const std::vector<RectArea>& monitors) {
+        int minDim = 10000;
+        for (const auto& mon : monitors) {
+            int w = mon.right - mon.left;
+            int h = mon.bottom - mon.top;
+            if (w < minDim) minDim = w;
+            if (h < minDim) minDim = h;
+        }
+        return (int)(minDim * Config::JUMP_RANGE_PCT);
+    }
+
+    // Ledges of window i: its walkable spans, minus the slivers too narrow to stand on
+    static void WindowLedges(const WalkableMap& walkable, int i, std::vector<Ledge>& out) {
+        for (int k = walkable.WindowBegin(i); k < walkable.WindowEnd(i); k++) {
+            const WalkSpan& s = walkable.spans[k];
+            if (s.right - s.left + 1 < Config::MIN_LEDGE_WIDTH) continue;
+            out.push_back({ s.left, s.right, s.y, i });
+        }
+    }
+
+    bool CanJump(const Ledge& from, const Ledge& to, const std::vector<RectArea>& monitors) const {
+        int bx = to.AnchorX();
+        long by = to.y;
+        if (std::abs(by - from.y) < 30) return false;
+        for (const auto& mon : monitors) if (by < mon.top + 50) return false;
+        // Closest take-off point on the source ledge
+        long cx = bx < from.left ? from.left : (bx > from.right ? from.right : bx);
+        double dist = std::sqrt(std::pow((double)(bx - cx), 2) + std::pow((double)(by - from.y), 2));
+        return dist <= maxRange;
+    }
+
+    void AddFloors(const WalkableMap& walkable) {
+        for (const auto& f : walkable.floors) ledges.push_back({ f.left, f.right, f.y, -1 });
+    }
+
+    void Finish() {
+        for (auto& e : edges) std::sort(e.begin(), e.end());
+        byY.resize(ledges.size());
+        for (size_t i = 0; i < ledges.size(); i++) byY[i] = (int)i;
+        std::sort(byY.begin(), byY.end(), [this](int a, int b) {
+            if (ledges[a].y != ledges[b].y) return ledges[a].y < ledges[b].y;
+            return ledges[a].left < ledges[b].left;
+        });
+    }
+
+    void Rebuild(const std::vector<RectArea>& windows, const std::vector<RectArea>& monitors, const WalkableMap& walkable) {
+        fullRebuilds++;
+        maxRange = ComputeMaxRange(monitors);
+        ledges.clear();
+        windowFirst.assign(windows.size(), 0);
+        windowCount.assign(windows.size(), 0);
+        for (int i = 0; i < (int)windows.size(); i++) {
+            windowFirst[i] = (int)ledges.size();
+            WindowLedges(walkable, i, ledges);
+            windowCount[i] = (int)ledges.size() - windowFirst[i];
+        }
+        AddFloors(walkable);
+
+        edges.assign(ledges.size(), std::vector<int>());
+        for (int a = 0; a < (int)ledges.size(); a++)
+            for (int b = 0; b < (int)ledges.size(); b++)
+                if (a != b && CanJump(ledges[a], ledges[b], monitors)) edges[a].push_back(b);
+        Finish();
+    }
+
+    // Patch the graph using the walkable map's diff against the previous snapshot
+    void Incremental(const std::vector<RectArea>& windows, const std::vector<RectArea>& monitors, const WalkableMap& walkable) {
+        // Carry over ledges of windows whose spans were carried over
+        std::vector<Ledge> newLedges;
+        std::vector<int> oldToNew(ledges.size(), -1);
+        std::vector<char> fresh;
+        std::vector<int> newFirst(windows.size(), 0), newCount(windows.size(), 0);
+        for (int i = 0; i < (int)windows.size(); i++) {
+            newFirst[i] = (int)newLedges.size();
+            if (walkable.Touched(i)) {
+                WindowLedges(walkable, i, newLedges);
+                fresh.resize(newLedges.size(), 1);
+            } else {
+                int j = walkable.PreviousIndex(i);
+                for (int k = 0; k < windowCount[j]; k++) {
+                    int oldId = windowFirst[j] + k;
+                    Ledge l = ledges[oldId];
+                    l.windowIndex = i;
+                    oldToNew[oldId] = (int)newLedges.size();
+                    newLedges.push_back(l);
+                    fresh.push_back(0);
+                    ledgesReused++;
+                }
+            }
+            newCount[i] = (int)newLedges.size() - newFirst[i];
+        }
+        // Monitors are unchanged here, so floors carry over too
+        int oldFloors = (int)ledges.size() - (int)monitors.size();
+        for (int m = 0; m < (int)monitors.size(); m++) {
+            oldToNew[oldFloors + m] = (int)newLedges.size();
+            newLedges.push_back(ledges[oldFloors + m]);
+            fresh.push_back(0);
+        }
+
+        // Edges between two carried-over ledges are still valid; anything touching
+        // a fresh ledge is recomputed
+        std::vector<std::vector<int>> newEdges(newLedges.size());
+        for (int oldId = 0; oldId < (int)ledges.size(); oldId++) {
+            int a = oldToNew[oldId];
+            if (a == -1) continue;
+            for (int oldB : edges[oldId]) {
+                int b = oldToNew[oldB];
+                if (b != -1) newEdges[a].push_back(b);
+            }
+        }
+        for (int a = 0; a < (int)newLedges.size(); a++) {
+            if (!fresh[a]) continue;
+            for (int b = 0; b < (int)newLedges.size(); b++) {
+                if (a == b) continue;
+                if (CanJump(newLedges[a], newLedges[b], monitors)) newEdges[a].push_back(b);
+                if (!fresh[b] && CanJump(newLedges[b], newLedges[a], monitors)) newEdges[b].push_back(a);
+            }
+        }
+
+        ledges.swap(newLedges);
+        edges.swap(newEdges);
+        windowFirst.swap(newFirst);
+        windowCount.swap(newCount);
+        incrementalUpdates++;
+        Finish();
+    }
+};
+
+// ==========================================
+//              LEDGE PLANNER
+// ==========================================
+// Fewest-jumps routing. One BFS from the destination over reversed edges gives
+// the next hop for every ledge at once, cached until the graph or goal changes.
+
+class LedgePlanner {
+public:
+    unsigned long long plans = 0;
+    unsigned long long cacheHits = 0;
+
+    // Next ledge on the way from 'from' to 'to', or -1 if unreachable / already there
+    int NextHop(const LedgeGraph& graph, int from, int to) {
+        if (from < 0 || to < 0 || from == to) return -1;
+        if (graph.version != version || to != goal) Plan(graph, to);
+        else cacheHits++;
+        if (from >= (int)nextHop.size()) return -1;
+        return nextHop[from];
+    }
+
+private:
+    unsigned long long version = ~0ull;
+    int goal = -1;
+    std::vector<int> nextHop;
+    std::vector<std::vector<int>> reverse;
+    std::vector<int> queue;
+
+    void Plan(const LedgeGraph& graph, int to) {
+        plans++;
+        version = graph.version;
+        goal = to;
+        int n = (int)graph.ledges.size();
+
+        reverse.assign(n, std::vector<int>());
+        for (int a = 0; a < n; a++)
+            for (int b : graph.edges[a]) reverse[b].push_back(a);
+
+        nextHop.assign(n, -1);
+        if (to >= n) return;
+        std::vector<char> seen(n, 0);
+        queue.clear();
+        queue.push_back(to);
+        seen[to] = 1;
+        for (size_t q = 0; q < queue.size(); q++) {
+            int b = queue[q];
+            for (int a : reverse[b]) {
+                if (seen[a]) continue;
+                seen[a] = 1;
+                nextHop[a] = b;   // From a, jump to b and continue from there
+                queue.push_back(a);
+            }
+        }
+    }
+};
@@ -8,6 +8,18 @@
 #include <cmath>
 #include <iostream>
 #include <sstream>
+#include "Config.h"
+#include "Simulation.h"
+#include "Render.h"
+#include "FrameHandoff.h"
+#include "Scheduler.h"
+#include "SpritePack.h"
+#include "SpriteStore.h"
+#include "Profiler.h"
+#include "DesktopTrace.h"
+#include "PixelKernels.h"
+#include "Compositor.h"
+#include "Swarm.h"
 
 #pragma comment (lib,"Gdiplus.lib")
 #pragma comment (lib, "User32.lib")
@@ -16,111 +28,122 @@
 using namespace Gdiplus;
 
 // ==========================================
-//           USER CONFIGURATION
+//              WIN32 FRONTEND
 // ==========================================
-namespace Config {
-    // --- PHYSICS ---
-    const int TICK_RATE       = 33;    
-    const int GRAVITY         = 3;     
-    const int WALK_SPEED      = 4;     
-    const int LEAP_SPEED      = 25;    
-
-    // --- AI LOGIC (Cumulative Thresholds out of 10,000) ---
-    const int THRESH_IDLE_TO_WALK  = 150; 
-    const int THRESH_IDLE_TO_SIT   = 300;  
-    const int THRESH_IDLE_TO_SLEEP = 350;  
-
-    const int CHANCE_STOP_WALKING  = 100;  
-    const int CHANCE_STAND_UP      = 50;   
-    const int CHANCE_WAKE_UP       = 5;    
-
-    // Jump Logic
-    const int CHANCE_CHECK_JUMP    = 500;  
-    const int JUMP_UP_BIAS         = 70;   
-    const float JUMP_RANGE_PCT     = 0.20f; 
-
-    // --- TIMING ---
-    const int MIN_STATE_TIME     = 2000; 
-
-    // --- ANIMATION SPEEDS ---
-    const int SPEED_WALK      = 150;
-    const int SPEED_IDLE      = 800;
-    const int SPEED_SIT       = 1000;
-    const int SPEED_SLEEP     = 2000;
-    const int SPEED_MOVIE     = 1500;
-    const int SPEED_JUMP_PREP = 500;
-    const int SPEED_AIR       = 50;
-
-    // --- VISUALS ---
-    const int BREATH_DEPTH    = 3;     
-    const int BREATH_SPEED    = 400;   
-}
+// Game logic lives in Simulation.h; this file only feeds it the real desktop
+// and draws the result. The UI thread runs the message loop, window hooks and
+// the simulation; a render thread owns the sprites, frame cache and the
+// compositor, and is fed through FrameHandoff triple buffers. Everything is
+// drawn into one layered overlay window per monitor; the window that owns the
+// timer is never shown.
+
+// A sprite scaled to its draw size, premultiplied, ready to blend
+struct CachedFrame {
+    std::vector<uint32_t> pixels;
+};
 
-// ==========================================
-//              CORE ENGINE
-// ==========================================
+// A monitor's overlay: the compositor draws straight into its DIB section
+struct OverlaySurface {
+    HWND hwnd = NULL;
+    HBITMAP bitmap = NULL;
+    HBITMAP oldBitmap = NULL;
+    HDC dc = NULL;
+    void* bits = nullptr;
+    bool shown = false;
+};
 
-enum State {
-    IDLE, WALKING, SITTING, SLEEPING, FALLING, PREPARE_JUMP, LEAPING, WATCHING_MOVIE
+// --- PLATFORM SERVICES ---
+// A tick reads the time once: while latched, every Now() in it (physics, AI,
+// animation, swarm) sees the value the trace records for that tick
+class Win32Clock : public Clock {
+public:
+    unsigned long long Now() override { return latched ? latchedTime : GetTickCount64(); }
+    unsigned long long Latch() {
+        latchedTime = GetTickCount64();
+        latched = true;
+        return latchedTime;
+    }
+    void Release() { latched = false; }
+
+private:
+    unsigned long long latchedTime = 0;
+    bool latched = false;
 };
 
-struct AnimSequence {
-    std::vector<Image*> frames;
-    int msPerFrame;
+// Sets come from assets/sprites.pack when it exists (memory-mapped, no decode),
+// otherwise from loose assets/<name>_<i>.png files up to the first missing index
+class Win32SpriteSource : public SpriteSource {
+public:
+    bool Load(const std::string& name, SpriteArena& arena, std::vector<SpriteFrame>& frames) override;
 };
 
-// --- GLOBALS ---
-std::map<State, AnimSequence> animations;
-State currentState = FALLING;
+class Win32Environment : public EnvironmentProvider {
+public:
+    std::vector<RectArea> monitors;         // Last enumerated, for the fullscreen test
+    std::vector<RectArea>* windowsOut = nullptr;
+    std::vector<WindowId> windowIds;        // HWNDs of the last enumeration, same order
 
-int currentFrameIndex = 0;
-unsigned long lastFrameTime = 0;
-unsigned long lastStateChangeTime = 0;
-int debugLogCounter = 0;
+    void GetMonitors(std::vector<RectArea>& out) override;
+    void GetWindows(std::vector<RectArea>& out) override;
+    void GetWindowIds(std::vector<WindowId>& out) override { out = windowIds; }
+    std::wstring GetForegroundTitle() override;
+};
 
-int posX = 0, posY = 0; 
-int velX = 0, velY = 0;
-bool facingRight = true;
-int targetX = 0, targetY = 0;
+// --- GLOBALS ---
+// Render thread only (after startup)
+SpriteStore sprites;
+Win32SpriteSource spriteSource;
+int stateSet[STATE_COUNT];          // Sprite set per state, -1 if it has no art
+SpritePack spritePack;
+bool spritesFromPack = false;       // Set before the render thread starts
+FrameCache<CachedFrame> frameCache;
+Compositor compositor;
+std::vector<OverlaySurface> overlays;   // One per compositor surface
+std::vector<int> scaleXMap;         // Scratch for PixelKernels::ScaleNearest
+
+// Shared between the two threads
+TripleBuffer<FrameDesc> frameHandoff;
+TripleBuffer<SwarmDesc> swarmHandoff;   // Only published with --swarm
+HANDLE hFrameEvent = NULL;          // Auto-reset, set after every publish
+HANDLE hRenderThread = NULL;
+volatile LONG renderQuit = 0;
+CRITICAL_SECTION overlayLock;       // Guards the two below
+std::vector<HWND> overlayWindows;   // Created by the UI thread, only ever grows
+std::vector<RectArea> overlayMonitors;
+
+// UI thread only
+TickScheduler scheduler;
+unsigned long long frameSeq = 0;
+unsigned long long displayEpoch = 0;
+Profiler* profiler = nullptr;
+bool writeTrace = false;
+int timerDelay = Config::TICK_RATE;
+LARGE_INTEGER perfFreq;
+int debugLogCounter = 0;
+Swarm* swarm = nullptr;             // --swarm=<N> extra walkers
+SwarmDesc swarmDesc;                // Reused for every publish
 
-struct RectArea { long left, top, right, bottom; };
-std::vector<RectArea> monitors;
-std::vector<RECT> windowRects; 
+Win32Clock win32Clock;
+Win32Environment win32Env;
+TraceRecorder traceRecorder(win32Env);      // Pass-through unless started with --record
+Simulation sim(win32Clock, traceRecorder);
 
 ULONG_PTR gdiplusToken;
-HWND hBuddyWindow;
+HINSTANCE hAppInstance;
+HWND hBuddyWindow;                  // Hidden: owns the timer and display notifications
+HWINEVENTHOOK hSystemHook = NULL;
+HWINEVENTHOOK hObjectHook = NULL;
 
 // --- UTILS ---
-void LogDebug(std::wstring msg) {
+void LogDebug(const std::wstring& msg) {
     OutputDebugStringW(msg.c_str());
 }
 
-std::wstring GetStateName(State s) {
-    switch(s) {
-        case IDLE: return L"IDLE";
-        case WALKING: return L"WALKING";
-        case SITTING: return L"SITTING";
-        case SLEEPING: return L"SLEEPING";
-        case FALLING: return L"FALLING";
-        case PREPARE_JUMP: return L"PREPARE_JUMP";
-        case LEAPING: return L"LEAPING";
-        case WATCHING_MOVIE: return L"WATCHING_MOVIE";
-        default: return L"UNKNOWN";
-    }
-}
-
-// --- STATE MANAGER ---
-void ChangeState(State newState, std::wstring reason) {
-    if (currentState == newState) return; 
-
-    std::wstringstream ss;
-    ss << L"[STATE] " << GetStateName(currentState) << L" -> " << GetStateName(newState) << L" (" << reason << L")\n";
-    LogDebug(ss.str());
-
-    currentState = newState;
-    lastStateChangeTime = GetTickCount64();
-    currentFrameIndex = 0; 
-    lastFrameTime = GetTickCount64(); 
+// Our overlays cover whole monitors; they must not become platforms
+bool IsOwnWindow(HWND hwnd) {
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hwnd, &pid);
+    return pid == GetCurrentProcessId();
 }
 
 // --- ENVIRONMENT ---
@@ -132,437 +155,651 @@ BOOL CALLBACK MonitorEnumProc(HMONITOR hMon, HDC hdc, LPRECT lprc, LPARAM dwData
         ra.right = mi.rcWork.right;
         ra.top = mi.rcWork.top;
         ra.bottom = mi.rcWork.bottom;
-        monitors.push_back(ra);
+        reinterpret_cast<std::vector<RectArea>*>(dwData)->push_back(ra);
     }
     return TRUE;
 }
 
-void UpdateEnvironment() {
-    monitors.clear();
-    EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, 0);
-}
-
 BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam) {
+    Win32Environment* env = reinterpret_cast<Win32Environment*>(lParam);
     if (!IsWindowVisible(hwnd)) return TRUE;
     if (IsIconic(hwnd)) return TRUE;
-    if (hwnd == hBuddyWindow) return TRUE;
+    if (IsOwnWindow(hwnd)) return TRUE;
     RECT r;
     GetWindowRect(hwnd, &r);
     if ((r.right - r.left) < 200 || (r.bottom - r.top) < 100) return TRUE;
     if (r.bottom < -30000 || r.right < -30000) return TRUE;
 
     bool isFullScreen = false;
-    for(const auto& mon : monitors) {
+    for(const auto& mon : env->monitors) {
         if (abs(r.left - mon.left) < 2 && abs(r.right - mon.right) < 2 && 
             abs(r.top - mon.top) < 2 && abs(r.bottom - mon.bottom) < 2) {
             isFullScreen = true;
             break;
         }
     }
-    std::vector<RECT>* list = reinterpret_cast<std::vector<RECT>*>(lParam);
-    list->push_back(r);
+    env->windowsOut->push_back({ r.left, r.top, r.right, r.bottom });
+    env->windowIds.push_back((WindowId)(uintptr_t)hwnd);
     return TRUE;
 }
 
-bool IsInAnyMonitor(int x, int y) {
-    for (const auto& mon : monitors) {
-        if (x >= mon.left && x <= mon.right && y >= mon.top && y <= mon.bottom) return true;
-    }
-    return false;
+void Win32Environment::GetMonitors(std::vector<RectArea>& out) {
+    out.clear();
+    EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, reinterpret_cast<LPARAM>(&out));
+    monitors = out;
+}
+
+void Win32Environment::GetWindows(std::vector<RectArea>& out) {
+    out.clear();
+    windowIds.clear();
+    windowsOut = &out;
+    EnumWindows(EnumWindowsProc, reinterpret_cast<LPARAM>(this));
+    windowsOut = nullptr;
+}
+
+std::wstring Win32Environment::GetForegroundTitle() {
+    HWND hFg = GetForegroundWindow();
+    wchar_t title[256];
+    GetWindowText(hFg, title, 256);
+    return title;
 }
 
-// Z-ORDER CHECK:
-// Window list is sorted Top-to-Bottom (0 is top).
-// We check if any window with index < 'ignoreBelowIndex' covers the point.
-bool IsPointObscured(int x, int y, int ignoreBelowIndex) {
-    int limit = (ignoreBelowIndex == -1) ? windowRects.size() : ignoreBelowIndex;
-    for (int i = 0; i < limit; i++) {
-        RECT& r = windowRects[i];
-        if (x >= r.left && x <= r.right && y >= r.top && y <= r.bottom) {
-            return true; 
+// Re-arm the tick timer only when the delay actually changes
+void SetTickDelay(HWND hwnd, int delay) {
+    if (delay == timerDelay) return;
+    timerDelay = delay;
+    SetTimer(hwnd, 1, delay, NULL);
+}
+
+// The layout or the foreground title changed: if we were dozing, come back
+// to full rate right away
+void WakeForChange() {
+    scheduler.OnEnvironmentChanged(GetTickCount64());
+    if (timerDelay != Config::TICK_RATE) SetTickDelay(hBuddyWindow, Config::TICK_RATE);
+}
+
+// Window topology events -> snapshot cache. Out-of-context hooks are delivered
+// on this thread through the message loop, so no locking is needed.
+void CALLBACK WinEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD thread, DWORD time) {
+    if (hwnd == NULL) return;
+    if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF) return;
+    // Only top-level windows matter (destroyed windows can't be asked anymore)
+    if (event != EVENT_OBJECT_DESTROY && GetAncestor(hwnd, GA_ROOT) != hwnd) return;
+
+    // Title edits only matter for the foreground window and don't move anything
+    if (event == EVENT_OBJECT_NAMECHANGE) {
+        if (hwnd == GetForegroundWindow()) {
+            traceRecorder.TitleEvent();
+            sim.OnTitleChanged();
+            WakeForChange();
         }
+        return;
+    }
+    if (event == EVENT_SYSTEM_FOREGROUND) {
+        traceRecorder.TitleEvent();
+        sim.OnTitleChanged();
+    }
+
+    WindowEventType type = WINDOW_MOVED;
+    bool topology = true;
+    switch (event) {
+        case EVENT_OBJECT_CREATE: type = WINDOW_CREATED; break;
+        case EVENT_OBJECT_DESTROY: type = WINDOW_DESTROYED; break;
+        case EVENT_OBJECT_SHOW: type = WINDOW_SHOWN; break;
+        case EVENT_OBJECT_HIDE: type = WINDOW_HIDDEN; break;
+        case EVENT_OBJECT_LOCATIONCHANGE:
+        case EVENT_SYSTEM_MOVESIZEEND: type = WINDOW_MOVED; break;      // The end of a drag says it stopped
+        case EVENT_OBJECT_REORDER:
+        case EVENT_SYSTEM_FOREGROUND: type = WINDOW_ZORDER; break;
+        case EVENT_SYSTEM_MINIMIZESTART: type = WINDOW_MINIMIZED; break;
+        case EVENT_SYSTEM_MINIMIZEEND: type = WINDOW_RESTORED; break;
+        default: topology = false; break;
     }
-    return false;
+    // Focus, state and value changes leave the layout alone: they must not
+    // keep renewing the wake grace period
+    if (!topology) return;
+    traceRecorder.WindowEvent(type);
+    sim.windowCache.OnWindowEvent(type);
+    WakeForChange();
 }
 
-void GetSmartSize(int origW, int origH, int& outW, int& outH) {
-    int screenH = 1080;
-    if (!monitors.empty()) screenH = monitors[0].bottom - monitors[0].top;
-    int targetH = screenH / 8; 
-    if (origH > targetH) {
-        float ratio = (float)targetH / (float)origH;
-        outH = targetH;
-        outW = (int)(origW * ratio);
-    } else {
-        int scale = targetH / origH;
-        if (scale < 1) scale = 1;
-        if (scale > 6) scale = 6;
-        outW = origW * scale;
-        outH = origH * scale;
-    }
-}
-
-// --- PHYSICS ---
-void UpdatePhysics() {
-    if (GetAsyncKeyState(VK_ESCAPE)) { PostQuitMessage(0); return; }
-
-    windowRects.clear();
-    EnumWindows(EnumWindowsProc, reinterpret_cast<LPARAM>(&windowRects));
-
-    if (currentState == FALLING) {
-        posY += velY;
-        velY += Config::GRAVITY;
-        if (velY > 25) velY = 25;
-
-        if (velY > 0) {
-            // Check Windows
-            for (int i = 0; i < windowRects.size(); i++) {
-                RECT& r = windowRects[i];
-                if (posX >= r.left + 10 && posX <= r.right - 10) {
-                    if (posY >= r.top && posY <= (r.top + velY + 15)) {
-                        // Landing check: Am I obscured by something ABOVE this window?
-                        if (!IsPointObscured(posX, r.top, i)) {
-                            posY = r.top;
-                            velY = 0;
-                            ChangeState(IDLE, L"Landed Window");
-                            return;
-                        }
-                    }
-                }
-            }
-            // Check Floor
-            for (const auto& mon : monitors) {
-                if (posX >= mon.left && posX <= mon.right) {
-                    if (posY >= mon.bottom) {
-                        posY = mon.bottom;
-                        velY = 0;
-                        ChangeState(IDLE, L"Landed Floor");
-                        return;
-                    }
-                }
-            }
-        }
+void InstallWindowHooks() {
+    DWORD flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+    hSystemHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_MINIMIZEEND, NULL, WinEventProc, 0, 0, flags);
+    hObjectHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_NAMECHANGE, NULL, WinEventProc, 0, 0, flags);
+    // Without hooks we can't trust the cache; fall back to enumerating every tick
+    if (!hSystemHook || !hObjectHook) {
+        traceRecorder.AlwaysRefresh();
+        sim.windowCache.SetAlwaysRefresh(true);
     }
-    else if (currentState == LEAPING) {
-        int dx = targetX - posX;
-        int dy = targetY - posY;
-        float dist = sqrt(dx*dx + dy*dy);
-
-        if (dist < Config::LEAP_SPEED) {
-            posX = targetX;
-            posY = targetY;
-            ChangeState(IDLE, L"Jump Arrived");
-        } else {
-            float ratio = Config::LEAP_SPEED / dist;
-            posX += (int)(dx * ratio);
-            posY += (int)(dy * ratio);
-        }
+}
+
+void RemoveWindowHooks() {
+    if (hSystemHook) UnhookWinEvent(hSystemHook);
+    if (hObjectHook) UnhookWinEvent(hObjectHook);
+    hSystemHook = hObjectHook = NULL;
+}
+
+// Optional user rules: assets/title_rules.txt, UTF-8, "pattern = STATE" per line
+void LoadTitleRules() {
+    HANDLE hFile = CreateFileW(L"assets/title_rules.txt", GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+    DWORD size = GetFileSize(hFile, NULL);
+    std::string bytes(size, '\0');
+    DWORD read = 0;
+    ReadFile(hFile, &bytes[0], size, &read, NULL);
+    CloseHandle(hFile);
+
+    int len = MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)read, NULL, 0);
+    std::wstring text(len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)read, &text[0], len);
+
+    std::vector<TitleRule> rules = ParseTitleRules(text);
+    if (!rules.empty()) {
+        traceRecorder.TitleRules(rules);
+        sim.SetTitleRules(rules);
+        LogDebug(L"[TITLE] Loaded " + std::to_wstring(rules.size()) + L" rules\n");
     }
-    else if (currentState != PREPARE_JUMP) {
-        // --- ON GROUND LOGIC ---
-        bool supported = false;
-        bool onFloor = false;
-        int myWindowIndex = -1; 
-
-        // 1. ELEVATOR CHECK (Windows moving UP into feet)
-        // Check this BEFORE current support, so rising windows override falling/current pos.
-        for (int i = 0; i < windowRects.size(); i++) {
-            RECT& r = windowRects[i];
-            if (posX >= r.left && posX <= r.right) {
-                // If window top is near feet, OR slightly above (meaning it moved up past us)
-                // We check a range: Feet-5 (it rose) to Feet+15 (we fell/it fell)
-                if (posY >= r.top - 5 && posY <= r.top + 15) {
-                    // Critical: Is this new elevator obscured by something ABOVE it?
-                    if (!IsPointObscured(posX, r.top, i)) {
-                        posY = r.top; // SNAP
-                        supported = true;
-                        myWindowIndex = i;
-                        break; // Found highest support
-                    }
-                }
-            }
-        }
+}
 
-        // 2. Floor Check (If no window caught us)
-        if (!supported) {
-            for (const auto& mon : monitors) {
-                if (posX >= mon.left && posX <= mon.right && abs(posY - mon.bottom) < 10) {
-                    supported = true;
-                    onFloor = true;
-                    posY = mon.bottom;
-                    break;
-                }
-            }
-        }
+// --- RENDER ---
+// Scale one sprite of 'set' to its draw size. Only runs on a cache miss; every
+// later frame with the same key blends the cached pixels until the set is evicted.
+CachedFrame* BuildFrame(const FrameKey& key, int set, const SpriteFrame* sprite) {
+    size_t bytes = (size_t)key.width * key.height * 4;
+    CachedFrame* cf = frameCache.Insert(key, CachedFrame(), bytes);
+    cf->pixels.resize((size_t)key.width * key.height);
+    uint32_t* dst = cf->pixels.data();
+    if (sprite) {
+        PixelKernels::ScaleNearest(sprite->pixels, sprite->width, sprite->height, sprite->width,
+                                   dst, key.width, key.height, key.width, !key.facingRight, scaleXMap);
+    } else {
+        PixelKernels::Fill(dst, key.width, key.height, key.width, 0xC8C800C8);   // Magenta at alpha 200, premultiplied
+    }
+    if (sprite) sprites.Charge(set, bytes);   // May evict other sets, never this one
+    return cf;
+}
 
-        // 3. Occlusion Logic
-        if (supported) {
-            // Check head level (posY - 20)
-            // We ignore windows BELOW our current support (myWindowIndex)
-            // This allows us to stand on a window that is in front of another window without panicking.
-            if (IsPointObscured(posX, posY - 20, myWindowIndex)) {
-                
-                // If we are sleeping, we wake up.
-                if (currentState == SLEEPING || currentState == WATCHING_MOVIE) {
-                    ChangeState(IDLE, L"Woke by Occlusion");
-                    if (rand() % 2 == 0) posX += 10; else posX -= 10;
-                }
-                // If we are just standing/walking, we get pushed off.
-                // UNLESS we are on the floor (Taskbar). You can't fall off the floor.
-                else if (!onFloor) {
-                    supported = false; // Push off ledge
-                }
-            }
-        }
+void ReleaseFrame(CachedFrame&) {}     // Pixels go with the cache entry
 
-        if (!supported) {
-            ChangeState(FALLING, L"No Support");
-        } 
-        else if (currentState == WALKING) {
-            int speed = Config::WALK_SPEED;
-            int nextX = facingRight ? (posX + speed) : (posX - speed);
-            
-            // Just walk. Only stop for monitor edges.
-            if (IsInAnyMonitor(nextX, posY - 10)) {
-                posX = nextX;
-            } else {
-                ChangeState(IDLE, L"Screen Edge");
-            }
-        }
+// A set was evicted: its scaled frames were charged to it, so they go too.
+// Fallback keys use IDLE's state, so they match IDLE's set.
+class ScaledFrameEvictions : public SpriteEvictListener {
+public:
+    void Evicted(int set) override {
+        frameCache.Drop([set](const FrameKey& k) { return k.state >= 0 && stateSet[k.state] == set; }, ReleaseFrame);
     }
+};
+ScaledFrameEvictions scaledFrameEvictions;
+
+// Same key -> same pixels, so the key is the compositor's content id
+unsigned long long ContentId(const FrameKey& key) {
+    return ((unsigned long long)(key.state + 1) << 48) ^ ((unsigned long long)key.frame << 32) ^
+           ((unsigned long long)key.facingRight << 31) ^ ((unsigned long long)key.width << 16) ^ (unsigned long long)key.height;
 }
 
-// --- AI ---
-void UpdateAI() {
-    if (currentState == FALLING || currentState == LEAPING) return;
+int BreathingOffset(int state, unsigned long long now) {
+    if (state != SLEEPING && state != WATCHING_MOVIE) return 0;
+    double timeVal = (double)now / (double)Config::BREATH_SPEED;
+    return (int)(sin(timeVal) * Config::BREATH_DEPTH + Config::BREATH_DEPTH);
+}
 
-    if (currentState == PREPARE_JUMP) {
-        if (rand() % 15 == 0) {
-            facingRight = (targetX > posX);
-            ChangeState(LEAPING, L"Launch");
-        }
-        return;
+// Queue one character for this frame. Frame stepping happens in the
+// simulation; we only pick the frame up. Only the size is needed to find the
+// cache entry; pixels are fetched (and decoded if evicted) on a miss.
+// Returns false if it had to fall back to the idle art.
+bool AddSprite(int id, int state, int frame, bool facingRight, int posX, int posY, int screenH, unsigned long long now) {
+    bool usingFallback = false;
+    int set = stateSet[state];
+    int frameIndex = frame;
+    const SpriteFrame* img = sprites.Frame(set, frameIndex, false);
+    if (img == nullptr) {
+        usingFallback = true;
+        set = stateSet[IDLE];
+        frameIndex = 0;
+        img = sprites.Frame(set, frameIndex, false);
     }
 
-    unsigned long now = GetTickCount64();
-    if (now - lastStateChangeTime < Config::MIN_STATE_TIME) return;
+    int imgW = 32, imgH = 32;
+    if (img) { imgW = img->width; imgH = img->height; }
 
-    int r = rand() % 10000; 
+    int drawW, drawH;
+    Simulation::SmartSize(screenH, imgW, imgH, drawW, drawH);
+
+    FrameKey key = { img ? (usingFallback ? (int)IDLE : state) : -1,
+                     usingFallback ? 0 : frame,
+                     facingRight, drawW, drawH };
+    CachedFrame* cf = frameCache.Find(key);
+    if (!cf) cf = BuildFrame(key, set, img ? sprites.Frame(set, frameIndex, true) : nullptr);
+
+    CompositeItem item = { id, cf->pixels.data(), drawW, drawH,
+                           posX - (drawW / 2), posY - drawH + BreathingOffset(state, now), ContentId(key) };
+    compositor.Add(item);
+    return !usingFallback;
+}
 
-    if (currentState == IDLE) {
-        if (r < Config::THRESH_IDLE_TO_WALK) { 
-            facingRight = (rand() % 2 == 0); 
-            ChangeState(WALKING, L"AI Walk");
+// Upload what changed on each monitor. The dirty rect keeps the copy to the
+// part of the overlay the compositor touched.
+void PresentOverlays(HDC hdcScreen) {
+    BLENDFUNCTION blend = { 0 };
+    blend.BlendOp = AC_SRC_OVER;
+    blend.SourceConstantAlpha = 255;
+    blend.AlphaFormat = AC_SRC_ALPHA;
+    for (int i = 0; i < compositor.SurfaceCount(); i++) {
+        OverlaySurface& o = overlays[i];
+        if (!compositor.SurfaceDirty(i) || !o.dc) continue;
+        const Compositor::Surface& s = compositor.GetSurface(i);
+        POINT ptDst = { s.bounds.left, s.bounds.top };
+        SIZE size = { s.width, s.height };
+        POINT ptSrc = { 0, 0 };
+        RECT dirty = { s.dirtyBounds.left - ptDst.x, s.dirtyBounds.top - ptDst.y,
+                       s.dirtyBounds.right - ptDst.x, s.dirtyBounds.bottom - ptDst.y };
+        UPDATELAYEREDWINDOWINFO info = { sizeof(UPDATELAYEREDWINDOWINFO) };
+        info.hdcDst = hdcScreen;
+        info.pptDst = &ptDst;
+        info.psize = &size;
+        info.hdcSrc = o.dc;
+        info.pptSrc = &ptSrc;
+        info.pblend = &blend;
+        info.dwFlags = ULW_ALPHA;
+        info.prcDirty = &dirty;
+        UpdateLayeredWindowIndirect(o.hwnd, &info);
+        if (!o.shown) {
+            ShowWindowAsync(o.hwnd, SW_SHOWNOACTIVATE);
+            o.shown = true;
         }
-        else if (r < Config::THRESH_IDLE_TO_SIT) ChangeState(SITTING, L"AI Sit");
-        else if (r < Config::THRESH_IDLE_TO_SLEEP) ChangeState(SLEEPING, L"AI Sleep");
-        
-        // JUMP SEARCH
-        if (rand() % 10000 < Config::CHANCE_CHECK_JUMP) { 
-            int minDim = 10000;
-            for(const auto& mon : monitors) {
-                int w = mon.right - mon.left;
-                int h = mon.bottom - mon.top;
-                if (w < minDim) minDim = w;
-                if (h < minDim) minDim = h;
-            }
-            int maxRange = (int)(minDim * Config::JUMP_RANGE_PCT);
-
-            std::vector<POINT> targetsUp;
-            std::vector<POINT> targetsDown;
-
-            for (const auto& w : windowRects) {
-                int wx = (w.left + w.right) / 2;
-                int wy = w.top;
-                double dist = sqrt(pow(wx - posX, 2) + pow(wy - posY, 2));
-                
-                if (dist > maxRange) continue;
-                if (abs(wy - posY) < 30) continue; 
-                // Don't jump to obscured ledges
-                if (IsPointObscured(wx, wy, -1)) continue; 
-                bool nearCeiling = false;
-                for(const auto& mon : monitors) if (wy < mon.top + 50) nearCeiling = true;
-                if (nearCeiling) continue;
-
-                if (wy < posY) targetsUp.push_back({wx, wy});
-                else targetsDown.push_back({wx, wy});
-            }
+    }
+}
 
-            std::vector<POINT>* chosenList = nullptr;
-            bool preferUp = (rand() % 100 < Config::JUMP_UP_BIAS);
-            if (preferUp && !targetsUp.empty()) chosenList = &targetsUp;
-            else if (!targetsDown.empty()) chosenList = &targetsDown;
-            else if (!targetsUp.empty()) chosenList = &targetsUp; 
-
-            if (chosenList && !chosenList->empty()) {
-                int idx = rand() % chosenList->size();
-                targetX = (*chosenList)[idx].x;
-                targetY = (*chosenList)[idx].y;
-                ChangeState(PREPARE_JUMP, L"Ledge Found");
-            }
+void DrawScene(HDC hdcScreen, const FrameDesc& desc, const SwarmDesc& walkers) {
+    LARGE_INTEGER tStart;
+    QueryPerformanceCounter(&tStart);
+
+    debugLogCounter++;
+    bool doLog = (debugLogCounter % 60 == 0);
+    unsigned long long now = GetTickCount64();
+
+    bool usingFallback;
+    {
+        ProfileScope scope(profiler, STAGE_COMPOSE);
+        sprites.BeginFrame();   // Nothing drawn this frame is evicted before End()
+        compositor.Begin();
+        // Walkers first: the buddy stays on top
+        for (size_t i = 0; i < walkers.walkers.size(); i++) {
+            const WalkerDesc& w = walkers.walkers[i];
+            AddSprite(1 + (int)i, w.state, w.frame, w.facingRight, w.posX, w.posY, desc.screenH, now);
         }
+        usingFallback = !AddSprite(0, desc.state, desc.frame, desc.facingRight, desc.posX, desc.posY, desc.screenH, now);
+        GdiFlush();     // GDI must be done with the DIBs before we write to them
+        compositor.End();
+        sprites.EndFrame();
     }
-    else if (currentState == WALKING) { 
-        if (r < Config::CHANCE_STOP_WALKING) ChangeState(IDLE, L"Stop Walk");
-    }
-    else if (currentState == SITTING) {
-        if (r < Config::CHANCE_STAND_UP) ChangeState(IDLE, L"Stand Up");
-    }
-    else if (currentState == SLEEPING) {
-        if (r < Config::CHANCE_WAKE_UP) ChangeState(IDLE, L"Wake Up");
+    {
+        ProfileScope scope(profiler, STAGE_PRESENT);
+        PresentOverlays(hdcScreen);
     }
 
-    HWND hFg = GetForegroundWindow();
-    wchar_t title[256];
-    GetWindowText(hFg, title, 256);
-    std::wstring wTitle = title;
-    std::transform(wTitle.begin(), wTitle.end(), wTitle.begin(), ::tolower);
-    bool watching = (wTitle.find(L"youtube") != std::wstring::npos || wTitle.find(L"netflix") != std::wstring::npos);
-    
-    if (watching && currentState != WATCHING_MOVIE && currentState != FALLING && currentState != LEAPING && currentState != PREPARE_JUMP) {
-        ChangeState(WATCHING_MOVIE, L"Detect Movie");
-    }
-    if (!watching && currentState == WATCHING_MOVIE) {
-        ChangeState(IDLE, L"Movie End");
+    if (doLog) {
+        const CompositorStats& cs = compositor.stats;
+        std::wstringstream ss;
+        ss << L"[RENDER] Frame " << desc.seq
+           << L" | Fallback: " << (usingFallback ? L"YES" : L"NO")
+           << L" | Handoff: " << frameHandoff.consumed.load() << L" taken, "
+           << frameHandoff.dropped.load() << L" dropped"
+           << L" | Render: " << frameCache.stats.frames << L" frames, "
+           << frameCache.stats.allocations << L" allocs, "
+           << frameCache.stats.cachedBytes / 1024 << L" KB cached, avg "
+           << frameCache.stats.AvgMicros() << L" us, max " << frameCache.stats.maxMicros << L" us"
+           << L" | Sprites: " << sprites.stats.residentSets << L"/" << sprites.SetCount() << L" sets, "
+           << sprites.stats.residentBytes / 1024 << L" KB (" << sprites.stats.scaledBytes / 1024
+           << L" scaled, peak " << sprites.stats.peakBytes / 1024 << L", budget "
+           << sprites.Budget() / 1024 << L"), " << sprites.stats.decodes << L" decodes, "
+           << sprites.stats.evictions << L" evicted, " << frameCache.stats.dropped << L" scaled frames dropped"
+           << L" | Decode: " << sprites.stats.firstDecodes << L" sets from "
+           << (spritesFromPack ? L"sprites.pack" : L"loose PNGs") << L" in " << sprites.stats.firstDecodeMs
+           << L" ms on first use, " << sprites.stats.reloadMs << L" ms reloading"
+           << L" | Compose: " << walkers.walkers.size() + 1 << L" sprites on " << compositor.SurfaceCount()
+           << L" surfaces, " << cs.idleFrames << L"/" << cs.frames << L" idle, "
+           << (cs.frames ? cs.dirtyPixels / cs.frames : 0) << L" dirty px/frame, "
+           << cs.fullRepaints << L" full repaints\n";
+        LogDebug(ss.str());
     }
-}
 
-// --- RENDER ---
-void DrawBuddy(HDC hdcScreen) {
-    debugLogCounter++;
-    bool doLog = (debugLogCounter % 60 == 0);
+    LARGE_INTEGER tEnd;
+    QueryPerformanceCounter(&tEnd);
+    frameCache.stats.AddFrame((double)(tEnd.QuadPart - tStart.QuadPart) * 1000000.0 / (double)perfFreq.QuadPart);
+}
 
-    Image* img = nullptr;
-    bool usingFallback = false;
+void ReleaseOverlays() {
+    for (auto& o : overlays) {
+        if (!o.dc) continue;
+        SelectObject(o.dc, o.oldBitmap);
+        DeleteDC(o.dc);
+        DeleteObject(o.bitmap);
+    }
+    overlays.clear();
+}
 
-    if (animations.find(currentState) != animations.end() && !animations[currentState].frames.empty()) {
-        AnimSequence& anim = animations[currentState];
-        if (currentFrameIndex >= anim.frames.size()) currentFrameIndex = 0;
-        unsigned long now = GetTickCount64();
-        if (now - lastFrameTime > anim.msPerFrame) {
-            currentFrameIndex = (currentFrameIndex + 1) % anim.frames.size();
-            lastFrameTime = now;
-        }
-        img = anim.frames[currentFrameIndex];
+// Display setup changed: a fresh DIB per monitor at its size, attached to the
+// compositor and presented through the overlay the UI thread made for it
+void RebuildOverlays(HDC hdcScreen) {
+    std::vector<HWND> windows;
+    std::vector<RectArea> monitors;
+    EnterCriticalSection(&overlayLock);
+    windows = overlayWindows;
+    monitors = overlayMonitors;
+    LeaveCriticalSection(&overlayLock);
+
+    ReleaseOverlays();
+    compositor.SetMonitors(monitors);
+    overlays.resize(monitors.size());
+    for (size_t i = 0; i < monitors.size(); i++) {
+        OverlaySurface& o = overlays[i];
+        o.hwnd = windows[i];
+        int w = (int)(monitors[i].right - monitors[i].left);
+        int h = (int)(monitors[i].bottom - monitors[i].top);
+
+        BITMAPINFO bmi = { 0 };
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = w;
+        bmi.bmiHeader.biHeight = -h; // Top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        o.bitmap = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &o.bits, NULL, 0);
+        if (!o.bitmap) continue;    // Drawn into memory of its own, never shown
+        o.dc = CreateCompatibleDC(hdcScreen);
+        o.oldBitmap = (HBITMAP)SelectObject(o.dc, o.bitmap);
+        compositor.Attach((int)i, (uint32_t*)o.bits, w);
     }
-    if (img == nullptr) {
-        usingFallback = true;
-        if (animations.find(IDLE) != animations.end() && !animations[IDLE].frames.empty()) {
-            img = animations[IDLE].frames[0];
+    // Windows of monitors that went away stay around, hidden, for the next change
+    for (size_t i = monitors.size(); i < windows.size(); i++) ShowWindowAsync(windows[i], SW_HIDE);
+}
+
+// --- RENDER THREAD ---
+// Sleeps until the simulation publishes, then draws the newest descriptors.
+// Anything published while we were busy is skipped, not queued.
+DWORD WINAPI RenderThreadProc(LPVOID) {
+    unsigned long long epoch = ~0ULL;   // Forces the first rebuild
+    FrameDesc desc;
+    SwarmDesc walkers;
+    while (WaitForSingleObject(hFrameEvent, INFINITE) == WAIT_OBJECT_0 && !renderQuit) {
+        if (!frameHandoff.Acquire(desc)) continue;
+        swarmHandoff.Acquire(walkers);     // Keeps the last one if nothing new
+        profiler->Record(STAGE_HANDOFF, desc.publishNs, profiler->NowNs() - desc.publishNs);
+
+        HDC hdc = GetDC(NULL);
+        if (desc.displayEpoch != epoch) {
+            // Display setup changed: sizes and surfaces are stale
+            frameCache.Clear(ReleaseFrame);
+            sprites.ClearCharges();
+            RebuildOverlays(hdc);
+            epoch = desc.displayEpoch;
         }
+        DrawScene(hdc, desc, walkers);
+        ReleaseDC(NULL, hdc);
     }
+    ReleaseOverlays();
+    return 0;
+}
 
-    int imgW = 32, imgH = 32;
-    if (img) { imgW = img->GetWidth(); imgH = img->GetHeight(); }
-
-    int drawW, drawH;
-    GetSmartSize(imgW, imgH, drawW, drawH);
+void StartRenderThread() {
+    hFrameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    hRenderThread = CreateThread(NULL, 0, RenderThreadProc, NULL, 0, NULL);
+}
 
-    int breathingOffset = 0;
-    if (currentState == SLEEPING || currentState == WATCHING_MOVIE) {
-        double timeVal = (double)GetTickCount64() / (double)Config::BREATH_SPEED; 
-        breathingOffset = (int)(sin(timeVal) * Config::BREATH_DEPTH + Config::BREATH_DEPTH);
+void StopRenderThread() {
+    InterlockedExchange(&renderQuit, 1);
+    SetEvent(hFrameEvent);
+    // UpdateLayeredWindow may be waiting on this thread to handle a sent
+    // message, so keep letting those through until the render thread is gone
+    while (MsgWaitForMultipleObjects(1, &hRenderThread, FALSE, INFINITE, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1) {
+        MSG msg;
+        PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE);
     }
+    CloseHandle(hRenderThread);
+    CloseHandle(hFrameEvent);
+    hRenderThread = hFrameEvent = NULL;
+}
 
-    int drawX = posX - (drawW / 2);
-    int drawY = posY - drawH + breathingOffset; 
+// Snapshot what the renderer needs from this tick and wake it
+void PublishFrame() {
+    FrameDesc desc;
+    desc.seq = ++frameSeq;
+    desc.publishNs = profiler->NowNs();
+    desc.state = sim.currentState;
+    desc.frame = sim.currentFrameIndex;
+    desc.facingRight = sim.facingRight;
+    desc.posX = sim.posX;
+    desc.posY = sim.posY;
+    desc.screenH = sim.ScreenHeight();
+    desc.displayEpoch = displayEpoch;
+    if (swarm) {
+        swarmDesc.seq = desc.seq;
+        swarmDesc.walkers.resize(swarm->Count());
+        for (int i = 0; i < swarm->Count(); i++) {
+            swarmDesc.walkers[i] = { swarm->state[i], swarm->frame[i], swarm->facingRight[i] != 0,
+                                     swarm->posX[i], swarm->posY[i] };
+        }
+        swarmHandoff.Publish(swarmDesc);   // Before the buddy's, so the renderer never sees a frame without it
+    }
+    frameHandoff.Publish(desc);
+    SetEvent(hFrameEvent);
 
-    if (doLog) {
+    if (frameSeq % 60 == 0) {
         std::wstringstream ss;
-        ss << L"State: " << GetStateName(currentState)
-           << L" | Pos: " << posX << L"," << posY 
-           << L" | Tgt: " << targetX << L"," << targetY
-           << L" | Fallback: " << (usingFallback ? L"YES" : L"NO") << L"\n";
+        ss << L"State: " << GetStateName(sim.currentState)
+           << L" | Pos: " << sim.posX << L"," << sim.posY 
+           << L" | Tgt: " << sim.targetX << L"," << sim.targetY
+           << L" | Snapshot: gen " << sim.windowCache.generation
+           << L", enum " << sim.windowCache.enumerations
+           << L", avoided " << sim.windowCache.avoidedEnumerations << L"\n";
         LogDebug(ss.str());
     }
+}
 
-    HDC hdcMem = CreateCompatibleDC(hdcScreen);
-    HBITMAP hBitmap = CreateCompatibleBitmap(hdcScreen, drawW, drawH);
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMem, hBitmap);
+// Decode a PNG into straight BGRA and premultiply it once, here, instead of on every draw
+bool DecodeSprite(const std::wstring& path, SpriteArena& arena, SpriteFrame& out) {
+    Bitmap bmp(path.c_str());
+    if (bmp.GetLastStatus() != Ok) return false;
+    int w = (int)bmp.GetWidth(), h = (int)bmp.GetHeight();
+    Rect rect(0, 0, w, h);
+    BitmapData data;
+    if (bmp.LockBits(&rect, ImageLockModeRead, PixelFormat32bppARGB, &data) != Ok) return false;
+    uint32_t* pixels = arena.Allocate((size_t)w * h);
+    for (int y = 0; y < h; y++) {
+        const uint32_t* row = (const uint32_t*)((const BYTE*)data.Scan0 + (ptrdiff_t)y * data.Stride);
+        PixelKernels::Premultiply(row, pixels + (size_t)y * w, w);
+    }
+    bmp.UnlockBits(&data);
+    out.pixels = pixels;
+    out.width = w;
+    out.height = h;
+    return true;
+}
 
-    {
-        Bitmap bmp(drawW, drawH, PixelFormat32bppARGB);
-        Graphics g(&bmp);
-        g.SetInterpolationMode(InterpolationModeNearestNeighbor); 
-
-        if (img) {
-            if (facingRight) {
-                g.DrawImage(img, 0, 0, drawW, drawH);
-            } else {
-                g.TranslateTransform((REAL)drawW, 0);
-                g.ScaleTransform(-1, 1);
-                g.DrawImage(img, 0, 0, drawW, drawH);
-            }
-        } else {
-            SolidBrush brush(Color(200, 255, 0, 255));
-            g.FillRectangle(&brush, 0, 0, drawW, drawH);
-        }
+std::wstring SpritePath(const std::string& name, int i) {
+    return L"assets/" + std::wstring(name.begin(), name.end()) + L"_" + std::to_wstring(i) + L".png";
+}
 
-        HBITMAP hAlphaBitmap = NULL;
-        bmp.GetHBITMAP(Color(0,0,0,0), &hAlphaBitmap);
-        if (hAlphaBitmap) {
-            HDC hdcAlpha = CreateCompatibleDC(hdcScreen);
-            HBITMAP hOldAlpha = (HBITMAP)SelectObject(hdcAlpha, hAlphaBitmap);
-            BLENDFUNCTION blend = { 0 };
-            blend.BlendOp = AC_SRC_OVER;
-            blend.SourceConstantAlpha = 255;
-            blend.AlphaFormat = AC_SRC_ALPHA;
-            POINT ptPos = { drawX, drawY };
-            SIZE sizeWnd = { drawW, drawH };
-            POINT ptSrc = { 0, 0 };
-            UpdateLayeredWindow(hBuddyWindow, hdcScreen, &ptPos, &sizeWnd, hdcAlpha, &ptSrc, 0, &blend, ULW_ALPHA);
-            SelectObject(hdcAlpha, hOldAlpha);
-            DeleteDC(hdcAlpha);
-            DeleteObject(hAlphaBitmap); 
+// Runs on the render thread, the first time a state using this set is drawn
+bool Win32SpriteSource::Load(const std::string& name, SpriteArena& arena, std::vector<SpriteFrame>& frames) {
+    if (spritePack.IsOpen()) {
+        int anim = spritePack.FindAnim(name);
+        if (anim == -1) return false;
+        const PackAnim& a = spritePack.Anim(anim);
+        for (uint32_t i = 0; i < a.frameCount; i++) {
+            const PackFrame& f = spritePack.Frame(a.firstFrame + i);
+            // Points into the mapped pixels; the pack stays open for the whole session
+            SpriteFrame frame;
+            frame.pixels = (const uint32_t*)spritePack.Pixels(a.firstFrame + i);
+            frame.width = f.width;
+            frame.height = f.height;
+            frames.push_back(frame);
         }
+        return true;
+    }
+    for (int i = 0; ; i++) {
+        std::wstring path = SpritePath(name, i);
+        if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES) break;
+        SpriteFrame frame;
+        if (DecodeSprite(path, arena, frame)) frames.push_back(frame);
     }
-    SelectObject(hdcMem, hOldBitmap);
-    DeleteDC(hdcMem);
-    DeleteObject(hBitmap); 
+    return true;
 }
 
-void LoadAnimation(State state, std::wstring baseName, int frameCount, int speedMs) {
-    AnimSequence seq;
-    seq.msPerFrame = speedMs;
-    for (int i = 0; i < frameCount; i++) {
-        std::wstring path = L"assets/" + baseName + L"_" + std::to_wstring(i) + L".png";
-        Image* img = Image::FromFile(path.c_str());
-        if (img && img->GetLastStatus() == Ok) seq.frames.push_back(img);
+// Only counts the frames (the simulation steps through them); decoding waits
+// until the state is first drawn
+int LoadAnimation(State state, const std::string& baseName, int speedMs) {
+    int count = 0;
+    if (spritePack.IsOpen()) {
+        int anim = spritePack.FindAnim(baseName);
+        if (anim != -1) count = (int)spritePack.Anim(anim).frameCount;
+    } else {
+        while (GetFileAttributesW(SpritePath(baseName, count).c_str()) != INVALID_FILE_ATTRIBUTES) count++;
+    }
+
+    if (count > 0) {
+        traceRecorder.Animation(state, count, speedMs);
+        sim.SetAnimation(state, count, speedMs);
+        if (swarm) swarm->SetAnimation(state, count, speedMs);
+        stateSet[state] = sprites.AddSet(baseName);
     }
-    if (!seq.frames.empty()) animations[state] = seq;
+    return count;
+}
+
+// Every monitor gets an overlay window. They are made here because windows
+// belong to the thread that creates them, and only this one pumps messages;
+// the render thread picks the new layout up with the next display epoch.
+const wchar_t OVERLAY_CLASS[] = L"DesktopBuddyOverlay";
+
+void UpdateOverlayLayout() {
+    EnterCriticalSection(&overlayLock);
+    while (overlayWindows.size() < sim.monitors.size()) {
+        HWND hwnd = CreateWindowEx(WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
+                                   OVERLAY_CLASS, L"Desktop Buddy", WS_POPUP, 0, 0, 1, 1, NULL, NULL, hAppInstance, NULL);
+        if (hwnd == NULL) break;
+        overlayWindows.push_back(hwnd);
+    }
+    overlayMonitors = sim.monitors;
+    if (overlayMonitors.size() > overlayWindows.size()) overlayMonitors.resize(overlayWindows.size());
+    LeaveCriticalSection(&overlayLock);
 }
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     switch (uMsg) {
     case WM_CREATE: SetTimer(hwnd, 1, Config::TICK_RATE, NULL); return 0;
-    case WM_DISPLAYCHANGE: UpdateEnvironment(); return 0;
-    case WM_TIMER: UpdatePhysics(); UpdateAI(); { HDC hdc = GetDC(NULL); DrawBuddy(hdc); ReleaseDC(NULL, hdc); } return 0;
+    case WM_DISPLAYCHANGE:
+        traceRecorder.EnvironmentUpdate();
+        sim.UpdateEnvironment();
+        UpdateOverlayLayout();
+        displayEpoch++;    // The render thread drops its surfaces on the next frame
+        scheduler.OnEnvironmentChanged(GetTickCount64());
+        SetTickDelay(hwnd, Config::TICK_RATE);
+        return 0;
+    case WM_TIMER:
+        if (GetAsyncKeyState(VK_ESCAPE)) { PostQuitMessage(0); return 0; }
+        {
+            unsigned long long now = win32Clock.Latch();
+            traceRecorder.Tick(now);
+            sim.Tick();
+            traceRecorder.Checkpoint(sim);
+            if (swarm) swarm->Tick(sim, now);
+            win32Clock.Release();
+            PublishFrame();
+            scheduler.RecordWakeup(sim.currentState, now);
+            if (scheduler.ReportDue(now)) {
+                LogDebug(scheduler.Report());
+                LogDebug(profiler->Summary());
+            }
+            // A swarm always has someone moving, so it never dozes
+            SetTickDelay(hwnd, swarm ? Config::TICK_RATE : scheduler.NextDelay(sim.currentState, now, sim.NextFrameDeadline(), sim.NextAIDeadline()));
+        }
+        return 0;
     case WM_DESTROY: PostQuitMessage(0); return 0;
     }
     return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR cmdLine, int) {
     SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
     GdiplusStartupInput gdiplusStartupInput;
     GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
-    srand(static_cast<unsigned int>(time(0)));
+    QueryPerformanceFrequency(&perfFreq);
+
+    // Histograms are always on; --profile also keeps a trace ring and writes
+    // profile_trace.json (Chrome trace format) on exit
+    writeTrace = (cmdLine && wcsstr(cmdLine, L"--profile") != NULL);
+    profiler = new Profiler(writeTrace ? Config::PROFILE_RING_SIZE : 0);
+    sim.SetProfiler(profiler);
+    unsigned long long seed = static_cast<unsigned long long>(time(0));
+    sim.Seed(seed);
+    sim.SetLogger(LogDebug);
+
+    // --record[=<file>] captures everything the simulation sees from the desktop
+    // (default desktop_trace.dbt); replay it headless with bench --trace=<file>
+    const wchar_t* recordArg = cmdLine ? wcsstr(cmdLine, L"--record") : NULL;
+    if (recordArg) {
+        std::string path = "desktop_trace.dbt";
+        if (recordArg[8] == L'=') {
+            const wchar_t* end = recordArg + 9;
+            while (*end && *end != L' ') end++;
+            path.assign(recordArg + 9, end);   // ASCII paths only
+        }
+        if (traceRecorder.Open(path.c_str(), seed, GetTickCount64())) {
+            LogDebug(L"[TRACE] Recording to " + std::wstring(path.begin(), path.end()) + L"\n");
+        }
+    }
 
-    UpdateEnvironment();
-    if (!monitors.empty()) {
-        posX = (monitors[0].left + monitors[0].right) / 2;
-        posY = monitors[0].bottom;
+    traceRecorder.EnvironmentUpdate();
+    sim.UpdateEnvironment();
+    traceRecorder.Place();
+    sim.PlaceOnFirstMonitor();
+    LoadTitleRules();
+
+    // --swarm=<N> adds N independent walkers, drawn under the buddy
+    const wchar_t* swarmArg = cmdLine ? wcsstr(cmdLine, L"--swarm=") : NULL;
+    if (swarmArg) {
+        int count = _wtoi(swarmArg + wcslen(L"--swarm="));
+        if (count > 0) {
+            swarm = new Swarm();
+            swarm->Spawn(sim, count, seed, GetTickCount64());
+            LogDebug(L"[SWARM] " + std::to_wstring(count) + L" walkers on " + std::to_wstring(swarm->Threads()) + L" threads\n");
+        }
     }
 
-    // TODO: Handle animation lenght dynamically based on assets folder contents
-    LoadAnimation(WALKING, L"walk", 4, Config::SPEED_WALK); 
-    LoadAnimation(FALLING, L"fall", 2, Config::SPEED_AIR);
-    LoadAnimation(PREPARE_JUMP, L"sit", 2, Config::SPEED_JUMP_PREP);
-    LoadAnimation(LEAPING, L"jump", 4, Config::SPEED_AIR); 
-    LoadAnimation(IDLE, L"idle", 2, Config::SPEED_IDLE); 
-    LoadAnimation(SITTING, L"sit", 2, Config::SPEED_SIT);
-    LoadAnimation(SLEEPING, L"sleep", 3, Config::SPEED_SLEEP); 
-    LoadAnimation(WATCHING_MOVIE, L"popcorn", 2, Config::SPEED_MOVIE);
+    // Decoded sprite sets are kept under this budget; --sprite-budget=<KB> overrides it
+    int budgetKB = Config::SPRITE_BUDGET_KB;
+    const wchar_t* budgetArg = cmdLine ? wcsstr(cmdLine, L"--sprite-budget=") : NULL;
+    if (budgetArg) budgetKB = _wtoi(budgetArg + wcslen(L"--sprite-budget="));
+    sprites.SetBudget((size_t)budgetKB * 1024);
+    sprites.SetSource(&spriteSource);
+    sprites.SetEvictListener(&scaledFrameEvictions);
+
+    LARGE_INTEGER loadStart, loadEnd;
+    QueryPerformanceCounter(&loadStart);
+    spritesFromPack = spritePack.Open("assets/sprites.pack");
+
+    for (int i = 0; i < STATE_COUNT; i++) stateSet[i] = -1;
+    int frameTotal = 0;
+    frameTotal += LoadAnimation(WALKING, "walk", Config::SPEED_WALK);
+    frameTotal += LoadAnimation(FALLING, "fall", Config::SPEED_AIR);
+    frameTotal += LoadAnimation(PREPARE_JUMP, "sit", Config::SPEED_JUMP_PREP);
+    frameTotal += LoadAnimation(LEAPING, "jump", Config::SPEED_AIR);
+    frameTotal += LoadAnimation(IDLE, "idle", Config::SPEED_IDLE);
+    frameTotal += LoadAnimation(SITTING, "sit", Config::SPEED_SIT);
+    frameTotal += LoadAnimation(SLEEPING, "sleep", Config::SPEED_SLEEP);
+    frameTotal += LoadAnimation(WATCHING_MOVIE, "popcorn", Config::SPEED_MOVIE);
+
+    QueryPerformanceCounter(&loadEnd);
+    {
+        std::wstringstream ss;
+        ss << L"[LOAD] " << frameTotal << L" frames in " << sprites.SetCount() << L" sets from "
+           << (spritesFromPack ? L"sprites.pack" : L"loose PNGs") << L", indexed in "
+           << (double)(loadEnd.QuadPart - loadStart.QuadPart) * 1000.0 / (double)perfFreq.QuadPart
+           << L" ms (decoded on first use, timed in [RENDER]; budget " << budgetKB << L" KB)\n";
+        LogDebug(ss.str());
+    }
 
     const wchar_t CLASS_NAME[] = L"DesktopBuddyClass";
     WNDCLASS wc = { };
@@ -571,15 +808,40 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int) {
     wc.lpszClassName = CLASS_NAME;
     RegisterClass(&wc);
 
-    hBuddyWindow = CreateWindowEx(WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST | WS_EX_TOOLWINDOW, CLASS_NAME, L"Desktop Buddy", WS_POPUP, 0, 0, 10, 10, NULL, NULL, hInstance, NULL);
+    WNDCLASS owc = { };
+    owc.lpfnWndProc = DefWindowProc;
+    owc.hInstance = hInstance;
+    owc.lpszClassName = OVERLAY_CLASS;
+    RegisterClass(&owc);
+
+    hAppInstance = hInstance;
+    hBuddyWindow = CreateWindowEx(WS_EX_TOOLWINDOW, CLASS_NAME, L"Desktop Buddy", WS_POPUP, 0, 0, 10, 10, NULL, NULL, hInstance, NULL);
     if (hBuddyWindow == NULL) return 0;
-    ShowWindow(hBuddyWindow, SW_SHOW);
+    InitializeCriticalSection(&overlayLock);
+    UpdateOverlayLayout();
+    InstallWindowHooks();
+    StartRenderThread();
 
     MSG msg = { };
     while (GetMessage(&msg, NULL, 0, 0) > 0) {
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
+    RemoveWindowHooks();
+    StopRenderThread();
+    for (HWND hwnd : overlayWindows) DestroyWindow(hwnd);
+    DeleteCriticalSection(&overlayLock);
+    delete swarm;
+    if (traceRecorder.Recording()) {
+        std::wstringstream ss;
+        ss << L"[TRACE] " << traceRecorder.ticks << L" ticks in " << traceRecorder.Bytes() / 1024
+           << L" KB (window lists alone would be " << traceRecorder.rawBytes / 1024 << L" KB raw)\n";
+        LogDebug(ss.str());
+        traceRecorder.Close();
+    }
+    frameCache.Clear(ReleaseFrame);
+    LogDebug(profiler->Summary());
+    if (writeTrace) profiler->WriteChromeTrace("profile_trace.json");
     GdiplusShutdown(gdiplusToken);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+#include "Config.h"
+
+// ==========================================
+//                 MOTION
+// ==========================================
+// Where a move has got to, as a closed form in the time since it started, in
+// 1/SUBPIXEL pixels. Speeds in Config are pixels per PHYSICS_STEP_MS; ticking
+// at any other rate samples the same path instead of stepping a different one.
+// At PHYSICS_STEP_MS the fall is exactly the old "pos += vel; vel += GRAVITY".
+
+namespace Motion {
+    const int SUBPIXEL = 256;
+
+    // Fall speed (px per step) during step n of a fall that started at v0
+    inline long long FallRate(int v0, long long n) {
+        long long v = v0 + n * Config::GRAVITY;
+        return v > Config::MAX_FALL_SPEED ? Config::MAX_FALL_SPEED : v;
+    }
+
+    // Whole pixels covered by the first n steps
+    inline long long FallSteps(int v0, long long n) {
+        if (v0 >= Config::MAX_FALL_SPEED) return n * Config::MAX_FALL_SPEED;
+        // Steps before the speed cap kicks in
+        long long k = (Config::MAX_FALL_SPEED - v0 + Config::GRAVITY - 1) / Config::GRAVITY;
+        if (n <= k) return n * v0 + Config::GRAVITY * n * (n - 1) / 2;
+        return k * v0 + Config::GRAVITY * k * (k - 1) / 2 + (n - k) * Config::MAX_FALL_SPEED;
+    }
+
+    // Subpixels fallen t ms into a fall that started at v0 px per step
+    inline long long FallOffset(int v0, unsigned long long t) {
+        long long n = (long long)(t / Config::PHYSICS_STEP_MS);
+        long long partial = (long long)(t % Config::PHYSICS_STEP_MS);
+        return FallSteps(v0, n) * SUBPIXEL + FallRate(v0, n) * SUBPIXEL * partial / Config::PHYSICS_STEP_MS;
+    }
+
+    inline int FallSpeed(int v0, unsigned long long t) {
+        return (int)FallRate(v0, (long long)(t / Config::PHYSICS_STEP_MS));
+    }
+
+    // Straight line at LEAP_SPEED towards (dx, dy). True once arrived; until
+    // then (ox, oy) is the offset from the start in subpixels.
+    inline bool LeapOffset(int dx, int dy, unsigned long long t, long long& ox, long long& oy) {
+        double len2 = (double)dx * dx + (double)dy * dy;
+        long long dist = (long long)std::sqrt(len2 * SUBPIXEL * SUBPIXEL);
+        long long travelled = (long long)Config::LEAP_SPEED * SUBPIXEL * (long long)t / Config::PHYSICS_STEP_MS;
+        if (travelled >= dist) return true;
+        ox = (long long)dx * SUBPIXEL * travelled / dist;
+        oy = (long long)dy * SUBPIXEL * travelled / dist;
+        return false;
+    }
+
+    // Whole pixels to walk in dt ms at 'speed' px per step. The leftover
+    // fraction is carried in 'remainder', so no distance is lost to rounding.
+    inline int WalkStep(int speed, unsigned long long dt, long long& remainder) {
+        long long total = (long long)speed * (long long)dt + remainder;
+        remainder = total % Config::PHYSICS_STEP_MS;
+        return (int)(total / Config::PHYSICS_STEP_MS);
+    }
+}
@@ -0,0 +1,331 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang only emit AVX2 inside functions marked for it; MSVC doesn't need the hint
+#if defined(PIXEL_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_KERNELS_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_KERNELS_AVX2
+#endif
+
+// ==========================================
+//              PIXEL KERNELS
+// ==========================================
+// The only pixel work a sprite needs: straight -> premultiplied alpha once at
+// load, a nearest-neighbor scale (optionally mirrored) on a frame cache miss,
+// and a source-over blend onto the compositor's surfaces. Pixels are 32-bit
+// BGRA (0xAARRGGBB in a uint32_t).
+// Every path produces exactly the scalar result; SSE2/AVX2 are picked at
+// runtime, and anything that isn't x86 gets the scalar code.
+
+namespace PixelKernels {
+
+enum Isa { ISA_SCALAR, ISA_SSE2, ISA_AVX2 };
+
+inline const char* IsaName(Isa isa) {
+    return isa == ISA_AVX2 ? "avx2" : (isa == ISA_SSE2 ? "sse2" : "scalar");
+}
+
+// Best instruction set this CPU runs
+inline Isa DetectIsa() {
+#if defined(PIXEL_KERNELS_X86)
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        __cpuid(info, 1);
+        bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        if (avx2 && osAvx) return ISA_AVX2;
+    }
+    return ISA_SSE2;
+#else
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+    return ISA_SCALAR;
+#endif
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+inline Isa BestIsa() {
+    static const Isa best = DetectIsa();
+    return best;
+}
+
+// --- PREMULTIPLY ---
+// c * a / 255, rounded to nearest: t = c*a + 128; (t + (t >> 8)) >> 8
+inline uint32_t PremultiplyPixel(uint32_t p) {
+    uint32_t a = p >> 24;
+    uint32_t b = p & 0xFF, g = (p >> 8) & 0xFF, r = (p >> 16) & 0xFF;
+    uint32_t tb = b * a + 128, tg = g * a + 128, tr = r * a + 128;
+    b = (tb + (tb >> 8)) >> 8;
+    g = (tg + (tg >> 8)) >> 8;
+    r = (tr + (tr >> 8)) >> 8;
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+inline void PremultiplyScalar(const uint32_t* src, uint32_t* dst, int count) {
+    for (int i = 0; i < count; i++) dst[i] = PremultiplyPixel(src[i]);
+}
+
+#if defined(PIXEL_KERNELS_X86)
+// 16-bit lanes: each channel times its pixel's alpha (alpha lane times 255, which rounds back to alpha)
+inline __m128i PremultiplyLanes128(__m128i px16, __m128i alphaLane, __m128i bias) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(_mm_andnot_si128(alphaLane, a), _mm_and_si128(alphaLane, _mm_set1_epi16(255)));
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(px16, a), bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+inline void PremultiplySse2(const uint32_t* src, uint32_t* dst, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i alphaLane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = PremultiplyLanes128(_mm_unpacklo_epi8(v, zero), alphaLane, bias);
+        __m128i hi = PremultiplyLanes128(_mm_unpackhi_epi8(v, zero), alphaLane, bias);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    PremultiplyScalar(src + i, dst + i, count - i);
+}
+
+PIXEL_KERNELS_AVX2 inline __m256i PremultiplyLanes256(__m256i px16, __m256i alphaLane, __m256i bias) {
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm256_or_si256(_mm256_andnot_si256(alphaLane, a), _mm256_and_si256(alphaLane, _mm256_set1_epi16(255)));
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px16, a), bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+PIXEL_KERNELS_AVX2 inline void PremultiplyAvx2(const uint32_t* src, uint32_t* dst, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i alphaLane = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // unpack/pack work per 128-bit half, so pixel order comes back out unchanged
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i lo = PremultiplyLanes256(_mm256_unpacklo_epi8(v, zero), alphaLane, bias);
+        __m256i hi = PremultiplyLanes256(_mm256_unpackhi_epi8(v, zero), alphaLane, bias);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    PremultiplyScalar(src + i, dst + i, count - i);
+}
+#endif
+
+// Straight BGRA -> premultiplied BGRA; src == dst is fine
+inline void Premultiply(const uint32_t* src, uint32_t* dst, int count, Isa isa = BestIsa()) {
+#if defined(PIXEL_KERNELS_X86)
+    if (isa == ISA_AVX2) { PremultiplyAvx2(src, dst, count); return; }
+    if (isa == ISA_SSE2) { PremultiplySse2(src, dst, count); return; }
+#endif
+    PremultiplyScalar(src, dst, count);
+}
+
+// --- NEAREST-NEIGHBOR SCALE ---
+// Destination pixel centers map onto source pixels: sx = ((2x + 1) * srcW) / (2 * dstW).
+// Integer factors give exact k x k blocks. Mirroring flips the destination row.
+inline int SourceIndex(int d, int srcSize, int dstSize) {
+    return (int)(((2ll * d + 1) * srcSize) / (2ll * dstSize));
+}
+
+inline void ScaleRowScalar(const uint32_t* srcRow, uint32_t* dstRow, const int* xmap, int dstW) {
+    for (int x = 0; x < dstW; x++) dstRow[x] = srcRow[xmap[x]];
+}
+
+// Integer factor k: each source pixel becomes k copies (reversed order when mirrored)
+inline void ExpandRowScalar(const uint32_t* srcRow, uint32_t* dstRow, int srcW, int k, bool mirror, int first = 0) {
+    for (int s = first; s < srcW; s++) {
+        uint32_t p = srcRow[mirror ? srcW - 1 - s : s];
+        uint32_t* d = dstRow + s * k;
+        for (int j = 0; j < k; j++) d[j] = p;
+    }
+}
+
+#if defined(PIXEL_KERNELS_X86)
+// One broadcast store per source pixel (k <= 8 as two SSE stores). A store may
+// spill into the following blocks, which later iterations overwrite; the vector
+// loop stops while a full store still fits in the row, scalar code does the rest.
+inline void ExpandRowSse2(const uint32_t* srcRow, uint32_t* dstRow, int srcW, int k, bool mirror) {
+    int width = (k > 4) ? 8 : 4;
+    int s = 0;
+    for (; s * k + width <= srcW * k; s++) {
+        __m128i v = _mm_set1_epi32((int)srcRow[mirror ? srcW - 1 - s : s]);
+        uint32_t* d = dstRow + s * k;
+        _mm_storeu_si128((__m128i*)d, v);
+        if (k > 4) _mm_storeu_si128((__m128i*)(d + 4), v);
+    }
+    ExpandRowScalar(srcRow, dstRow, srcW, k, mirror, s);
+}
+
+PIXEL_KERNELS_AVX2 inline void ExpandRowAvx2(const uint32_t* srcRow, uint32_t* dstRow, int srcW, int k, bool mirror) {
+    int s = 0;
+    for (; s * k + 8 <= srcW * k; s++) {
+        __m256i v = _mm256_set1_epi32((int)srcRow[mirror ? srcW - 1 - s : s]);
+        _mm256_storeu_si256((__m256i*)(dstRow + s * k), v);
+    }
+    ExpandRowScalar(srcRow, dstRow, srcW, k, mirror, s);
+}
+
+PIXEL_KERNELS_AVX2 inline void ScaleRowAvx2(const uint32_t* srcRow, uint32_t* dstRow, const int* xmap, int dstW) {
+    int x = 0;
+    for (; x + 8 <= dstW; x += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i*)(xmap + x));
+        _mm256_storeu_si256((__m256i*)(dstRow + x), _mm256_i32gather_epi32((const int*)srcRow, idx, 4));
+    }
+    ScaleRowScalar(srcRow, dstRow + x, xmap + x, dstW - x);
+}
+#endif
+
+// Strides are in pixels. 'xmap' is scratch space the caller can keep between
+// calls to avoid reallocating it.
+inline void ScaleNearest(const uint32_t* src, int srcW, int srcH, int srcStride,
+                         uint32_t* dst, int dstW, int dstH, int dstStride,
+                         bool mirror, std::vector<int>& xmap, Isa isa = BestIsa()) {
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) return;
+    int k = (dstW % srcW == 0) ? dstW / srcW : 0;
+    bool expand = (k >= 1 && k <= 8);
+
+    if (!expand) {
+        xmap.resize(dstW);
+        for (int x = 0; x < dstW; x++) {
+            int sx = SourceIndex(x, srcW, dstW);
+            xmap[mirror ? dstW - 1 - x : x] = sx;
+        }
+    }
+
+    int lastSy = -1;
+    for (int y = 0; y < dstH; y++) {
+        uint32_t* dstRow = dst + (size_t)y * dstStride;
+        int sy = SourceIndex(y, srcH, dstH);
+        if (sy == lastSy) {
+            // Vertical upscale repeats rows: copy the one we just made
+            memcpy(dstRow, dstRow - dstStride, (size_t)dstW * 4);
+            continue;
+        }
+        lastSy = sy;
+        const uint32_t* srcRow = src + (size_t)sy * srcStride;
+
+        if (expand) {
+#if defined(PIXEL_KERNELS_X86)
+            if (isa == ISA_AVX2) { ExpandRowAvx2(srcRow, dstRow, srcW, k, mirror); continue; }
+            if (isa == ISA_SSE2) { ExpandRowSse2(srcRow, dstRow, srcW, k, mirror); continue; }
+#endif
+            ExpandRowScalar(srcRow, dstRow, srcW, k, mirror);
+        } else {
+#if defined(PIXEL_KERNELS_X86)
+            if (isa == ISA_AVX2) { ScaleRowAvx2(srcRow, dstRow, xmap.data(), dstW); continue; }
+#endif
+            // SSE2 has no gather; the scalar loop is as good as it gets there
+            ScaleRowScalar(srcRow, dstRow, xmap.data(), dstW);
+        }
+    }
+}
+
+// Solid fill (already premultiplied color)
+inline void Fill(uint32_t* dst, int w, int h, int stride, uint32_t color) {
+    for (int y = 0; y < h; y++) {
+        uint32_t* row = dst + (size_t)y * stride;
+        for (int x = 0; x < w; x++) row[x] = color;
+    }
+}
+
+// --- BLEND ---
+// Premultiplied source-over: d = s + d * (255 - sa) / 255 per channel, with the
+// same rounding as Premultiply. Valid premultiplied input never overflows a
+// channel; anything else saturates.
+inline uint32_t BlendPixel(uint32_t s, uint32_t d) {
+    uint32_t ia = 255 - (s >> 24);
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t t = ((d >> shift) & 0xFF) * ia + 128;
+        uint32_t c = ((s >> shift) & 0xFF) + ((t + (t >> 8)) >> 8);
+        out |= (c > 255 ? 255 : c) << shift;
+    }
+    return out;
+}
+
+inline void BlendOverScalar(const uint32_t* src, uint32_t* dst, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t s = src[i];
+        if ((s >> 24) == 255) dst[i] = s;
+        else if (s) dst[i] = BlendPixel(s, dst[i]);
+    }
+}
+
+#if defined(PIXEL_KERNELS_X86)
+// Each pixel's 255 - alpha in all four of its 16-bit lanes, as unpack*_epi8 lays them out
+inline __m128i InverseAlpha128(__m128i s, bool high) {
+    __m128i ia = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(s, 24));
+    ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+    return high ? _mm_unpackhi_epi32(ia, ia) : _mm_unpacklo_epi32(ia, ia);
+}
+
+inline __m128i ScaleLanes128(__m128i d16, __m128i ia16, __m128i bias) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(d16, ia16), bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+inline void BlendOverSse2(const uint32_t* src, uint32_t* dst, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = ScaleLanes128(_mm_unpacklo_epi8(d, zero), InverseAlpha128(s, false), bias);
+        __m128i hi = ScaleLanes128(_mm_unpackhi_epi8(d, zero), InverseAlpha128(s, true), bias);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+    BlendOverScalar(src + i, dst + i, count - i);
+}
+
+PIXEL_KERNELS_AVX2 inline __m256i InverseAlpha256(__m256i s, bool high) {
+    __m256i ia = _mm256_sub_epi32(_mm256_set1_epi32(255), _mm256_srli_epi32(s, 24));
+    ia = _mm256_or_si256(ia, _mm256_slli_epi32(ia, 16));
+    return high ? _mm256_unpackhi_epi32(ia, ia) : _mm256_unpacklo_epi32(ia, ia);
+}
+
+PIXEL_KERNELS_AVX2 inline __m256i ScaleLanes256(__m256i d16, __m256i ia16, __m256i bias) {
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d16, ia16), bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+PIXEL_KERNELS_AVX2 inline void BlendOverAvx2(const uint32_t* src, uint32_t* dst, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i lo = ScaleLanes256(_mm256_unpacklo_epi8(d, zero), InverseAlpha256(s, false), bias);
+        __m256i hi = ScaleLanes256(_mm256_unpackhi_epi8(d, zero), InverseAlpha256(s, true), bias);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+    }
+    BlendOverScalar(src + i, dst + i, count - i);
+}
+#endif
+
+// src over dst, 'count' pixels
+inline void BlendOver(const uint32_t* src, uint32_t* dst, int count, Isa isa = BestIsa()) {
+#if defined(PIXEL_KERNELS_X86)
+    if (isa == ISA_AVX2) { BlendOverAvx2(src, dst, count); return; }
+    if (isa == ISA_SSE2) { BlendOverSse2(src, dst, count); return; }
+#endif
+    BlendOverScalar(src, dst, count);
+}
+
+} // namespace PixelKernels
@@ -0,0 +1,644 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+// ==========================================
+//              PNG CODEC
+// ==========================================
+// Just enough PNG for the sprite tools, without zlib: decodes every standard
+// color type and bit depth (interlaced too) to straight BGRA, and writes 8-bit
+// indexed images with a small LZ77 + fixed-Huffman deflate. That comes out
+// about a third bigger than zlib's default, on sprites of around 1 KB.
+
+namespace Png {
+
+// Decoded image, straight (not premultiplied) BGRA, stride = width
+struct Image {
+    int width = 0, height = 0;
+    std::vector<uint32_t> pixels;
+};
+
+// --- CHECKSUMS ---
+inline uint32_t Crc32(const uint8_t* p, size_t n, uint32_t crc = 0) {
+    struct Table {
+        uint32_t t[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    };
+    static const Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t Adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1, b = 0;
+    while (n > 0) {
+        size_t run = n < 5552 ? n : 5552;   // Longest run before b can overflow
+        n -= run;
+        size_t i = 0;
+        // 16 bytes at a time: b gains 16 * a plus each byte weighted by how many sums it is in
+        for (; i + 16 <= run; i += 16) {
+            uint32_t sum = 0, weighted = 0;
+            for (int k = 0; k < 16; k++) { sum += p[i + k]; weighted += (uint32_t)(16 - k) * p[i + k]; }
+            b += 16 * a + weighted;
+            a += sum;
+        }
+        for (; i < run; i++) { a += p[i]; b += a; }
+        p += run;
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// --- INFLATE ---
+const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// LSB-first bit reader. Reading past the end yields zeros and is caught afterwards.
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t bits = 0;
+    int count = 0;
+    size_t overrun = 0;
+
+    BitReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    void Refill() {
+        while (count <= 56) {
+            uint64_t b = 0;
+            if (p < end) b = *p++; else overrun++;
+            bits |= b << count;
+            count += 8;
+        }
+    }
+    uint32_t Peek(int n) { if (count < n) Refill(); return (uint32_t)(bits & ((1ull << n) - 1)); }
+    void Drop(int n) { bits >>= n; count -= n; }
+    uint32_t Get(int n) { uint32_t v = Peek(n); Drop(n); return v; }
+    bool Overran() const { return overrun * 8 > (size_t)count; }
+};
+
+// Canonical Huffman code: codes up to FAST bits in one lookup, longer ones bit by bit
+struct Huffman {
+    static const int FAST = 10;
+    uint16_t fast[1 << FAST];       // (length << 9) | symbol, 0 = longer than FAST
+    uint16_t counts[16];            // Codes per length
+    uint16_t symbols[288];          // Sorted by code
+
+    bool Build(const uint8_t* lengths, int n) {
+        memset(counts, 0, sizeof(counts));
+        for (int i = 0; i < n; i++) counts[lengths[i]]++;
+        counts[0] = 0;
+        int left = 1;
+        for (int len = 1; len < 16; len++) {
+            left = (left << 1) - counts[len];
+            if (left < 0) return false;     // Over-subscribed
+        }
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + counts[len];
+        for (int i = 0; i < n; i++) if (lengths[i]) symbols[offsets[lengths[i]]++] = (uint16_t)i;
+
+        memset(fast, 0, sizeof(fast));
+        int code = 0, index = 0;
+        for (int len = 1; len <= FAST; len++) {
+            for (int k = 0; k < counts[len]; k++, code++, index++) {
+                int reversed = 0;
+                for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1) << (len - 1 - b);
+                for (int i = reversed; i < (1 << FAST); i += 1 << len) fast[i] = (uint16_t)((len << 9) | symbols[index]);
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // -1 on a code that isn't in the table
+    int Decode(BitReader& br) const {
+        uint32_t entry = fast[br.Peek(FAST)];
+        if (entry) {
+            br.Drop(entry >> 9);
+            return entry & 511;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++) {
+            code |= (int)br.Get(1);
+            int count = counts[len];
+            if (code - count < first) return symbols[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+};
+
+// zlib stream -> bytes (appended to 'out'); false if damaged. 'expected':
+// output size if known, so the buffer is allocated once.
+inline bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t expected = 0) {
+    if (size < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) return false;
+    size_t start = out.size(), pos = start;
+    // Written through 'pos' and trimmed at the end; grows if 'expected' was short
+    out.resize(start + (expected ? expected : size * 4) + 258);
+    auto room = [&](size_t n) {
+        if (pos + n > out.size()) out.resize((pos + n) * 2);
+    };
+    BitReader br(data + 2, size - 6);
+    Huffman lit, dist;
+    bool final = false;
+    while (!final) {
+        final = br.Get(1) != 0;
+        uint32_t type = br.Get(2);
+        if (type == 0) {
+            br.Drop(br.count & 7);
+            uint32_t len = br.Get(16), nlen = br.Get(16);
+            if ((len ^ 0xFFFF) != nlen) return false;
+            room(len);
+            for (uint32_t i = 0; i < len; i++) out[pos++] = (uint8_t)br.Get(8);
+            if (br.Overran()) return false;
+            continue;
+        }
+        uint8_t lengths[320];
+        if (type == 1) {
+            for (int i = 0; i < 288; i++) lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+            for (int i = 0; i < 30; i++) lengths[288 + i] = 5;
+            lit.Build(lengths, 288);
+            dist.Build(lengths + 288, 30);
+        } else if (type == 2) {
+            int nlit = (int)br.Get(5) + 257, ndist = (int)br.Get(5) + 1, ncode = (int)br.Get(4) + 4;
+            static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            uint8_t codeLengths[19] = { 0 };
+            for (int i = 0; i < ncode; i++) codeLengths[order[i]] = (uint8_t)br.Get(3);
+            Huffman lenCode;
+            if (nlit > 286 || ndist > 30 || !lenCode.Build(codeLengths, 19)) return false;
+            for (int i = 0; i < nlit + ndist; ) {
+                int sym = lenCode.Decode(br);
+                if (sym < 0) return false;
+                if (sym < 16) { lengths[i++] = (uint8_t)sym; continue; }
+                int repeat, value = 0;
+                if (sym == 16) {
+                    if (i == 0) return false;
+                    value = lengths[i - 1];
+                    repeat = 3 + (int)br.Get(2);
+                } else if (sym == 17) {
+                    repeat = 3 + (int)br.Get(3);
+                } else {
+                    repeat = 11 + (int)br.Get(7);
+                }
+                if (i + repeat > nlit + ndist) return false;
+                while (repeat--) lengths[i++] = (uint8_t)value;
+            }
+            if (!lit.Build(lengths, nlit) || !dist.Build(lengths + nlit, ndist)) return false;
+        } else {
+            return false;
+        }
+
+        while (true) {
+            int sym = lit.Decode(br);
+            if (sym < 0) return false;
+            if (sym < 256) {
+                room(1);
+                out[pos++] = (uint8_t)sym;
+                continue;
+            }
+            if (sym == 256) break;
+            sym -= 257;
+            if (sym >= 29) return false;
+            size_t len = LENGTH_BASE[sym] + br.Get(LENGTH_EXTRA[sym]);
+            int d = dist.Decode(br);
+            if (d < 0 || d >= 30) return false;
+            size_t back = DIST_BASE[d] + br.Get(DIST_EXTRA[d]);
+            if (back > pos - start) return false;
+            room(len);
+            uint8_t* o = out.data() + pos;
+            const uint8_t* s = o - back;
+            // Overlapping (a run): the pattern repeats every 'back' bytes, so
+            // copy what is already there, doubling the piece each time
+            for (size_t done = 0; done < len; ) {
+                size_t n = len - done < back + done ? len - done : back + done;
+                memcpy(o + done, s, n);
+                done += n;
+            }
+            pos += len;
+            if (br.Overran()) return false;
+        }
+        if (br.Overran()) return false;
+    }
+    out.resize(pos);
+    // Adler-32 of the output follows the stream, big endian
+    const uint8_t* tail = data + size - 4;
+    uint32_t adler = ((uint32_t)tail[0] << 24) | ((uint32_t)tail[1] << 16) | ((uint32_t)tail[2] << 8) | tail[3];
+    return Adler32(out.data() + start, out.size() - start) == adler;
+}
+
+// --- DEFLATE ---
+// LZ77 over a 32 KB window (hash chains, first match wins past a few tries),
+// coded with the fixed Huffman tables: no table to send, which pays off on
+// images this small.
+class Deflater {
+public:
+    // bytes -> zlib stream (appended to 'out')
+    void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        out.push_back(0x78);
+        out.push_back(0x01);
+        bits = 0;
+        count = 0;
+        sink = &out;
+        Put(1, 1);      // Final block
+        Put(1, 2);      // Fixed Huffman
+
+        head.assign(HASH_SIZE, -1);
+        prev.resize(size);
+        size_t i = 0;
+        while (i < size) {
+            int bestLen = 0, bestDist = 0;
+            if (i + MIN_MATCH <= size) {
+                uint32_t h = Hash(data + i);
+                int tries = MAX_CHAIN;
+                for (int cand = head[h]; cand != -1 && i - cand <= WINDOW && tries--; cand = prev[cand]) {
+                    int len = 0, limit = (int)(size - i < MAX_MATCH ? size - i : MAX_MATCH);
+                    const uint8_t* a = data + cand;
+                    const uint8_t* b = data + i;
+                    while (len < limit && a[len] == b[len]) len++;
+                    if (len > bestLen) {
+                        bestLen = len;
+                        bestDist = (int)(i - cand);
+                        if (len == limit) break;
+                    }
+                }
+            }
+            if (bestLen >= MIN_MATCH) {
+                PutLength(bestLen);
+                PutDistance(bestDist);
+                for (int k = 0; k < bestLen; k++, i++) Insert(data, i, size);
+            } else {
+                PutLiteral(data[i]);
+                Insert(data, i, size);
+                i++;
+            }
+        }
+        PutLiteral(256);
+        if (count > 0) out.push_back((uint8_t)bits);
+        uint32_t adler = Adler32(data, size);
+        for (int s = 24; s >= 0; s -= 8) out.push_back((uint8_t)(adler >> s));
+    }
+
+private:
+    static const int HASH_BITS = 14;
+    static const int HASH_SIZE = 1 << HASH_BITS;
+    static const size_t WINDOW = 32768;
+    static const int MIN_MATCH = 3;
+    static const int MAX_MATCH = 258;
+    static const int MAX_CHAIN = 16;
+
+    std::vector<int> head, prev;
+    std::vector<uint8_t>* sink = nullptr;
+    uint64_t bits = 0;
+    int count = 0;
+
+    static uint32_t Hash(const uint8_t* p) {
+        uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void Insert(const uint8_t* data, size_t i, size_t size) {
+        if (i + MIN_MATCH > size) return;
+        uint32_t h = Hash(data + i);
+        prev[i] = head[h];
+        head[h] = (int)i;
+    }
+
+    void Put(uint32_t value, int n) {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8) {
+            sink->push_back((uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes go out most significant bit first
+    void PutCode(uint32_t code, int len) {
+        uint32_t reversed = 0;
+        for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1) << (len - 1 - b);
+        Put(reversed, len);
+    }
+
+    void PutLiteral(int sym) {
+        if (sym < 144) PutCode(0x30 + sym, 8);
+        else if (sym < 256) PutCode(0x190 + sym - 144, 9);
+        else if (sym < 280) PutCode(sym - 256, 7);
+        else PutCode(0xC0 + sym - 280, 8);
+    }
+
+    void PutLength(int len) {
+        int code = 28;
+        while (LENGTH_BASE[code] > len) code--;
+        PutLiteral(257 + code);
+        Put(len - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    }
+
+    void PutDistance(int d) {
+        int code = 29;
+        while (DIST_BASE[code] > d) code--;
+        PutCode(code, 5);
+        Put(d - DIST_BASE[code], DIST_EXTRA[code]);
+    }
+};
+
+// --- DECODE ---
+inline uint32_t ReadBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline bool Fail(std::string* error, const char* why) {
+    if (error) *error = why;
+    return false;
+}
+
+// Written to compile to selects rather than branches: the pick is unpredictable
+inline uint8_t Paeth(int a, int b, int c) {
+    int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+    int bc = pb <= pc ? b : c;
+    return (uint8_t)(pa <= pb && pa <= pc ? a : bc);
+}
+
+// Undo one scanline's filter in place; 'prior' is the previous unfiltered line (or zeros)
+inline bool Unfilter(uint8_t type, uint8_t* row, const uint8_t* prior, size_t len, int bpp) {
+    switch (type) {
+    case 0: break;
+    case 1:
+        if (bpp == 4) {
+            // A pixel at a time: bytewise add with the carries between bytes masked off
+            uint32_t left = 0;
+            for (size_t i = 0; i + 4 <= len; i += 4) {
+                uint32_t x;
+                memcpy(&x, row + i, 4);
+                left = ((x & 0x7F7F7F7Fu) + (left & 0x7F7F7F7Fu)) ^ ((x ^ left) & 0x80808080u);
+                memcpy(row + i, &left, 4);
+            }
+            break;
+        }
+        for (size_t i = bpp; i < len; i++) row[i] += row[i - bpp];
+        break;
+    case 2: {
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t x, y;
+            memcpy(&x, row + i, 8);
+            memcpy(&y, prior + i, 8);
+            x = ((x & 0x7F7F7F7F7F7F7F7Full) + (y & 0x7F7F7F7F7F7F7F7Full)) ^ ((x ^ y) & 0x8080808080808080ull);
+            memcpy(row + i, &x, 8);
+        }
+        for (; i < len; i++) row[i] += prior[i];
+        break;
+    }
+    case 3:
+        for (size_t i = 0; i < len; i++) row[i] += (uint8_t)(((i >= (size_t)bpp ? row[i - bpp] : 0) + prior[i]) >> 1);
+        break;
+    case 4:
+        for (size_t i = 0; i < (size_t)bpp && i < len; i++) row[i] += prior[i];
+        for (size_t i = bpp; i < len; i++) row[i] += Paeth(row[i - bpp], prior[i], prior[i - bpp]);
+        break;
+    default: return false;
+    }
+    return true;
+}
+
+// Everything needed to turn raw samples into BGRA
+struct Format {
+    int colorType, depth, channels;
+    uint32_t palette[256];
+    int paletteSize = 0;
+    bool hasKey = false;
+    uint16_t key[3] = { 0, 0, 0 };      // tRNS for gray / RGB: this exact sample is transparent
+
+    uint16_t Sample(const uint8_t* row, size_t index) const {
+        switch (depth) {
+        case 8: return row[index];
+        case 16: return (uint16_t)((row[index * 2] << 8) | row[index * 2 + 1]);
+        default: {
+            size_t bit = index * depth;
+            return (uint16_t)((row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1));
+        }
+        }
+    }
+
+    uint32_t To8(uint16_t v) const {
+        if (depth == 16) return v >> 8;
+        if (depth == 8) return v;
+        return v * 255u / ((1u << depth) - 1);
+    }
+
+    // One row of 'width' pixels into dst (every 'step'-th pixel)
+    bool Convert(const uint8_t* row, int width, uint32_t* dst, int step) const {
+        if (colorType == 6 && depth == 8) {
+            for (int x = 0; x < width; x++, row += 4)
+                dst[(size_t)x * step] = ((uint32_t)row[3] << 24) | ((uint32_t)row[0] << 16) | ((uint32_t)row[1] << 8) | row[2];
+            return true;
+        }
+        if (colorType == 3 && depth == 8) {
+            for (int x = 0; x < width; x++) {
+                if (row[x] >= paletteSize) return false;
+                dst[(size_t)x * step] = palette[row[x]];
+            }
+            return true;
+        }
+        for (int x = 0; x < width; x++) {
+            size_t s = (size_t)x * channels;
+            uint32_t r, g, b, a = 255;
+            switch (colorType) {
+            case 0: {
+                uint16_t v = Sample(row, s);
+                r = g = b = To8(v);
+                if (hasKey && v == key[0]) a = 0;
+                break;
+            }
+            case 2: {
+                uint16_t vr = Sample(row, s), vg = Sample(row, s + 1), vb = Sample(row, s + 2);
+                r = To8(vr); g = To8(vg); b = To8(vb);
+                if (hasKey && vr == key[0] && vg == key[1] && vb == key[2]) a = 0;
+                break;
+            }
+            case 3: {
+                uint16_t i = Sample(row, s);
+                if (i >= paletteSize) return false;
+                dst[(size_t)x * step] = palette[i];
+                continue;
+            }
+            case 4:
+                r = g = b = To8(Sample(row, s));
+                a = To8(Sample(row, s + 1));
+                break;
+            default:
+                r = To8(Sample(row, s)); g = To8(Sample(row, s + 1)); b = To8(Sample(row, s + 2));
+                a = To8(Sample(row, s + 3));
+                break;
+            }
+            dst[(size_t)x * step] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+        return true;
+    }
+};
+
+// PNG file bytes -> image. 'scratch' keeps the inflated data's allocation between calls.
+inline bool Decode(const uint8_t* data, size_t size, Image& out, std::vector<uint8_t>& scratch, std::string* error = nullptr) {
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (size < 8 || memcmp(data, SIGNATURE, 8) != 0) return Fail(error, "not a PNG");
+
+    Format f;
+    int width = 0, height = 0, interlace = 0;
+    bool header = false, ended = false;
+    std::vector<uint8_t> idat;
+    for (size_t pos = 8; pos + 12 <= size && !ended; ) {
+        uint32_t len = ReadBE32(data + pos);
+        if (len > size - pos - 12) return Fail(error, "truncated chunk");
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* body = data + pos + 8;
+        if (Crc32(type, len + 4) != ReadBE32(body + len)) return Fail(error, "bad chunk CRC");
+        pos += 12 + len;
+
+        if (!memcmp(type, "IHDR", 4)) {
+            if (len != 13) return Fail(error, "bad IHDR");
+            width = (int)ReadBE32(body);
+            height = (int)ReadBE32(body + 4);
+            f.depth = body[8];
+            f.colorType = body[9];
+            interlace = body[12];
+            static const int CHANNELS[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            if (f.colorType > 6 || !CHANNELS[f.colorType]) return Fail(error, "bad color type");
+            f.channels = CHANNELS[f.colorType];
+            bool depthOk = f.colorType == 0 ? (f.depth == 1 || f.depth == 2 || f.depth == 4 || f.depth == 8 || f.depth == 16)
+                         : f.colorType == 3 ? (f.depth == 1 || f.depth == 2 || f.depth == 4 || f.depth == 8)
+                         : (f.depth == 8 || f.depth == 16);
+            if (!depthOk || body[10] || body[11] || interlace > 1) return Fail(error, "unsupported IHDR");
+            if (width <= 0 || height <= 0 || (long long)width * height > (1ll << 28)) return Fail(error, "bad size");
+            header = true;
+        } else if (!memcmp(type, "PLTE", 4)) {
+            if (len % 3 || len > 768) return Fail(error, "bad PLTE");
+            f.paletteSize = (int)(len / 3);
+            for (int i = 0; i < f.paletteSize; i++)
+                f.palette[i] = 0xFF000000u | ((uint32_t)body[i * 3] << 16) | ((uint32_t)body[i * 3 + 1] << 8) | body[i * 3 + 2];
+        } else if (!memcmp(type, "tRNS", 4)) {
+            if (f.colorType == 3) {
+                for (uint32_t i = 0; i < len && i < (uint32_t)f.paletteSize; i++) f.palette[i] = (f.palette[i] & 0xFFFFFF) | ((uint32_t)body[i] << 24);
+            } else if (f.colorType == 0 && len >= 2) {
+                f.hasKey = true;
+                f.key[0] = (uint16_t)((body[0] << 8) | body[1]);
+            } else if (f.colorType == 2 && len >= 6) {
+                f.hasKey = true;
+                for (int c = 0; c < 3; c++) f.key[c] = (uint16_t)((body[c * 2] << 8) | body[c * 2 + 1]);
+            }
+        } else if (!memcmp(type, "IDAT", 4)) {
+            idat.insert(idat.end(), body, body + len);
+        } else if (!memcmp(type, "IEND", 4)) {
+            ended = true;
+        } else if (!(type[0] & 0x20)) {
+            return Fail(error, "unknown critical chunk");
+        }
+    }
+    if (!header || idat.empty()) return Fail(error, "missing IHDR or IDAT");
+    if (f.colorType == 3 && f.paletteSize == 0) return Fail(error, "missing PLTE");
+
+    scratch.clear();
+    size_t expected = (size_t)height * (1 + ((size_t)width * f.channels * f.depth + 7) / 8);
+    if (!Inflate(idat.data(), idat.size(), scratch, expected)) return Fail(error, "damaged image data");
+
+    out.width = width;
+    out.height = height;
+    out.pixels.assign((size_t)width * height, 0);
+    int bpp = (f.channels * f.depth + 7) / 8;      // Filter distance in bytes
+    std::vector<uint8_t> zeros;
+
+    // Adam7 passes (x0, y0, dx, dy); a plain image is one pass over everything
+    static const int PASSES[7][4] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+                                      { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+    static const int PLAIN[1][4] = { { 0, 0, 1, 1 } };
+    const int (*passes)[4] = interlace ? PASSES : PLAIN;
+    int passCount = interlace ? 7 : 1;
+    size_t pos = 0;
+    for (int p = 0; p < passCount; p++) {
+        int x0 = passes[p][0], y0 = passes[p][1], dx = passes[p][2], dy = passes[p][3];
+        int pw = (width - x0 + dx - 1) / dx, ph = (height - y0 + dy - 1) / dy;
+        if (pw <= 0 || ph <= 0) continue;
+        size_t stride = ((size_t)pw * f.channels * f.depth + 7) / 8;
+        zeros.assign(stride, 0);
+        const uint8_t* prior = zeros.data();
+        for (int y = 0; y < ph; y++) {
+            if (pos + 1 + stride > scratch.size()) return Fail(error, "image data too short");
+            uint8_t* row = scratch.data() + pos + 1;
+            if (!Unfilter(scratch[pos], row, prior, stride, bpp)) return Fail(error, "bad filter");
+            uint32_t* dst = out.pixels.data() + (size_t)(y0 + y * dy) * width + x0;
+            if (!f.Convert(row, pw, dst, dx)) return Fail(error, "palette index out of range");
+            prior = row;
+            pos += 1 + stride;
+        }
+    }
+    return true;
+}
+
+// --- ENCODE ---
+inline void PutChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* body, size_t len) {
+    for (int s = 24; s >= 0; s -= 8) out.push_back((uint8_t)(len >> s));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (len) out.insert(out.end(), body, body + len);
+    uint32_t crc = Crc32(out.data() + start, len + 4);
+    for (int s = 24; s >= 0; s -= 8) out.push_back((uint8_t)(crc >> s));
+}
+
+// 8-bit indexed PNG. 'palette' is straight BGRA; alpha below 255 goes to tRNS.
+// 'scratch' keeps the filtered rows' allocation between calls.
+inline void EncodeIndexed(const uint8_t* indices, int width, int height, const uint32_t* palette, int paletteSize,
+                          std::vector<uint8_t>& out, std::vector<uint8_t>& scratch) {
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.assign(SIGNATURE, SIGNATURE + 8);
+
+    uint8_t ihdr[13] = { 0 };
+    for (int s = 0; s < 4; s++) {
+        ihdr[s] = (uint8_t)(width >> (24 - 8 * s));
+        ihdr[4 + s] = (uint8_t)(height >> (24 - 8 * s));
+    }
+    ihdr[8] = 8;
+    ihdr[9] = 3;
+    PutChunk(out, "IHDR", ihdr, 13);
+
+    uint8_t plte[768], trns[256];
+    int alphaCount = 0;
+    for (int i = 0; i < paletteSize; i++) {
+        plte[i * 3] = (uint8_t)(palette[i] >> 16);
+        plte[i * 3 + 1] = (uint8_t)(palette[i] >> 8);
+        plte[i * 3 + 2] = (uint8_t)palette[i];
+        trns[i] = (uint8_t)(palette[i] >> 24);
+        if (trns[i] != 255) alphaCount = i + 1;     // Trailing opaque entries can be left out
+    }
+    PutChunk(out, "PLTE", plte, (size_t)paletteSize * 3);
+    if (alphaCount) PutChunk(out, "tRNS", trns, (size_t)alphaCount);
+
+    // Filter type 0 on every row: prediction only hurts palette indices
+    scratch.resize((size_t)(width + 1) * height);
+    for (int y = 0; y < height; y++) {
+        scratch[(size_t)y * (width + 1)] = 0;
+        memcpy(&scratch[(size_t)y * (width + 1) + 1], indices + (size_t)y * width, (size_t)width);
+    }
+    std::vector<uint8_t> z;
+    Deflater().Compress(scratch.data(), scratch.size(), z);
+    PutChunk(out, "IDAT", z.data(), z.size());
+    PutChunk(out, "IEND", nullptr, 0);
+}
+
+} // namespace Png
@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+// ==========================================
+//              TICK PROFILER
+// ==========================================
+// Timestamps every tick stage into a fixed-size lock-free ring and a per-stage
+// log-scale histogram. Recording is a couple of atomic stores; all formatting
+// (summaries, Chrome trace JSON) happens later, off the tick.
+
+enum ProfileStage {
+    STAGE_ENUMERATE, STAGE_PHYSICS, STAGE_AI, STAGE_TITLE, STAGE_COMPOSE, STAGE_PRESENT,
+    STAGE_HANDOFF,      // Frame published by the simulation -> picked up by the renderer
+    STAGE_COUNT
+};
+
+inline const char* GetStageName(ProfileStage s) {
+    switch (s) {
+        case STAGE_ENUMERATE: return "Enumerate";
+        case STAGE_PHYSICS: return "Physics";
+        case STAGE_AI: return "AI";
+        case STAGE_TITLE: return "Title";
+        case STAGE_COMPOSE: return "Compose";
+        case STAGE_PRESENT: return "Present";
+        case STAGE_HANDOFF: return "Handoff";
+        default: return "Unknown";
+    }
+}
+
+class Profiler {
+public:
+    // ringSize must be a power of two; 0 keeps histograms only (no trace)
+    explicit Profiler(size_t ringSize = 0) : ring(ringSize), mask(ringSize ? ringSize - 1 : 0) {
+        origin = Clock::now();
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            maxNs[s] = 0;
+            for (int b = 0; b < BUCKETS; b++) buckets[s][b] = 0;
+        }
+    }
+
+    uint64_t NowNs() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+    }
+
+    void Record(ProfileStage stage, uint64_t startNs, uint64_t durNs) {
+        buckets[stage][Bucket(durNs)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t prevMax = maxNs[stage].load(std::memory_order_relaxed);
+        while (durNs > prevMax && !maxNs[stage].compare_exchange_weak(prevMax, durNs, std::memory_order_relaxed)) {}
+
+        if (ring.empty()) return;
+        uint64_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+        Event& e = ring[index & mask];
+        // Seqlock: the fence keeps the field stores after "being rewritten"
+        e.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        e.stage.store((uint32_t)stage, std::memory_order_relaxed);
+        e.thread.store(ThreadSlot(), std::memory_order_relaxed);
+        e.startNs.store(startNs, std::memory_order_relaxed);
+        e.durNs.store(durNs, std::memory_order_relaxed);
+        e.seq.store(index + 1, std::memory_order_release);
+    }
+
+    // Percentile from the histogram (upper edge of the bucket it falls in)
+    uint64_t PercentileNs(ProfileStage stage, double pct) const {
+        uint64_t total = 0;
+        for (int b = 0; b < BUCKETS; b++) total += buckets[stage][b].load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t want = (uint64_t)(total * pct / 100.0);
+        if (want >= total) want = total - 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += buckets[stage][b].load(std::memory_order_relaxed);
+            if (seen > want) return std::min(BucketUpper(b), maxNs[stage].load(std::memory_order_relaxed));
+        }
+        return maxNs[stage].load(std::memory_order_relaxed);
+    }
+
+    uint64_t MaxNs(ProfileStage stage) const { return maxNs[stage].load(std::memory_order_relaxed); }
+
+    std::wstring Summary() const {
+        std::wstringstream ss;
+        ss << L"[PROFILE] p50/p99/max us:";
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            ProfileStage st = (ProfileStage)s;
+            if (MaxNs(st) == 0) continue;
+            ss << L" " << GetStageName(st) << L"=" << PercentileNs(st, 50) / 1000.0 << L"/"
+               << PercentileNs(st, 99) / 1000.0 << L"/" << MaxNs(st) / 1000.0;
+        }
+        ss << L"\n";
+        return ss.str();
+    }
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto) of whatever the ring still holds
+    bool WriteChromeTrace(const char* path) const {
+        FILE* f = fopen(path, "w");
+        if (!f) return false;
+        fprintf(f, "{\"traceEvents\":[\n");
+        uint64_t end = writeIndex.load(std::memory_order_acquire);
+        uint64_t begin = end > ring.size() ? end - ring.size() : 0;
+        bool first = true;
+        for (uint64_t i = begin; i < end; i++) {
+            const Event& e = ring[i & mask];
+            if (e.seq.load(std::memory_order_acquire) != i + 1) continue; // Not written yet or overwritten
+            uint32_t stage = e.stage.load(std::memory_order_relaxed), thread = e.thread.load(std::memory_order_relaxed);
+            uint64_t startNs = e.startNs.load(std::memory_order_relaxed), durNs = e.durNs.load(std::memory_order_relaxed);
+            // The fence keeps the field loads before the re-check
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (e.seq.load(std::memory_order_relaxed) != i + 1) continue; // Rewritten while we read it
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", GetStageName((ProfileStage)stage), thread,
+                    startNs / 1000.0, durNs / 1000.0);
+            first = false;
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+        return true;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Event {
+        std::atomic<uint64_t> seq{0};   // index + 1 once the slot is complete
+        // Relaxed atomics: a reader may race a rewrite, and throws such reads away
+        std::atomic<uint32_t> stage{0};
+        std::atomic<uint32_t> thread{0};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> durNs{0};
+    };
+
+    // 4 sub-buckets per power of two: ~19% resolution from 1 ns to ~18 minutes
+    static const int BUCKETS = 160;
+
+    static int Bucket(uint64_t ns) {
+        if (ns < 4) return (int)ns;
+        int log = 63 - LeadingZeros(ns);
+        int sub = (int)((ns >> (log - 2)) & 3);
+        int b = (log - 1) * 4 + sub;
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+    static uint64_t BucketUpper(int b) {
+        if (b < 4) return (uint64_t)b;
+        int log = b / 4 + 1;
+        int sub = b % 4;
+        return ((uint64_t)(4 + sub + 1) << (log - 2)) - 1;
+    }
+    static int LeadingZeros(uint64_t v) {
+        int n = 0;
+        while (!(v & 0x8000000000000000ull)) { v <<= 1; n++; }
+        return n;
+    }
+
+    // Small stable id per recording thread for the trace's tid column
+    static uint32_t ThreadSlot() {
+        static std::atomic<uint32_t> next{1};
+        thread_local uint32_t slot = next.fetch_add(1);
+        return slot;
+    }
+
+    std::vector<Event> ring;
+    size_t mask;
+    std::atomic<uint64_t> writeIndex{0};
+    std::atomic<uint64_t> buckets[STAGE_COUNT][BUCKETS];
+    std::atomic<uint64_t> maxNs[STAGE_COUNT];
+    Clock::time_point origin;
+};
+
+// Times the enclosing block; a null profiler costs one branch
+class ProfileScope {
+public:
+    ProfileScope(Profiler* p, ProfileStage s) : profiler(p), stage(s), start(p ? p->NowNs() : 0) {}
+    ~ProfileScope() { if (profiler) profiler->Record(stage, start, profiler->NowNs() - start); }
+
+private:
+    Profiler* profiler;
+    ProfileStage stage;
+    uint64_t start;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <map>
+#include <cstddef>
+
+// ==========================================
+//            RENDER BOOKKEEPING
+// ==========================================
+// Platform-neutral side of the render path: what identifies a composed frame
+// and the counters we use to check the steady state stays allocation-free.
+
+// A composed sprite only depends on these, so it is the cache key.
+// state == -1 is the "no art" fallback rectangle.
+struct FrameKey {
+    int state;
+    int frame;
+    bool facingRight;
+    int width, height;
+
+    bool operator<(const FrameKey& o) const {
+        if (state != o.state) return state < o.state;
+        if (frame != o.frame) return frame < o.frame;
+        if (facingRight != o.facingRight) return facingRight < o.facingRight;
+        if (width != o.width) return width < o.width;
+        return height < o.height;
+    }
+    bool operator==(const FrameKey& o) const {
+        return state == o.state && frame == o.frame && facingRight == o.facingRight &&
+               width == o.width && height == o.height;
+    }
+};
+
+struct RenderStats {
+    unsigned long long frames = 0;
+    unsigned long long cacheHits = 0;
+    unsigned long long allocations = 0;   // Surfaces built (each is one scaled sprite)
+    unsigned long long cachedBytes = 0;
+    unsigned long long dropped = 0;       // Surfaces freed because their sprite set was evicted
+    double totalMicros = 0;
+    double maxMicros = 0;
+
+    void AddFrame(double micros) {
+        frames++;
+        totalMicros += micros;
+        if (micros > maxMicros) maxMicros = micros;
+    }
+    double AvgMicros() const { return frames ? totalMicros / frames : 0; }
+};
+
+// Keyed surface store. The platform supplies the surface type and how to free it.
+// Nothing is dropped on its own: the owner charges each surface's bytes to the
+// sprite set it was scaled from and drops them when that set is evicted.
+template <typename Surface>
+class FrameCache {
+public:
+    RenderStats stats;
+
+    Surface* Find(const FrameKey& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return nullptr;
+        stats.cacheHits++;
+        return &it->second.surface;
+    }
+
+    Surface* Insert(const FrameKey& key, const Surface& surface, unsigned long long bytes) {
+        stats.allocations++;
+        stats.cachedBytes += bytes;
+        Entry& e = entries[key];
+        e.surface = surface;
+        e.bytes = bytes;
+        return &e.surface;
+    }
+
+    // Free every entry whose key 'match'es
+    template <typename MatchFn, typename ReleaseFn>
+    void Drop(MatchFn match, ReleaseFn release) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!match(it->first)) { ++it; continue; }
+            release(it->second.surface);
+            stats.cachedBytes -= it->second.bytes;
+            stats.dropped++;
+            it = entries.erase(it);
+        }
+    }
+
+    template <typename ReleaseFn>
+    void Clear(ReleaseFn release) {
+        for (auto& e : entries) release(e.second.surface);
+        entries.clear();
+        stats.cachedBytes = 0;
+    }
+
+    size_t Size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        Surface surface;
+        unsigned long long bytes = 0;
+    };
+    std::map<FrameKey, Entry> entries;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include "Config.h"
+#include "State.h"
+
+// ==========================================
+//           ADAPTIVE TICK SCHEDULER
+// ==========================================
+// Picks how long to sleep before the next tick. Moving states run at the full
+// TICK_RATE; resting states only wake for their next animation frame or AI
+// deadline (capped at TICK_RATE_REST), and any environment change forces full
+// rate for a while.
+
+class TickScheduler {
+public:
+    // Delay in ms until the next tick
+    int NextDelay(State state, unsigned long long now, unsigned long long nextFrameAt,
+                  unsigned long long nextAIAt = ~0ull) const {
+        if (now - lastEnvChange < (unsigned long long)Config::ENV_WAKE_GRACE_MS) return Config::TICK_RATE;
+        if (!IsResting(state)) return Config::TICK_RATE;
+
+        unsigned long long delay = Config::TICK_RATE_REST;
+        if (nextFrameAt > now && nextFrameAt - now < delay) delay = nextFrameAt - now;
+        if (nextAIAt > now && nextAIAt - now < delay) delay = nextAIAt - now;
+        if (delay < (unsigned long long)Config::TICK_RATE) delay = Config::TICK_RATE;
+        return (int)delay;
+    }
+
+    static bool IsResting(State state) {
+        return state == SITTING || state == SLEEPING || state == WATCHING_MOVIE;
+    }
+
+    void OnEnvironmentChanged(unsigned long long now) {
+        lastEnvChange = now;
+        envWakeups++;
+    }
+
+    // Call once per tick; time since the previous wakeup is charged to the state we slept in
+    void RecordWakeup(State state, unsigned long long now) {
+        if (lastWakeup != 0) timeIn[lastState] += now - lastWakeup;
+        wakeups[state]++;
+        lastWakeup = now;
+        lastState = state;
+    }
+
+    double WakeupsPerMinute(State state) const {
+        if (timeIn[state] == 0) return 0;
+        return (double)wakeups[state] * 60000.0 / (double)timeIn[state];
+    }
+
+    // One line per minute is plenty
+    bool ReportDue(unsigned long long now) {
+        if (now - lastReport < 60000) return false;
+        lastReport = now;
+        return true;
+    }
+
+    std::wstring Report() const {
+        std::wstringstream ss;
+        ss << L"[SCHED] wakeups/min:";
+        for (int s = 0; s < STATE_COUNT; s++) {
+            if (timeIn[s] == 0) continue;
+            ss << L" " << GetStateName((State)s) << L"=" << (int)WakeupsPerMinute((State)s);
+        }
+        ss << L" | env wakeups " << envWakeups << L"\n";
+        return ss.str();
+    }
+
+    unsigned long long envWakeups = 0;
+
+private:
+    unsigned long long lastEnvChange = 0;
+    unsigned long long lastWakeup = 0;
+    unsigned long long lastReport = 0;
+    State lastState = IDLE;
+    unsigned long long wakeups[STATE_COUNT] = { 0 };
+    unsigned long long timeIn[STATE_COUNT] = { 0 };
+};
@@ -0,0 +1,850 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include "Config.h"
+#include "State.h"
+#include "Environment.h"
+#include "WindowCache.h"
+#include "WindowTracker.h"
+#include "SpatialIndex.h"
+#include "WindowTable.h"
+#include "WalkableMap.h"
+#include "Motion.h"
+#include "LedgeGraph.h"
+#include "TitleMatcher.h"
+#include "TimerWheel.h"
+#include "Profiler.h"
+
+// ==========================================
+//           HEADLESS SIMULATION CORE
+// ==========================================
+// Everything in here is platform-neutral: time, randomness and the desktop
+// layout are injected, so the same physics/AI runs under Win32 or headless.
+
+typedef void (*LogFn)(const std::wstring& msg);
+
+// --- CLOCK ---
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual unsigned long long Now() = 0; // milliseconds
+};
+
+// Headless clock: time only moves when told to.
+class ManualClock : public Clock {
+public:
+    unsigned long long time = 0;
+    unsigned long long Now() override { return time; }
+    void Advance(unsigned long long ms) { time += ms; }
+};
+
+// --- RANDOM ---
+// Seeded xorshift64* so a run is reproducible from its seed (replaces rand()).
+class Random {
+public:
+    explicit Random(unsigned long long seed = 1) { Seed(seed); }
+
+    void Seed(unsigned long long seed) {
+        // SplitMix64 scramble so small/adjacent seeds still diverge
+        unsigned long long z = seed + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state = z ^ (z >> 31);
+        if (state == 0) state = 0x9E3779B97F4A7C15ull;
+    }
+
+    unsigned int Next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (unsigned int)((state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+
+    // Uniform-ish integer in [0, n), same usage as rand() % n
+    int Next(int n) { return (int)(Next() % (unsigned int)n); }
+
+    // How many Next(outOf) < chance rolls it takes to hit (1, 2, ...): the
+    // geometric distribution, drawn in one go by inverting its CDF
+    unsigned long long Trials(int chance, int outOf) {
+        if (chance >= outOf) return 1;
+        if (chance <= 0) return MAX_TRIALS;
+        double u = ((double)Next() + 1.0) / 4294967296.0;     // (0, 1]
+        double k = std::floor(std::log(u) / std::log1p(-(double)chance / outOf));
+        return k >= (double)(MAX_TRIALS - 1) ? MAX_TRIALS : 1 + (unsigned long long)k;
+    }
+
+    static const unsigned long long MAX_TRIALS = 1ull << 32;
+
+private:
+    unsigned long long state;
+};
+
+// ==========================================
+//                WALKER
+// ==========================================
+// One character as the physics and AI rules see it. The Simulation's buddy is
+// one; a Swarm keeps thousands column-wise and runs the same rules (WALKER
+// RULES, below the Simulation) on each.
+struct Walker {
+    static const unsigned long long NEVER = ~0ull;
+
+    State currentState = FALLING;
+    int currentFrameIndex = 0;
+    unsigned long long lastFrameTime = 0;
+    unsigned long long lastStateChangeTime = 0;
+
+    int posX = 0, posY = 0;
+    int velY = 0;
+    bool facingRight = true;
+    int targetX = 0, targetY = 0;
+    int supportSpan = -1;                       // walkable.spans id under the feet (ground check), -1 on a floor
+    WindowId carryWindow = 0;                   // Window the feet are attached to, 0 on a floor or in the air
+
+    // Falls and leaps are closed-form in the time since they started (Motion.h)
+    bool moveStarted = false;
+    unsigned long long moveStartTime = 0;
+    int moveX = 0, moveY = 0, moveVel = 0;
+    long long walkRemainder = 0;
+
+    // Where the carrying window's top-left (and width) was when last applied
+    int carryIndex = -1;
+    long carryLeft = 0, carryTop = 0, carryWidth = 0;
+
+    // Behaviour deadlines for the current state, drawn on entering it (NEVER: none)
+    unsigned long long behaviourAt = NEVER, jumpAt = NEVER;
+    const wchar_t* reason = L"";                // Why the state last changed, for the log
+
+    void StartMove(unsigned long long now) {
+        moveStarted = true;
+        moveStartTime = now;
+        moveX = posX;
+        moveY = posY;
+        moveVel = velY;
+    }
+};
+
+// ==========================================
+//              SIMULATION
+// ==========================================
+class Simulation : public Walker {
+public:
+    int velX = 0;
+
+    // --- ENVIRONMENT SNAPSHOT ---
+    std::vector<RectArea> monitors;
+    std::vector<RectArea> windowRects;
+    WindowCache windowCache;                    // Feed OnWindowEvent() from the platform
+    WindowTracker windowTracker;                // Ids and motion per window, updated on every enumeration
+    SpatialIndex windowIndex;                   // Rebuilt from windowRects on generation change
+    WindowTable windowTable;                    // Same, column-wise for batched probes (Swarm)
+    WalkableMap walkable;                       // Rebuilt from windowRects on generation change
+    LedgeGraph ledgeGraph;                      // Patched from windowRects on generation change
+    LedgePlanner planner;
+
+    // Multi-hop travel target (a point on the goal ledge; ids change with the graph)
+    bool hasRoute = false;
+    int routeX = 0, routeY = 0;
+
+    unsigned long long tickCount = 0;
+    unsigned long long groundChecksSkipped = 0;
+    unsigned long long titleChecks = 0;
+    unsigned long long aiWakeups = 0;           // Ticks on which a behaviour deadline fired
+    unsigned long long carriedTicks = 0;        // Ticks moved along with the window underneath
+    unsigned long long predictedTicks = 0;      // ...of those, moved by its velocity between enumerations
+
+    Simulation(Clock& clock, EnvironmentProvider& env, unsigned long long seed = 1)
+        : clock(clock), env(env), rng(seed) {
+        for (int i = 0; i < STATE_COUNT; i++) { animFrames[i] = 0; animSpeed[i] = 0; }
+        titleMatcher.Build(DefaultTitleRules());
+    }
+
+    void Seed(unsigned long long seed) { rng.Seed(seed); }
+    void SetRoute(int x, int y) { hasRoute = true; routeX = x; routeY = y; }
+    void SetTitleRules(const std::vector<TitleRule>& rules) { titleMatcher.Build(rules); titleDirty = true; }
+    void OnTitleChanged() { titleDirty = true; }
+    void ClearRoute() { hasRoute = false; }
+    void SetLogger(LogFn fn) { logger = fn; }
+    void SetProfiler(Profiler* p) { profiler = p; }
+
+    // Frame count / speed per state, so frame stepping stays in the simulation
+    void SetAnimation(State state, int frameCount, int msPerFrame) {
+        animFrames[state] = frameCount;
+        animSpeed[state] = msPerFrame;
+    }
+    int GetFrameCount(State state) const { return animFrames[state]; }
+
+    void UpdateEnvironment();
+    void PlaceOnFirstMonitor();
+    void Tick();
+
+    // When the current animation next wants a new frame (~0ull if it never will)
+    unsigned long long NextFrameDeadline() const;
+    // When the AI next has something to decide (~0ull if nothing is scheduled)
+    unsigned long long NextAIDeadline() const { return aiTimers.NextDeadline(); }
+
+    void RefreshSnapshot();
+    void UpdatePhysics();
+    void UpdateAI();
+    void UpdateAnimation();
+    void ChangeState(State newState, const std::wstring& reason);
+
+    bool IsInAnyMonitor(int x, int y) const;
+    bool IsOnFloor(int x, int y) const;
+    bool IsPointObscured(int x, int y, int ignoreBelowIndex) const;
+    int ScreenHeight() const;
+    void GetSmartSize(int origW, int origH, int& outW, int& outH) const;
+    static void SmartSize(int screenH, int origW, int origH, int& outW, int& outH);
+
+private:
+    Clock& clock;
+    EnvironmentProvider& env;
+    Random rng;
+    LogFn logger = nullptr;
+    Profiler* profiler = nullptr;
+
+    // The walker's behaviour deadlines, on a wheel so the scheduler can ask
+    // for the next one
+    enum { AI_BEHAVIOUR, AI_JUMP_CHECK };
+    TimerWheel aiTimers;
+    bool aiTimersStarted = false;
+    int behaviourTimer = -1;
+    int jumpTimer = -1;
+    unsigned long long behaviourTimerAt = NEVER, jumpTimerAt = NEVER;
+
+    unsigned long long lastPhysicsTime = 0;
+    std::vector<WindowId> platformIds;
+    unsigned long long trackedEnumerations = 0;
+
+    TitleMatcher titleMatcher;
+    bool titleDirty = true;
+    unsigned long long lastTitleCheck = 0;
+    int activityRule = -1;      // Rule matching the current foreground title
+    bool inActivity = false;    // Current state came from a title rule
+
+    int animFrames[STATE_COUNT];
+    int animSpeed[STATE_COUNT];
+
+    // Last ground result; still valid while snapshot, position and state are unchanged
+    bool groundValid = false;
+    unsigned long long groundGeneration = 0;
+    int groundX = 0, groundY = 0;
+    State groundState = IDLE;
+
+    void Log(const std::wstring& msg) { if (logger) logger(msg); }
+    void UpdateActivity(unsigned long long now);
+    void JumpCheck(unsigned long long now);
+    void Applied(State before);
+    void SyncTimers(bool entered);
+    void SyncTimer(int& timer, unsigned long long& scheduledAt, unsigned long long at, int tag);
+};
+
+// ==========================================
+//              WALKER RULES
+// ==========================================
+// Physics and AI for one walker against a Simulation's snapshot, shared by the
+// Simulation's own character and every Swarm walker. Nothing here logs or
+// allocates: state changes go through EnterState, which records why and draws
+// the new state's behaviour deadlines, and the caller does what else it keeps
+// (the log, a timer wheel, caches, routes, title rules).
+
+// Every exit used to be a dice roll on each TICK_RATE tick once MIN_STATE_TIME
+// had passed (PREPARE_JUMP: from the next tick, no gate). Instead, how many
+// rolls it would have taken is drawn once on entering the state (same
+// distribution, see Random::Trials), and the AI only acts when that deadline
+// or the IDLE jump check comes due.
+inline void DrawJumpCheck(Walker& w, Random& rng, unsigned long long firstRoll) {
+    w.jumpAt = firstRoll + (rng.Trials(Config::CHANCE_CHECK_JUMP, 10000) - 1) * Config::TICK_RATE;
+}
+
+inline void DrawBehaviour(Walker& w, Random& rng, unsigned long long now) {
+    w.behaviourAt = w.jumpAt = Walker::NEVER;
+    const unsigned long long tick = Config::TICK_RATE;
+    unsigned long long firstRoll = now + Config::MIN_STATE_TIME;
+    switch (w.currentState) {
+        case PREPARE_JUMP:
+            w.behaviourAt = now + rng.Trials(1, 15) * tick;
+            break;
+        case IDLE:
+            // Walk, sit and sleep share one roll; which one it was is picked when it fires
+            w.behaviourAt = firstRoll + (rng.Trials(Config::THRESH_IDLE_TO_SLEEP, 10000) - 1) * tick;
+            DrawJumpCheck(w, rng, firstRoll);
+            break;
+        case WALKING:
+            w.behaviourAt = firstRoll + (rng.Trials(Config::CHANCE_STOP_WALKING, 10000) - 1) * tick;
+            break;
+        case SITTING:
+            w.behaviourAt = firstRoll + (rng.Trials(Config::CHANCE_STAND_UP, 10000) - 1) * tick;
+            break;
+        case SLEEPING:
+            w.behaviourAt = firstRoll + (rng.Trials(Config::CHANCE_WAKE_UP, 10000) - 1) * tick;
+            break;
+        default:
+            break;  // Falls and leaps end in physics, activities with their title
+    }
+}
+
+inline void EnterState(Walker& w, Random& rng, State s, unsigned long long now, const wchar_t* reason) {
+    if (w.currentState == s) return;
+    w.currentState = s;
+    w.reason = reason;
+    w.lastStateChangeTime = now;
+    w.currentFrameIndex = 0;
+    w.lastFrameTime = now;
+    w.moveStarted = false;
+    if (s == FALLING || s == LEAPING) {
+        w.StartMove(now);
+        w.carryWindow = 0;
+    }
+    DrawBehaviour(w, rng, now);
+}
+
+// Stand on window i from now on (-1: a floor, or nothing)
+inline void AttachWalker(Walker& w, const Simulation& world, int windowIndex) {
+    if (windowIndex == -1) {
+        w.carryWindow = 0;
+        return;
+    }
+    const RectArea& r = world.windowRects[windowIndex];
+    w.carryWindow = world.windowTracker.ids[windowIndex];
+    w.carryIndex = windowIndex;
+    w.carryLeft = r.left;
+    w.carryTop = r.top;
+    w.carryWidth = r.right - r.left;
+}
+
+// Apply how far the carrying window moved since it was last applied. O(1):
+// the window is found by id at its last index (or through the id table).
+// Returns true if the position is a prediction rather than enumerated;
+// 'moved' says whether it moved at all.
+inline bool CarryWalker(Walker& w, const Simulation& world, unsigned long long now, bool& moved) {
+    moved = false;
+    if (!w.carryWindow) return false;
+    w.carryIndex = world.windowTracker.IndexOf(w.carryWindow, w.carryIndex);
+    if (w.carryIndex == -1) {
+        w.carryWindow = 0;
+        return false;
+    }
+    long left, top;
+    bool predicted = world.windowTracker.Predict(w.carryIndex, now, left, top);
+    const RectArea& r = world.windowRects[w.carryIndex];
+    long width = r.right - r.left;
+    if (left == w.carryLeft && top == w.carryTop) return predicted;
+    // A resize from the left edge moves 'left' without moving what we stand on
+    if (width == w.carryWidth) w.posX += (int)(left - w.carryLeft);
+    w.posY += (int)(top - w.carryTop);
+    w.carryLeft = left;
+    w.carryTop = top;
+    w.carryWidth = width;
+    moved = true;
+    return predicted;
+}
+
+// Falls, leaps and the wind-up before one. False if the walker is on the
+// ground, which is the caller's to do next (carry, support, GroundStep).
+inline bool MoveInAir(Walker& w, Random& rng, const Simulation& world, unsigned long long now) {
+    if (w.currentState != WALKING) w.walkRemainder = 0;
+    // Falling from the start, without an EnterState to mark when it began
+    if ((w.currentState == FALLING || w.currentState == LEAPING) && !w.moveStarted) w.StartMove(now);
+
+    if (w.currentState == FALLING) {
+        int prevY = w.posY;
+        unsigned long long t = now - w.moveStartTime;
+        w.posY = w.moveY + (int)(Motion::FallOffset(w.moveVel, t) / Motion::SUBPIXEL);
+        w.velY = Motion::FallSpeed(w.moveVel, t);
+
+        if (w.velY > 0) {
+            // Swept: the first top the feet met between the last tick and this one,
+            // however far that was (from 15px above, for windows that rose into us;
+            // 10px in from the window sides)
+            const WalkableMap& walkable = world.walkable;
+            int land = walkable.FirstSupport(w.posX, prevY - 15, w.posY, 10);
+            long landY = (land != -1) ? walkable.spans[land].y : LONG_MAX;
+            // Floors count too, and a floor crossed before that top wins
+            bool onFloor = false;
+            for (const auto& mon : world.monitors) {
+                if (w.posX >= mon.left && w.posX <= mon.right && w.posY >= mon.bottom && mon.bottom < landY) {
+                    landY = mon.bottom;
+                    onFloor = true;
+                }
+            }
+            if (landY != LONG_MAX) {
+                w.posY = (int)landY;
+                w.velY = 0;
+                EnterState(w, rng, IDLE, now, onFloor ? L"Landed Floor" : L"Landed Window");
+            }
+        }
+        return true;
+    }
+    if (w.currentState == LEAPING) {
+        long long ox, oy;
+        if (Motion::LeapOffset(w.targetX - w.moveX, w.targetY - w.moveY, now - w.moveStartTime, ox, oy)) {
+            w.posX = w.targetX;
+            w.posY = w.targetY;
+            EnterState(w, rng, IDLE, now, L"Jump Arrived");
+        } else {
+            w.posX = w.moveX + (int)(ox / Motion::SUBPIXEL);
+            w.posY = w.moveY + (int)(oy / Motion::SUBPIXEL);
+        }
+        return true;
+    }
+    return w.currentState == PREPARE_JUMP;
+}
+
+// What is under the feet after FindSupport
+struct GroundContact {
+    bool supported = false;
+    bool onFloor = false;
+    int windowIndex = -1;   // Window stood on: the head check ignores it and everything below
+};
+
+// 1. ELEVATOR CHECK (Windows moving UP into feet)
+// Check this BEFORE current support, so rising windows override falling/current pos.
+// If window top is near feet, OR slightly above (meaning it moved up past us)
+// We check a range: Feet-5 (it rose) to Feet+15 (we fell/it fell)
+// Only visible stretches of a top count, so nothing ABOVE it hides the elevator.
+// A window whose position is 'predicted' (CarryWalker) is the support until
+// its next enumeration.
+// 2. Floor Check (If no window caught us)
+// Afterwards the head probe is (posX, posY - 20), ignoring c.windowIndex and below.
+inline void FindSupport(Walker& w, const Simulation& world, bool predicted, GroundContact& c) {
+    const WalkableMap& walkable = world.walkable;
+    c = GroundContact();
+    if (predicted) {
+        w.supportSpan = -1;
+        c.supported = true;
+        c.windowIndex = w.carryIndex;
+    } else {
+        w.supportSpan = walkable.WindowSupport(w.posX, w.posY - 15, w.posY + 5);
+        if (w.supportSpan != -1) {
+            w.posY = walkable.spans[w.supportSpan].y; // SNAP
+            c.supported = true;
+            c.windowIndex = walkable.spans[w.supportSpan].windowIndex;
+        }
+        AttachWalker(w, world, c.windowIndex);
+    }
+    if (!c.supported) {
+        for (const auto& f : walkable.floors) {
+            if (w.posX >= f.left && w.posX <= f.right && std::abs(w.posY - f.y) < 10) {
+                c.supported = true;
+                c.onFloor = true;
+                w.posY = f.y;
+                break;
+            }
+        }
+    }
+}
+
+// 3. Occlusion: 'covered' is the head probe's answer. Then walk.
+inline void GroundStep(Walker& w, Random& rng, const Simulation& world, const GroundContact& c, bool covered,
+                       unsigned long long now, unsigned long long dt) {
+    bool supported = c.supported;
+    if (supported && covered) {
+        // If we are sleeping, we wake up.
+        if (w.currentState == SLEEPING || w.currentState == WATCHING_MOVIE) {
+            EnterState(w, rng, IDLE, now, L"Woke by Occlusion");
+            if (rng.Next(2) == 0) w.posX += 10; else w.posX -= 10;
+        }
+        // If we are just standing/walking, we get pushed off.
+        // UNLESS we are on the floor (Taskbar). You can't fall off the floor.
+        else if (!c.onFloor) {
+            supported = false; // Push off ledge
+        }
+    }
+
+    if (!supported) {
+        EnterState(w, rng, FALLING, now, L"No Support");
+        return;
+    }
+
+    if (w.currentState == WALKING) {
+        const WalkableMap& walkable = world.walkable;
+        int step = Motion::WalkStep(Config::WALK_SPEED, dt, w.walkRemainder);
+        int nextX = w.facingRight ? (w.posX + step) : (w.posX - step);
+
+        // Just walk. Only stop for monitor edges.
+        if (world.IsInAnyMonitor(nextX, w.posY - 10)) {
+            // Follow this ledge, and whatever carries on from it at the same
+            // height, up to nextX. At the first pixel with nothing underneath,
+            // step off there and fall, however long the step was.
+            bool offLedge = false;
+            for (int span = w.supportSpan; span != -1; ) {
+                const WalkSpan& s = walkable.spans[span];
+                if (nextX >= s.left && nextX <= s.right) break;
+                int edge = w.facingRight ? (int)s.right + 1 : (int)s.left - 1;
+                if (world.IsOnFloor(edge, w.posY)) break;
+                span = walkable.WindowSupport(edge, w.posY - 15, w.posY + 5);
+                if (span == -1) {
+                    nextX = edge;
+                    offLedge = true;
+                }
+            }
+            w.posX = nextX;
+            if (offLedge) EnterState(w, rng, FALLING, now, L"Walked Off Ledge");
+        } else {
+            EnterState(w, rng, IDLE, now, L"Screen Edge");
+        }
+    }
+}
+
+// One hop off ledge 'here' (-1: none) to a ledge in range, up with
+// JUMP_UP_BIAS odds if there is one. Counts the up/down candidates, then
+// walks the edge list again to the chosen one, so nothing is allocated.
+inline void PickJump(Walker& w, Random& rng, const LedgeGraph& g, int here, unsigned long long now) {
+    auto inRange = [&](int t) {
+        const Ledge& l = g.ledges[t];
+        double dx = l.AnchorX() - w.posX, dy = (double)l.y - w.posY;
+        return std::sqrt(dx * dx + dy * dy) <= g.MaxRange();
+    };
+    int up = 0, down = 0;
+    if (here != -1) {
+        for (int t : g.edges[here]) {
+            if (!inRange(t)) continue;
+            if ((int)g.ledges[t].y < w.posY) up++; else down++;
+        }
+    }
+    bool preferUp = (rng.Next(100) < Config::JUMP_UP_BIAS);
+    bool useUp;
+    if (preferUp && up) useUp = true;
+    else if (down) useUp = false;
+    else if (up) useUp = true;
+    else return;
+
+    int pick = rng.Next(useUp ? up : down);
+    for (int t : g.edges[here]) {
+        if (!inRange(t)) continue;
+        if (((int)g.ledges[t].y < w.posY) != useUp) continue;
+        if (pick-- == 0) {
+            w.targetX = g.ledges[t].AnchorX();
+            w.targetY = (int)g.ledges[t].y;
+            EnterState(w, rng, PREPARE_JUMP, now, L"Ledge Found");
+            return;
+        }
+    }
+}
+
+// Act on the deadlines that came due ('jump' looks for a jump from IDLE and
+// may EnterState PREPARE_JUMP). Returns false while the state can't be left
+// by choice: in the air, winding up a jump, or inside MIN_STATE_TIME.
+template <typename JumpFn>
+inline bool WalkerAI(Walker& w, Random& rng, unsigned long long now, bool behaviourDue, bool jumpDue, JumpFn jump) {
+    if (w.currentState == FALLING || w.currentState == LEAPING) return false;
+
+    if (w.currentState == PREPARE_JUMP) {
+        if (behaviourDue) {
+            w.facingRight = (w.targetX > w.posX);
+            EnterState(w, rng, LEAPING, now, L"Launch");
+        }
+        return false;
+    }
+
+    if (now - w.lastStateChangeTime < Config::MIN_STATE_TIME) return false;
+
+    if (w.currentState == IDLE) {
+        if (behaviourDue) {
+            int r = rng.Next(Config::THRESH_IDLE_TO_SLEEP);
+            if (r < Config::THRESH_IDLE_TO_WALK) {
+                w.facingRight = (rng.Next(2) == 0);
+                EnterState(w, rng, WALKING, now, L"AI Walk");
+            }
+            else if (r < Config::THRESH_IDLE_TO_SIT) EnterState(w, rng, SITTING, now, L"AI Sit");
+            else EnterState(w, rng, SLEEPING, now, L"AI Sleep");
+        }
+        else if (jumpDue) {
+            jump();
+            // Nowhere to go: the next check is rolled from the next tick on
+            if (w.currentState == IDLE) DrawJumpCheck(w, rng, now + Config::TICK_RATE);
+        }
+    }
+    else if (behaviourDue) {
+        if (w.currentState == WALKING) EnterState(w, rng, IDLE, now, L"Stop Walk");
+        else if (w.currentState == SITTING) EnterState(w, rng, IDLE, now, L"Stand Up");
+        else if (w.currentState == SLEEPING) EnterState(w, rng, IDLE, now, L"Wake Up");
+    }
+    return true;
+}
+
+inline void AnimateWalker(Walker& w, int frames, int msPerFrame, unsigned long long now) {
+    if (frames <= 0) return; // Renderer falls back to IDLE frame 0
+    if (w.currentFrameIndex >= frames) w.currentFrameIndex = 0;
+    if (now - w.lastFrameTime > (unsigned long long)msPerFrame) {
+        w.currentFrameIndex = (w.currentFrameIndex + 1) % frames;
+        w.lastFrameTime = now;
+    }
+}
+
+// --- STATE MANAGER ---
+inline void Simulation::ChangeState(State newState, const std::wstring& reason) {
+    if (currentState == newState) return;
+
+    if (logger) {
+        Log(L"[STATE] " + GetStateName(currentState) + L" -> " + GetStateName(newState) + L" (" + reason + L")\n");
+    }
+    EnterState(*this, rng, newState, clock.Now(), L"");
+    SyncTimers(true);
+}
+
+// A walker rule ran: log the state change it made, if any, and move the AI
+// timers to the walker's deadlines
+inline void Simulation::Applied(State before) {
+    bool entered = currentState != before;
+    if (entered && logger) {
+        Log(L"[STATE] " + GetStateName(before) + L" -> " + GetStateName(currentState) + L" (" + reason + L")\n");
+    }
+    SyncTimers(entered);
+}
+
+inline void Simulation::SyncTimers(bool entered) {
+    if (entered && !aiTimersStarted) {
+        aiTimers.Reset(lastStateChangeTime);
+        aiTimersStarted = true;
+    }
+    SyncTimer(behaviourTimer, behaviourTimerAt, behaviourAt, AI_BEHAVIOUR);
+    SyncTimer(jumpTimer, jumpTimerAt, jumpAt, AI_JUMP_CHECK);
+}
+
+inline void Simulation::SyncTimer(int& timer, unsigned long long& scheduledAt, unsigned long long at, int tag) {
+    if (timer != -1 ? scheduledAt == at : at == NEVER) return;
+    aiTimers.Cancel(timer);
+    timer = at == NEVER ? -1 : aiTimers.Schedule(at, tag);
+    scheduledAt = at;
+}
+
+// --- ENVIRONMENT ---
+inline void Simulation::UpdateEnvironment() {
+    env.GetMonitors(monitors);
+    walkable.Build(windowRects, monitors, windowCache.generation);
+    ledgeGraph.Update(windowRects, monitors, walkable);
+    windowCache.Invalidate();
+    groundValid = false;
+}
+
+inline void Simulation::PlaceOnFirstMonitor() {
+    if (!monitors.empty()) {
+        posX = (monitors[0].left + monitors[0].right) / 2;
+        posY = monitors[0].bottom;
+        moveStarted = false;
+        carryWindow = 0;
+    }
+}
+
+inline void Simulation::Tick() {
+    tickCount++;
+
+    {
+        ProfileScope scope(profiler, STAGE_ENUMERATE);
+        RefreshSnapshot();
+    }
+    {
+        ProfileScope scope(profiler, STAGE_PHYSICS);
+        UpdatePhysics();
+    }
+    {
+        ProfileScope scope(profiler, STAGE_AI);
+        UpdateAI();
+    }
+    UpdateAnimation();
+}
+
+inline unsigned long long Simulation::NextFrameDeadline() const {
+    int frames = animFrames[currentState];
+    if (frames <= 1) return ~0ull;
+    // UpdateAnimation flips once strictly more than msPerFrame has passed
+    return lastFrameTime + animSpeed[currentState] + 1;
+}
+
+inline bool Simulation::IsInAnyMonitor(int x, int y) const {
+    for (const auto& mon : monitors) {
+        if (x >= mon.left && x <= mon.right && y >= mon.top && y <= mon.bottom) return true;
+    }
+    return false;
+}
+
+// Within the floor check's reach of a monitor floor
+inline bool Simulation::IsOnFloor(int x, int y) const {
+    for (const auto& f : walkable.floors) {
+        if (x >= f.left && x <= f.right && std::abs(y - f.y) < 10) return true;
+    }
+    return false;
+}
+
+// Z-ORDER CHECK:
+// Window list is sorted Top-to-Bottom (0 is top).
+// We check if any window with index < 'ignoreBelowIndex' covers the point.
+// The grid hands back the topmost window at the point, so this is one cell lookup.
+inline bool Simulation::IsPointObscured(int x, int y, int ignoreBelowIndex) const {
+    return windowIndex.IsCoveredAbove(x, y, ignoreBelowIndex);
+}
+
+inline int Simulation::ScreenHeight() const {
+    if (monitors.empty()) return 1080;
+    return monitors[0].bottom - monitors[0].top;
+}
+
+inline void Simulation::GetSmartSize(int origW, int origH, int& outW, int& outH) const {
+    SmartSize(ScreenHeight(), origW, origH, outW, outH);
+}
+
+// Sprite size for a given screen height; static so the render thread can use
+// it with the height from a frame descriptor
+inline void Simulation::SmartSize(int screenH, int origW, int origH, int& outW, int& outH) {
+    int targetH = screenH / 8;
+    if (origH > targetH) {
+        float ratio = (float)targetH / (float)origH;
+        outH = targetH;
+        outW = (int)(origW * ratio);
+    } else {
+        int scale = targetH / origH;
+        if (scale < 1) scale = 1;
+        if (scale > 6) scale = 6;
+        outW = origW * scale;
+        outH = origH * scale;
+    }
+}
+
+// Pull a fresh window snapshot if the cache says something changed
+inline void Simulation::RefreshSnapshot() {
+    unsigned long long now = clock.Now();
+    bool changed = windowCache.Refresh(env, now, windowRects, platformIds);
+    if (windowCache.enumerations != trackedEnumerations) {
+        trackedEnumerations = windowCache.enumerations;
+        windowTracker.Update(windowRects, platformIds, now);
+    }
+    if (changed) {
+        windowIndex.Build(windowRects, windowCache.generation);
+        windowTable.Build(windowRects, windowCache.generation);
+        walkable.Build(windowRects, monitors, windowCache.generation);
+        ledgeGraph.Update(windowRects, monitors, walkable);
+    }
+}
+
+// --- PHYSICS ---
+inline void Simulation::UpdatePhysics() {
+    unsigned long long now = clock.Now();
+    unsigned long long dt = lastPhysicsTime ? now - lastPhysicsTime : Config::PHYSICS_STEP_MS;
+    lastPhysicsTime = now;
+    State before = currentState;
+
+    if (MoveInAir(*this, rng, *this, now)) {
+        Applied(before);
+        return;
+    }
+
+    // --- ON GROUND LOGIC ---
+    // 0. CARRY: move with the window we stand on, however far it went since
+    // the last tick. Between enumerations of a moving window, its velocity
+    // says where it is, and until the next one it is our support.
+    bool moved;
+    bool predicted = CarryWalker(*this, *this, now, moved);
+    if (moved) {
+        carriedTicks++;
+        if (predicted) predictedTicks++;
+    }
+
+    // Standing still on the same desktop as a tick that ended safely supported:
+    // the checks below would give the same answer, so skip them.
+    if (!predicted && groundValid && currentState != WALKING && groundGeneration == windowCache.generation &&
+        groundX == posX && groundY == posY && groundState == currentState) {
+        groundChecksSkipped++;
+        return;
+    }
+    groundValid = false;
+
+    GroundContact c;
+    FindSupport(*this, *this, predicted, c);
+    // Check head level (posY - 20)
+    // We ignore windows BELOW our current support (c.windowIndex)
+    // This allows us to stand on a window that is in front of another window without panicking.
+    bool covered = c.supported && IsPointObscured(posX, posY - 20, c.windowIndex);
+    if (c.supported && !covered && !predicted) {
+        // GroundStep leaves this spot and state alone unless it walks
+        groundValid = true;
+        groundGeneration = windowCache.generation;
+        groundX = posX;
+        groundY = posY;
+        groundState = currentState;
+    }
+    GroundStep(*this, rng, *this, c, covered, now, dt);
+    Applied(before);
+}
+
+// --- AI ---
+// The walker's deadlines sit on the timer wheel, so a tick with nothing due
+// costs one compare and the scheduler can sleep until the next one.
+inline void Simulation::UpdateAI() {
+    unsigned long long now = clock.Now();
+    bool behaviourDue = false, jumpDue = false;
+    int fired = aiTimers.Advance(now, [&](int tag, int) {
+        if (tag == AI_BEHAVIOUR) { behaviourDue = true; behaviourTimer = -1; behaviourAt = NEVER; }
+        else { jumpDue = true; jumpTimer = -1; jumpAt = NEVER; }
+    });
+    if (fired) aiWakeups++;
+
+    State before = currentState;
+    bool settled = WalkerAI(*this, rng, now, behaviourDue, jumpDue, [&]() { JumpCheck(now); });
+    Applied(before);
+    if (settled) UpdateActivity(now);
+}
+
+// Route hop, or a one-hop jump to a ledge in range; stays IDLE if there is none
+inline void Simulation::JumpCheck(unsigned long long now) {
+    int here = ledgeGraph.LedgeAt(posX, posY);
+
+    // On a route: the planner already knows the next hop
+    if (hasRoute) {
+        int goal = ledgeGraph.LedgeAt(routeX, routeY);
+        int hop = planner.NextHop(ledgeGraph, here, goal);
+        if (hop == -1) {
+            hasRoute = false; // Arrived, or the desktop changed and there's no way there now
+        } else {
+            targetX = ledgeGraph.ledges[hop].AnchorX();
+            targetY = (int)ledgeGraph.ledges[hop].y;
+            EnterState(*this, rng, PREPARE_JUMP, now, L"Route Hop");
+            return;
+        }
+    }
+
+    // Sometimes pick somewhere far away and travel there over several jumps
+    if (here != -1 && rng.Next(100) < Config::CHANCE_PICK_ROUTE) {
+        int goal = rng.Next((int)ledgeGraph.ledges.size());
+        if (planner.NextHop(ledgeGraph, here, goal) != -1) {
+            SetRoute(ledgeGraph.ledges[goal].AnchorX(), (int)ledgeGraph.ledges[goal].y);
+        }
+    }
+
+    PickJump(*this, rng, ledgeGraph, here, now);
+}
+
+// --- ACTIVITY (foreground title rules) ---
+inline void Simulation::UpdateActivity(unsigned long long now) {
+    // Title rules only re-run when the platform says the foreground changed
+    // (or on the slow resync), not every tick
+    if (titleDirty || now - lastTitleCheck >= (unsigned long long)Config::SNAPSHOT_RESYNC_MS) {
+        ProfileScope scope(profiler, STAGE_TITLE);
+        titleDirty = false;
+        lastTitleCheck = now;
+        titleChecks++;
+        activityRule = titleMatcher.Match(env.GetForegroundTitle());
+    }
+
+    if (activityRule != -1) {
+        State activity = titleMatcher.Rule(activityRule).state;
+        if (currentState != activity && currentState != FALLING && currentState != LEAPING && currentState != PREPARE_JUMP) {
+            ChangeState(activity, L"Title Rule: " + titleMatcher.Rule(activityRule).pattern);
+            inActivity = true;
+        }
+    }
+    else if (inActivity) {
+        inActivity = false;
+        if (currentState != FALLING && currentState != LEAPING && currentState != PREPARE_JUMP) {
+            ChangeState(IDLE, L"Title Rule Ended");
+        }
+    }
+}
+
+// --- ANIMATION ---
+inline void Simulation::UpdateAnimation() {
+    AnimateWalker(*this, animFrames[currentState], animSpeed[currentState], clock.Now());
+}
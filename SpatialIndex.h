@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include "Environment.h"
+
+// ==========================================
+//            SPATIAL INDEX
+// ==========================================
+// Uniform grid over the window snapshot. Each cell lists the windows touching it
+// in z-order (0 is top), so the first hit in a cell is the topmost window at
+// that point. Rebuilt whenever the snapshot generation changes.
+
+class SpatialIndex {
+public:
+    unsigned long long generation = 0;   // Snapshot generation this was built from
+
+    void Build(const std::vector<RectArea>& windows, unsigned long long gen) {
+        generation = gen;
+        rects = windows;
+        int n = (int)rects.size();
+        if (n == 0) { cols = rows = 0; cellStart.assign(1, 0); cellItems.clear(); return; }
+
+        minX = rects[0].left; minY = rects[0].top;
+        long maxX = rects[0].right, maxY = rects[0].bottom;
+        for (const auto& r : rects) {
+            if (r.left < minX) minX = r.left;
+            if (r.top < minY) minY = r.top;
+            if (r.right > maxX) maxX = r.right;
+            if (r.bottom > maxY) maxY = r.bottom;
+        }
+
+        // ~2 cells per window per axis keeps cell lists short without exploding memory
+        int dim = (int)std::sqrt((double)n) * 2;
+        if (dim < 1) dim = 1;
+        if (dim > MAX_DIM) dim = MAX_DIM;
+        cols = rows = dim;
+        cellW = (maxX - minX) / cols + 1;
+        cellH = (maxY - minY) / rows + 1;
+
+        // Counting pass, prefix sum, then fill. Windows go in by index, so every
+        // cell list comes out already sorted top-to-bottom.
+        cellStart.assign(cols * rows + 1, 0);
+        for (const auto& r : rects) {
+            int c0, r0, c1, r1;
+            CellRange(r, c0, r0, c1, r1);
+            for (int cy = r0; cy <= r1; cy++)
+                for (int cx = c0; cx <= c1; cx++) cellStart[cy * cols + cx + 1]++;
+        }
+        for (int i = 0; i < cols * rows; i++) cellStart[i + 1] += cellStart[i];
+
+        cellItems.resize(cellStart[cols * rows]);
+        fill.assign(cellStart.begin(), cellStart.end() - 1);
+        for (int i = 0; i < n; i++) {
+            int c0, r0, c1, r1;
+            CellRange(rects[i], c0, r0, c1, r1);
+            for (int cy = r0; cy <= r1; cy++)
+                for (int cx = c0; cx <= c1; cx++) cellItems[fill[cy * cols + cx]++] = i;
+        }
+    }
+
+    // Index of the topmost window containing the point, or -1
+    int TopmostAt(int x, int y) const {
+        if (cols == 0) return -1;
+        if (x < minX || y < minY) return -1;
+        int cx = (int)((x - minX) / cellW);
+        int cy = (int)((y - minY) / cellH);
+        if (cx >= cols || cy >= rows) return -1;
+        int cell = cy * cols + cx;
+        for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+            const RectArea& r = rects[cellItems[k]];
+            if (x >= r.left && x <= r.right && y >= r.top && y <= r.bottom) return cellItems[k];
+        }
+        return -1;
+    }
+
+    // Same contract as the linear scan: any window with index < limit covers the point?
+    // limit == -1 means "any window".
+    bool IsCoveredAbove(int x, int y, int limit) const {
+        int top = TopmostAt(x, y);
+        if (top == -1) return false;
+        return limit == -1 || top < limit;
+    }
+
+private:
+    static const int MAX_DIM = 128;
+
+    std::vector<RectArea> rects;
+    std::vector<int> cellStart;   // CSR offsets, cols*rows + 1
+    std::vector<int> cellItems;   // Window indices, ascending per cell
+    std::vector<int> fill;
+    int cols = 0, rows = 0;
+    long minX = 0, minY = 0;
+    long cellW = 1, cellH = 1;
+
+    void CellRange(const RectArea& r, int& c0, int& r0, int& c1, int& r1) const {
+        c0 = (int)((r.left - minX) / cellW);
+        r0 = (int)((r.top - minY) / cellH);
+        c1 = (int)((r.right - minX) / cellW);
+        r1 = (int)((r.bottom - minY) / cellH);
+    }
+};
@@ -0,0 +1,145 @@
+// ==========================================
+//           SPRITE CONVERT (CLI)
+// ==========================================
+// Converts folders of source frames into the app's assets in one run:
+//
+//   g++ -O2 -std=c++17 -pthread SpriteConvert.cpp -o sprite_convert   (Linux / MinGW)
+//   cl /O2 /std:c++17 /EHsc SpriteConvert.cpp                           (MSVC)
+//
+//   sprite_convert <input_dir> [output_dir=assets] [--size=WxH] [--colors=N]
+//                  [--threads=N] [--pack[=file]] [--no-png]
+//
+// Every subfolder of input_dir is one animation named after it (walk/,
+// idle/...), frames in natural order. Loose images are grouped by name with
+// the trailing number dropped (walk1.png, walk_02.png -> walk). Writes
+// <output_dir>/<name>_<i>.png; --pack also writes a sprite pack
+// (<output_dir>/sprites.pack by default).
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "SpriteConverter.h"
+
+namespace fs = std::filesystem;
+
+static std::string Lower(std::string s) {
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+// "frame10" after "frame9"
+static bool NaturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t ei = i, ej = j;
+            while (ei < a.size() && isdigit((unsigned char)a[ei])) ei++;
+            while (ej < b.size() && isdigit((unsigned char)b[ej])) ej++;
+            unsigned long long x = strtoull(a.substr(i, ei - i).c_str(), nullptr, 10);
+            unsigned long long y = strtoull(b.substr(j, ej - j).c_str(), nullptr, 10);
+            if (x != y) return x < y;
+            i = ei;
+            j = ej;
+            continue;
+        }
+        char x = (char)tolower((unsigned char)a[i]), y = (char)tolower((unsigned char)b[j]);
+        if (x != y) return x < y;
+        i++;
+        j++;
+    }
+    return a.size() - i < b.size() - j;
+}
+
+static bool IsPng(const fs::path& p) { return Lower(p.extension().string()) == ".png"; }
+
+static std::vector<std::string> SortedFrames(std::vector<fs::path> paths) {
+    std::sort(paths.begin(), paths.end(), [](const fs::path& a, const fs::path& b) {
+        return NaturalLess(a.filename().string(), b.filename().string());
+    });
+    std::vector<std::string> out;
+    for (const fs::path& p : paths) out.push_back(p.string());
+    return out;
+}
+
+static std::vector<SpriteAnimation> Discover(const fs::path& input) {
+    std::map<std::string, std::vector<fs::path>> groups;
+    std::error_code ec;
+    for (const fs::directory_entry& e : fs::directory_iterator(input, ec)) {
+        if (e.is_directory()) {
+            std::vector<fs::path> frames;
+            for (const fs::directory_entry& f : fs::directory_iterator(e.path(), ec)) {
+                if (f.is_regular_file() && IsPng(f.path())) frames.push_back(f.path());
+            }
+            if (!frames.empty()) {
+                std::vector<fs::path>& g = groups[Lower(e.path().filename().string())];
+                g.insert(g.end(), frames.begin(), frames.end());
+            }
+        } else if (e.is_regular_file() && IsPng(e.path())) {
+            std::string stem = e.path().stem().string();
+            size_t end = stem.size();
+            while (end > 0 && isdigit((unsigned char)stem[end - 1])) end--;
+            while (end > 0 && (stem[end - 1] == '_' || stem[end - 1] == '-' || stem[end - 1] == ' ')) end--;
+            groups[Lower(end ? stem.substr(0, end) : stem)].push_back(e.path());
+        }
+    }
+    std::vector<SpriteAnimation> anims;
+    for (auto& g : groups) anims.push_back({ g.first, SortedFrames(g.second) });
+    return anims;
+}
+
+static void Usage() {
+    printf("Usage: sprite_convert <input_dir> [output_dir=assets] [--size=WxH] [--colors=N]\n"
+           "                      [--threads=N] [--pack[=file]] [--no-png]\n");
+}
+
+int main(int argc, char** argv) {
+    std::string input, output = "assets";
+    ConvertOptions options;
+    bool pack = false, png = true;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (strncmp(a, "--size=", 7) == 0) {
+            if (sscanf(a + 7, "%dx%d", &options.width, &options.height) != 2) { Usage(); return 2; }
+        } else if (strncmp(a, "--colors=", 9) == 0) options.colors = atoi(a + 9);
+        else if (strncmp(a, "--threads=", 10) == 0) options.threads = atoi(a + 10);
+        else if (strcmp(a, "--pack") == 0) pack = true;
+        else if (strncmp(a, "--pack=", 7) == 0) { pack = true; options.packPath = a + 7; }
+        else if (strcmp(a, "--no-png") == 0) png = false;
+        else if (a[0] == '-') { Usage(); return 2; }
+        else if (positional++ == 0) input = a;
+        else output = a;
+    }
+    if (input.empty()) { Usage(); return 2; }
+
+    std::vector<SpriteAnimation> anims = Discover(input);
+    if (anims.empty()) {
+        printf("No PNG frames found in %s\n", input.c_str());
+        return 1;
+    }
+    std::error_code ec;
+    fs::create_directories(output, ec);
+    if (png) options.outDir = output;
+    if (pack && options.packPath.empty()) options.packPath = (fs::path(output) / "sprites.pack").string();
+
+    DiskFiles files;
+    SpriteConverter converter(files);
+    ConvertStats stats = converter.Convert(anims, options);
+
+    for (size_t a = 0; a < anims.size(); a++) {
+        const SpriteConverter::Animation& r = converter.results[a];
+        if (!r.ok) continue;
+        printf("  %-16s %3zu frames  %3zu colors\n", anims[a].name.c_str(), r.frames.size(), r.palette.size());
+    }
+    for (const std::string& e : stats.errors) printf("  error: %s\n", e.c_str());
+    printf("%d animations, %d frames in %.1f ms (decode %.1f, palette %.1f, encode %.1f) -> %s\n",
+           stats.animations, stats.frames, stats.totalMs, stats.decodeMs, stats.paletteMs, stats.encodeMs,
+           options.packPath.empty() ? output.c_str() : options.packPath.c_str());
+    return stats.errors.empty() ? 0 : 1;
+}
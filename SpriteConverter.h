@@ -0,0 +1,419 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include "PngCodec.h"
+#include "PixelKernels.h"
+#include "SpritePack.h"
+
+// ==========================================
+//           SPRITE CONVERTER
+// ==========================================
+// Turns source frames into what the app loads. Each frame is scaled (nearest
+// neighbor) to the sprite size. Each animation gets one palette built from
+// all of its frames, so a color never flips between shades from one frame to
+// the next. Frames are written as <name>_<i>.png and/or into a premultiplied
+// sprite pack. Decoding, scaling, indexing and encoding run on a thread pool,
+// one frame per job. Palettes are built one animation per job.
+//
+// Palette: fully transparent pixels get entry 0. The rest are split by median
+// cut (box with the widest channel, at its pixel-weighted median), then one
+// k-means pass moves every entry to the mean of the colors nearest to it.
+
+// File access, so the bench can run everything in memory
+class SpriteFiles {
+public:
+    virtual ~SpriteFiles() {}
+    virtual bool Read(const std::string& path, std::vector<uint8_t>& out) = 0;
+    virtual bool Write(const std::string& path, const std::vector<uint8_t>& data) = 0;
+};
+
+class DiskFiles : public SpriteFiles {
+public:
+    bool Read(const std::string& path, std::vector<uint8_t>& out) override {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        out.clear();
+        uint8_t block[65536];
+        size_t n;
+        while ((n = fread(block, 1, sizeof(block), f)) > 0) out.insert(out.end(), block, block + n);
+        fclose(f);
+        return true;
+    }
+    bool Write(const std::string& path, const std::vector<uint8_t>& data) override {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        return fclose(f) == 0 && ok;
+    }
+};
+
+struct SpriteAnimation {
+    std::string name;                   // Output frames are <name>_<i>.png
+    std::vector<std::string> frames;    // Source PNGs, in frame order
+};
+
+struct ConvertOptions {
+    int width = 80, height = 80;        // 0 on one side keeps the source's aspect ratio
+    int colors = 64;                    // Palette size per animation (2..256), transparent included
+    int threads = 0;                    // 0 = all cores
+    std::string outDir;                 // Where <name>_<i>.png go; empty = no PNGs
+    std::string packPath;               // Sprite pack to write; empty = none
+};
+
+struct ConvertStats {
+    int animations = 0, frames = 0;
+    unsigned long long bytesIn = 0, bytesOut = 0;
+    double decodeMs = 0, paletteMs = 0, encodeMs = 0, totalMs = 0;
+    std::vector<std::string> errors;    // Animations with an unreadable frame are skipped whole
+};
+
+class SpriteConverter {
+public:
+    struct Frame {
+        int width = 0, height = 0;
+        std::vector<uint32_t> pixels;   // Scaled, straight BGRA
+        std::vector<uint8_t> indices;   // Into the animation's palette
+    };
+    struct Animation {
+        std::vector<Frame> frames;
+        std::vector<uint32_t> palette;  // Straight BGRA, entry 0 transparent if any pixel is
+        bool ok = true;
+        // Every distinct visible color (sorted), how often it occurs, and its palette entry
+        std::vector<uint32_t> colors;
+        std::vector<uint32_t> counts;
+        std::vector<uint8_t> entry;
+    };
+
+    // Results of the last Convert, per input animation
+    std::vector<Animation> results;
+
+    explicit SpriteConverter(SpriteFiles& files) : files(files) {}
+
+    ConvertStats Convert(const std::vector<SpriteAnimation>& anims, const ConvertOptions& options) {
+        typedef std::chrono::steady_clock Clock;
+        auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+        Clock::time_point t0 = Clock::now();
+        ConvertStats stats;
+        opt = options;
+        if (opt.colors < 2) opt.colors = 2;
+        if (opt.colors > 256) opt.colors = 256;
+        threads = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+        if (threads < 1) threads = 1;
+
+        results.assign(anims.size(), Animation());
+        std::vector<std::pair<int, int>> jobs;      // (animation, frame)
+        for (size_t a = 0; a < anims.size(); a++) {
+            results[a].frames.resize(anims[a].frames.size());
+            for (size_t k = 0; k < anims[a].frames.size(); k++) jobs.push_back({ (int)a, (int)k });
+        }
+        std::vector<Scratch> scratch(threads);
+        std::mutex mutex;
+        std::atomic<unsigned long long> bytesIn{0}, bytesOut{0};
+
+        // 1. Read, decode and scale every frame
+        ParallelFor((int)jobs.size(), [&](int j, int worker) {
+            Scratch& s = scratch[worker];
+            const std::string& path = anims[jobs[j].first].frames[jobs[j].second];
+            std::string error = "can't read";
+            if (!files.Read(path, s.file) || !Png::Decode(s.file.data(), s.file.size(), s.image, s.inflated, &error)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.errors.push_back(path + ": " + error);
+                results[jobs[j].first].ok = false;
+                return;
+            }
+            bytesIn += s.file.size();
+            Frame& f = results[jobs[j].first].frames[jobs[j].second];
+            TargetSize(s.image.width, s.image.height, f.width, f.height);
+            f.pixels.resize((size_t)f.width * f.height);
+            PixelKernels::ScaleNearest(s.image.pixels.data(), s.image.width, s.image.height, s.image.width,
+                                       f.pixels.data(), f.width, f.height, f.width, false, s.xmap);
+        });
+        Clock::time_point t1 = Clock::now();
+
+        // 2. One palette per animation
+        ParallelFor((int)anims.size(), [&](int a, int) {
+            if (results[a].ok && !results[a].frames.empty()) BuildPalette(results[a]);
+        });
+        Clock::time_point t2 = Clock::now();
+
+        // 3. Index and encode every frame
+        std::vector<std::vector<uint32_t>> packPixels(opt.packPath.empty() ? 0 : jobs.size());
+        std::vector<std::vector<uint32_t>> premultiplied(anims.size());
+        for (size_t a = 0; a < anims.size(); a++) {
+            premultiplied[a] = results[a].palette;
+            PixelKernels::Premultiply(premultiplied[a].data(), premultiplied[a].data(), (int)premultiplied[a].size());
+        }
+        ParallelFor((int)jobs.size(), [&](int j, int worker) {
+            Animation& anim = results[jobs[j].first];
+            if (!anim.ok) return;
+            Scratch& s = scratch[worker];
+            Frame& f = anim.frames[jobs[j].second];
+            IndexFrame(anim, f);
+            if (!opt.outDir.empty()) {
+                Png::EncodeIndexed(f.indices.data(), f.width, f.height, anim.palette.data(), (int)anim.palette.size(), s.file, s.filtered);
+                std::string path = opt.outDir + "/" + anims[jobs[j].first].name + "_" + std::to_string(jobs[j].second) + ".png";
+                if (!files.Write(path, s.file)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stats.errors.push_back(path + ": can't write");
+                }
+                bytesOut += s.file.size();
+            }
+            if (!opt.packPath.empty()) {
+                std::vector<uint32_t>& px = packPixels[j];
+                const std::vector<uint32_t>& pal = premultiplied[jobs[j].first];
+                px.resize(f.indices.size());
+                for (size_t i = 0; i < px.size(); i++) px[i] = pal[f.indices[i]];
+            }
+        });
+
+        if (!opt.packPath.empty()) {
+            std::vector<std::string> names;
+            std::vector<std::vector<PackSourceFrame>> packAnims;
+            for (size_t j = 0; j < jobs.size(); j++) {
+                int a = jobs[j].first;
+                if (!results[a].ok) continue;
+                if (jobs[j].second == 0) {
+                    names.push_back(anims[a].name);
+                    packAnims.emplace_back();
+                }
+                const Frame& f = results[a].frames[jobs[j].second];
+                packAnims.back().push_back({ (uint32_t)f.width, (uint32_t)f.height, packPixels[j].data() });
+            }
+            std::vector<uint8_t> pack;
+            BuildPack(names, packAnims, pack);
+            if (!files.Write(opt.packPath, pack)) stats.errors.push_back(opt.packPath + ": can't write");
+            bytesOut += pack.size();
+        }
+        Clock::time_point t3 = Clock::now();
+
+        for (const Animation& a : results) {
+            if (!a.ok) continue;
+            stats.animations++;
+            stats.frames += (int)a.frames.size();
+        }
+        stats.bytesIn = bytesIn;
+        stats.bytesOut = bytesOut;
+        stats.decodeMs = ms(t0, t1);
+        stats.paletteMs = ms(t1, t2);
+        stats.encodeMs = ms(t2, t3);
+        stats.totalMs = ms(t0, t3);
+        return stats;
+    }
+
+private:
+    // Per worker, reused across its jobs
+    struct Scratch {
+        std::vector<uint8_t> file, inflated, filtered;
+        Png::Image image;
+        std::vector<int> xmap;
+    };
+
+    // A run of colors[begin, end) that median cut treats as one entry
+    struct Box {
+        int begin, end;
+        int channel;                    // Widest channel (shift: 0 = B ... 24 = A)
+        int range;
+    };
+
+    SpriteFiles& files;
+    ConvertOptions opt;
+    int threads = 1;
+
+    template <typename Fn>
+    void ParallelFor(int count, Fn fn) {
+        std::atomic<int> next{0};
+        auto work = [&](int worker) {
+            for (int i; (i = next.fetch_add(1)) < count; ) fn(i, worker);
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads && t < count; t++) pool.emplace_back(work, t);
+        work(0);
+        for (auto& t : pool) t.join();
+    }
+
+    void TargetSize(int srcW, int srcH, int& w, int& h) const {
+        w = opt.width;
+        h = opt.height;
+        if (w <= 0 && h <= 0) { w = srcW; h = srcH; }
+        else if (w <= 0) w = (int)(((long long)srcW * h + srcH / 2) / srcH);
+        else if (h <= 0) h = (int)(((long long)srcH * w + srcW / 2) / srcW);
+        if (w < 1) w = 1;
+        if (h < 1) h = 1;
+    }
+
+    static int Channel(uint32_t c, int shift) { return (int)((c >> shift) & 0xFF); }
+
+    static int Distance(uint32_t a, uint32_t b) {
+        int d = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int v = Channel(a, shift) - Channel(b, shift);
+            d += v * v;
+        }
+        return d;
+    }
+
+    void Measure(const Animation& anim, Box& box) const {
+        int lo[4] = { 255, 255, 255, 255 }, hi[4] = { 0, 0, 0, 0 };
+        for (int i = box.begin; i < box.end; i++) {
+            for (int c = 0; c < 4; c++) {
+                int v = Channel(anim.colors[i], c * 8);
+                if (v < lo[c]) lo[c] = v;
+                if (v > hi[c]) hi[c] = v;
+            }
+        }
+        box.range = -1;
+        for (int c = 0; c < 4; c++) {
+            if (hi[c] - lo[c] > box.range) { box.range = hi[c] - lo[c]; box.channel = c * 8; }
+        }
+    }
+
+    uint32_t Mean(const Animation& anim, int begin, int end) const {
+        double sum[4] = { 0, 0, 0, 0 }, weight = 0;
+        for (int i = begin; i < end; i++) {
+            double w = anim.counts[i];
+            for (int c = 0; c < 4; c++) sum[c] += w * Channel(anim.colors[i], c * 8);
+            weight += w;
+        }
+        uint32_t out = 0;
+        for (int c = 0; c < 4; c++) out |= (uint32_t)(sum[c] / weight + 0.5) << (c * 8);
+        return out;
+    }
+
+    // Nearest palette entry (from 'first') for every distinct color
+    void Assign(Animation& anim, int first) const {
+        anim.entry.resize(anim.colors.size());
+        for (size_t i = 0; i < anim.colors.size(); i++) {
+            int best = first, bestD = 1 << 30;
+            for (int e = first; e < (int)anim.palette.size(); e++) {
+                int d = Distance(anim.colors[i], anim.palette[e]);
+                if (d < bestD) { bestD = d; best = e; }
+            }
+            anim.entry[i] = (uint8_t)best;
+        }
+    }
+
+    void BuildPalette(Animation& anim) const {
+        // Every visible pixel of every frame, counted per distinct color
+        std::vector<uint32_t> all;
+        bool transparent = false;
+        for (const Frame& f : anim.frames) {
+            for (uint32_t p : f.pixels) {
+                if (p >> 24) all.push_back(p);
+                else transparent = true;
+            }
+        }
+        std::sort(all.begin(), all.end());
+        anim.colors.clear();
+        anim.counts.clear();
+        for (size_t i = 0; i < all.size(); ) {
+            size_t j = i;
+            while (j < all.size() && all[j] == all[i]) j++;
+            anim.colors.push_back(all[i]);
+            anim.counts.push_back((uint32_t)(j - i));
+            i = j;
+        }
+
+        anim.palette.clear();
+        if (transparent) anim.palette.push_back(0);
+        int first = (int)anim.palette.size();
+        int slots = opt.colors - first;
+        if ((int)anim.colors.size() <= slots) {
+            anim.palette.insert(anim.palette.end(), anim.colors.begin(), anim.colors.end());
+            anim.entry.resize(anim.colors.size());
+            for (size_t i = 0; i < anim.colors.size(); i++) anim.entry[i] = (uint8_t)(first + i);
+            return;
+        }
+
+        // Median cut, then one k-means pass
+        std::vector<Box> boxes(1);
+        boxes[0].begin = 0;
+        boxes[0].end = (int)anim.colors.size();
+        Measure(anim, boxes[0]);
+        std::vector<std::pair<uint32_t, uint32_t>> order;
+        while ((int)boxes.size() < slots) {
+            int pick = -1;
+            for (int b = 0; b < (int)boxes.size(); b++) {
+                if (boxes[b].end - boxes[b].begin > 1 && (pick == -1 || boxes[b].range > boxes[pick].range)) pick = b;
+            }
+            if (pick == -1 || boxes[pick].range == 0) break;
+            Box box = boxes[pick];
+            // Sort the box's colors (with their counts) along its widest channel
+            order.clear();
+            for (int i = box.begin; i < box.end; i++) order.push_back({ anim.colors[i], anim.counts[i] });
+            int shift = box.channel;
+            std::stable_sort(order.begin(), order.end(), [shift](const std::pair<uint32_t, uint32_t>& x, const std::pair<uint32_t, uint32_t>& y) {
+                return Channel(x.first, shift) < Channel(y.first, shift);
+            });
+            unsigned long long total = 0, run = 0;
+            for (const auto& o : order) total += o.second;
+            int split = box.begin + 1;
+            for (int i = 0; i < (int)order.size() - 1; i++) {
+                anim.colors[box.begin + i] = order[i].first;
+                anim.counts[box.begin + i] = order[i].second;
+                run += order[i].second;
+                if (run * 2 < total) split = box.begin + i + 2;
+            }
+            anim.colors[box.end - 1] = order.back().first;
+            anim.counts[box.end - 1] = order.back().second;
+            if (split >= box.end) split = box.end - 1;
+
+            Box lo = { box.begin, split, 0, 0 }, hi = { split, box.end, 0, 0 };
+            Measure(anim, lo);
+            Measure(anim, hi);
+            boxes[pick] = lo;
+            boxes.push_back(hi);
+        }
+        for (const Box& b : boxes) anim.palette.push_back(Mean(anim, b.begin, b.end));
+
+        // Boxes reordered the color list; indexing binary-searches it
+        std::vector<size_t> byColor(anim.colors.size());
+        for (size_t i = 0; i < byColor.size(); i++) byColor[i] = i;
+        std::sort(byColor.begin(), byColor.end(), [&](size_t x, size_t y) { return anim.colors[x] < anim.colors[y]; });
+        std::vector<uint32_t> colors(byColor.size()), counts(byColor.size());
+        for (size_t i = 0; i < byColor.size(); i++) { colors[i] = anim.colors[byColor[i]]; counts[i] = anim.counts[byColor[i]]; }
+        anim.colors.swap(colors);
+        anim.counts.swap(counts);
+
+        Assign(anim, first);
+        std::vector<double> sum((size_t)anim.palette.size() * 5, 0.0);
+        for (size_t i = 0; i < anim.colors.size(); i++) {
+            double* s = &sum[(size_t)anim.entry[i] * 5];
+            for (int c = 0; c < 4; c++) s[c] += (double)anim.counts[i] * Channel(anim.colors[i], c * 8);
+            s[4] += anim.counts[i];
+        }
+        for (size_t e = first; e < anim.palette.size(); e++) {
+            const double* s = &sum[e * 5];
+            if (s[4] == 0) continue;
+            uint32_t c = 0;
+            for (int k = 0; k < 4; k++) c |= (uint32_t)(s[k] / s[4] + 0.5) << (k * 8);
+            anim.palette[e] = c;
+        }
+        Assign(anim, first);
+    }
+
+    static void IndexFrame(const Animation& anim, Frame& f) {
+        f.indices.resize(f.pixels.size());
+        uint32_t last = 0;
+        uint8_t lastEntry = 0;
+        bool haveLast = false;
+        for (size_t i = 0; i < f.pixels.size(); i++) {
+            uint32_t p = f.pixels[i];
+            if (!(p >> 24)) { f.indices[i] = 0; continue; }
+            // Sprites come in runs of one color
+            if (!haveLast || p != last) {
+                size_t k = std::lower_bound(anim.colors.begin(), anim.colors.end(), p) - anim.colors.begin();
+                last = p;
+                lastEntry = anim.entry[k];
+                haveLast = true;
+            }
+            f.indices[i] = lastEntry;
+        }
+    }
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ==========================================
+//              SPRITE PACK
+// ==========================================
+// One file with every animation frame, ready to use straight from a memory
+// map (no PNG decode at startup). Written by sprite_packer.py or sprite_convert.
+//
+// Layout (little endian):
+//   PackHeader
+//   PackAnim[animCount]
+//   PackFrame[frameCount]
+//   pixel data: premultiplied BGRA, stride = width * 4, each frame 16-byte aligned
+
+const uint32_t PACK_VERSION = 1;
+
+#pragma pack(push, 1)
+struct PackHeader {
+    char magic[4];          // "DWPK"
+    uint32_t version;
+    uint32_t animCount;
+    uint32_t frameCount;
+};
+
+struct PackAnim {
+    char name[32];          // e.g. "walk", NUL padded
+    uint32_t firstFrame;
+    uint32_t frameCount;
+};
+
+struct PackFrame {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;        // From the start of the file
+};
+#pragma pack(pop)
+
+class SpritePack {
+public:
+    ~SpritePack() { Close(); }
+
+    bool Open(const char* path) {
+        Close();
+#ifdef _WIN32
+        hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) { hFile = NULL; return false; }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(hFile, &fileSize);
+        size = (size_t)fileSize.QuadPart;
+        hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!hMapping) { Close(); return false; }
+        data = (const unsigned char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); return false; }
+        size = (size_t)st.st_size;
+        void* p = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        data = (p == MAP_FAILED) ? nullptr : (const unsigned char*)p;
+#endif
+        if (!data || !Validate()) { Close(); return false; }
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (hMapping) CloseHandle(hMapping);
+        if (hFile) CloseHandle(hFile);
+        hMapping = hFile = NULL;
+#else
+        if (data) munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+    uint32_t AnimCount() const { return Header()->animCount; }
+    uint32_t FrameCount() const { return Header()->frameCount; }
+    const PackAnim& Anim(uint32_t i) const { return Anims()[i]; }
+    const PackFrame& Frame(uint32_t i) const { return Frames()[i]; }
+    const unsigned char* Pixels(uint32_t i) const { return data + Frames()[i].offset; }
+
+    // Animation index by name, or -1
+    int FindAnim(const std::string& name) const {
+        for (uint32_t i = 0; i < AnimCount(); i++) {
+            if (strncmp(Anims()[i].name, name.c_str(), sizeof(Anims()[i].name)) == 0) return (int)i;
+        }
+        return -1;
+    }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE hFile = NULL;
+    HANDLE hMapping = NULL;
+#endif
+
+    const PackHeader* Header() const { return (const PackHeader*)data; }
+    const PackAnim* Anims() const { return (const PackAnim*)(data + sizeof(PackHeader)); }
+    const PackFrame* Frames() const { return (const PackFrame*)(data + sizeof(PackHeader) + Header()->animCount * sizeof(PackAnim)); }
+
+    // Never trust the file: every table and pixel block must sit inside the map
+    bool Validate() const {
+        if (size < sizeof(PackHeader)) return false;
+        const PackHeader* h = Header();
+        if (memcmp(h->magic, "DWPK", 4) != 0 || h->version != PACK_VERSION) return false;
+        uint64_t tables = sizeof(PackHeader) + (uint64_t)h->animCount * sizeof(PackAnim) + (uint64_t)h->frameCount * sizeof(PackFrame);
+        if (tables > size) return false;
+        for (uint32_t i = 0; i < h->animCount; i++) {
+            const PackAnim& a = Anims()[i];
+            if ((uint64_t)a.firstFrame + a.frameCount > h->frameCount) return false;
+        }
+        for (uint32_t i = 0; i < h->frameCount; i++) {
+            const PackFrame& f = Frames()[i];
+            uint64_t bytes = (uint64_t)f.width * f.height * 4;
+            if (f.width == 0 || f.height == 0 || f.offset < tables || f.offset + bytes > size) return false;
+        }
+        return true;
+    }
+};
+
+// --- WRITER ---
+// Builds a pack from frames already in memory. Names are cut to 31 bytes.
+struct PackSourceFrame {
+    uint32_t width, height;
+    const uint32_t* pixels;     // Premultiplied BGRA, stride = width
+};
+
+inline void BuildPack(const std::vector<std::string>& names, const std::vector<std::vector<PackSourceFrame>>& anims, std::vector<uint8_t>& out) {
+    uint32_t frameCount = 0;
+    for (const auto& a : anims) frameCount += (uint32_t)a.size();
+    size_t tables = sizeof(PackHeader) + names.size() * sizeof(PackAnim) + frameCount * sizeof(PackFrame);
+    auto align16 = [](size_t n) { return (n + 15) & ~(size_t)15; };
+
+    size_t total = align16(tables);
+    for (const auto& a : anims)
+        for (const auto& f : a) total = align16(total + (size_t)f.width * f.height * 4);
+    out.assign(total, 0);
+
+    PackHeader h;
+    memcpy(h.magic, "DWPK", 4);
+    h.version = PACK_VERSION;
+    h.animCount = (uint32_t)names.size();
+    h.frameCount = frameCount;
+    memcpy(out.data(), &h, sizeof(h));
+
+    size_t animAt = sizeof(PackHeader), frameAt = animAt + names.size() * sizeof(PackAnim);
+    size_t offset = align16(tables);
+    uint32_t first = 0;
+    for (size_t i = 0; i < names.size(); i++) {
+        PackAnim a;
+        memset(&a, 0, sizeof(a));
+        memcpy(a.name, names[i].c_str(), names[i].size() < 31 ? names[i].size() : 31);
+        a.firstFrame = first;
+        a.frameCount = (uint32_t)anims[i].size();
+        memcpy(out.data() + animAt + i * sizeof(PackAnim), &a, sizeof(a));
+        for (const auto& src : anims[i]) {
+            PackFrame f;
+            f.width = src.width;
+            f.height = src.height;
+            f.offset = offset;
+            memcpy(out.data() + frameAt + (size_t)first++ * sizeof(PackFrame), &f, sizeof(f));
+            memcpy(out.data() + offset, src.pixels, (size_t)src.width * src.height * 4);
+            offset = align16(offset + (size_t)src.width * src.height * 4);
+        }
+    }
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+// ==========================================
+//              SPRITE STORE
+// ==========================================
+// Sprite sets ("walk", "sleep"...) are decoded the first time they are drawn,
+// not at startup, and the least recently drawn ones are dropped again once the
+// decoded total goes over a byte budget. Pixels live in chunks handed out by a
+// shared pool: a set's frames sit together, and an evicted set's memory is
+// reused by the next decode instead of going back through the heap. Frame
+// sizes outlive eviction, so a draw served from the composed-frame cache never
+// forces a decode. Sets that point into the memory-mapped pack cost nothing here.
+// Frames the renderer scales from a set are charged to that set too, and go
+// when it is evicted, so the budget covers everything kept for drawing.
+
+struct SpriteFrame {
+    const uint32_t* pixels = nullptr;   // Premultiplied BGRA, stride = width
+    int width = 0, height = 0;
+};
+
+// Fixed-size chunks, plus one-off chunks for frames too big for one. Freed
+// chunks are kept for reuse until Trim() says otherwise.
+class SpritePool {
+public:
+    static const size_t CHUNK_BYTES = 64 * 1024;   // A few typical frames; bigger ones get their own
+
+    size_t allocatedBytes = 0;   // Everything from the heap, in use or pooled
+    size_t pooledBytes = 0;
+
+    ~SpritePool() { Trim(0); }
+
+    uint32_t* Take(size_t bytes, size_t& got) {
+        got = bytes > CHUNK_BYTES ? bytes : CHUNK_BYTES;
+        for (size_t i = 0; i < free.size(); i++) {
+            if (free[i].bytes != got) continue;
+            uint32_t* p = free[i].p;
+            free[i] = free.back();
+            free.pop_back();
+            pooledBytes -= got;
+            return p;
+        }
+        allocatedBytes += got;
+        return (uint32_t*)::operator new(got);
+    }
+
+    void Give(uint32_t* p, size_t bytes) {
+        free.push_back({ p, bytes });
+        pooledBytes += bytes;
+    }
+
+    // Hand pooled chunks back to the heap until at most 'keepBytes' are pooled
+    void Trim(size_t keepBytes) {
+        while (pooledBytes > keepBytes && !free.empty()) {
+            pooledBytes -= free.back().bytes;
+            allocatedBytes -= free.back().bytes;
+            ::operator delete(free.back().p);
+            free.pop_back();
+        }
+    }
+
+private:
+    struct Chunk { uint32_t* p; size_t bytes; };
+    std::vector<Chunk> free;
+};
+
+// Bump allocator for one set's pixels; everything goes back to the pool at once
+class SpriteArena {
+public:
+    explicit SpriteArena(SpritePool* pool = nullptr) : pool(pool) {}
+
+    // 'pixels' uint32s, 16-byte aligned
+    uint32_t* Allocate(size_t pixels) {
+        size_t bytes = (pixels * 4 + 15) & ~(size_t)15;
+        if (chunks.empty() || used + bytes > chunks.back().bytes) {
+            Chunk c;
+            c.p = pool->Take(bytes, c.bytes);
+            chunks.push_back(c);
+            used = 0;
+        }
+        uint32_t* p = chunks.back().p + used / 4;
+        used += bytes;
+        return p;
+    }
+
+    void Release() {
+        for (const auto& c : chunks) pool->Give(c.p, c.bytes);
+        chunks.clear();
+        used = 0;
+    }
+
+    size_t Bytes() const {
+        size_t total = 0;
+        for (const auto& c : chunks) total += c.bytes;
+        return total;
+    }
+
+private:
+    struct Chunk { uint32_t* p; size_t bytes; };
+    SpritePool* pool;
+    std::vector<Chunk> chunks;
+    size_t used = 0;   // Bytes used in the last chunk
+};
+
+// Where the pixels come from: fill 'frames' for the set called 'name', taking
+// storage from 'arena' (or pointing at memory the source keeps alive itself)
+class SpriteSource {
+public:
+    virtual ~SpriteSource() {}
+    virtual bool Load(const std::string& name, SpriteArena& arena, std::vector<SpriteFrame>& frames) = 0;
+};
+
+// Told when a set is evicted, to drop whatever was scaled from it
+class SpriteEvictListener {
+public:
+    virtual ~SpriteEvictListener() {}
+    virtual void Evicted(int set) = 0;
+};
+
+struct SpriteStoreStats {
+    unsigned long long lookups = 0;
+    unsigned long long pixelLookups = 0; // Lookups that needed the pixels
+    unsigned long long decodes = 0;      // Set loads, first ones and after eviction
+    unsigned long long evictions = 0;
+    unsigned long long failures = 0;     // Loads that produced no frames
+    int firstDecodes = 0;                // Sets decoded at least once
+    double firstDecodeMs = 0;            // Their first decodes: what startup used to pay up front
+    double reloadMs = 0;                 // Decodes after eviction
+    size_t residentBytes = 0;            // Held by decoded sets, scaled frames included
+    size_t scaledBytes = 0;              // Of which charged by the renderer
+    size_t peakBytes = 0;
+    int residentSets = 0;
+};
+
+class SpriteStore {
+public:
+    SpriteStoreStats stats;
+
+    explicit SpriteStore(size_t budgetBytes = 0) : budget(budgetBytes) {}
+    ~SpriteStore() { for (auto& s : sets) s.arena.Release(); }
+
+    void SetSource(SpriteSource* s) { source = s; }
+    void SetEvictListener(SpriteEvictListener* l) { listener = l; }
+    void SetBudget(size_t bytes) { budget = bytes; Evict(-1, 0); }
+    size_t Budget() const { return budget; }
+    const SpritePool& Pool() const { return pool; }
+
+    // Register a set by name; the same name always gives the same id. Nothing is decoded yet.
+    int AddSet(const std::string& name) {
+        for (size_t i = 0; i < sets.size(); i++) if (sets[i].name == name) return (int)i;
+        sets.push_back(Set(name, &pool));
+        return (int)sets.size() - 1;
+    }
+    int SetCount() const { return (int)sets.size(); }
+    const std::string& Name(int set) const { return sets[set].name; }
+    bool Resident(int set) const { return sets[set].loaded; }
+    double FirstDecodeMs(int set) const { return sets[set].firstDecodeMs; }   // 0 until it is drawn
+
+    // Frame 'index' of 'set', or nullptr if there is no such frame. Without
+    // 'needPixels' only the size is guaranteed (pixels is null if the set was
+    // evicted); the set is only decoded if its sizes aren't known yet. The
+    // result is valid until the next call, which may evict it.
+    const SpriteFrame* Frame(int set, int index, bool needPixels) {
+        if (set < 0 || set >= (int)sets.size() || index < 0) return nullptr;
+        stats.lookups++;
+        if (needPixels) stats.pixelLookups++;
+        Set& s = sets[set];
+        s.lastUse = ++useClock;
+        if (!s.loaded && (needPixels || !s.sized)) Load(set);
+        return index < (int)s.frames.size() ? &s.frames[index] : nullptr;
+    }
+
+    // 'bytes' more were scaled from 'set' and are kept elsewhere until the
+    // listener hears the set was evicted
+    void Charge(int set, size_t bytes) {
+        if (set < 0 || set >= (int)sets.size()) return;
+        sets[set].scaledBytes += bytes;
+        stats.scaledBytes += bytes;
+        stats.residentBytes += bytes;
+        if (stats.residentBytes > stats.peakBytes) stats.peakBytes = stats.residentBytes;
+        Evict(set, 0);
+    }
+
+    // Whoever held the scaled frames dropped them all (e.g. on a display change)
+    void ClearCharges() {
+        for (auto& s : sets) s.scaledBytes = 0;
+        stats.residentBytes -= stats.scaledBytes;
+        stats.scaledBytes = 0;
+    }
+
+    // Sets looked up between these two stay resident even over budget: what
+    // was scaled from them may still be drawn from this frame. The budget is
+    // enforced again at EndFrame.
+    void BeginFrame() { pinnedFrom = useClock + 1; }
+    void EndFrame() {
+        pinnedFrom = ~0ULL;
+        Evict(-1, 0);
+    }
+
+private:
+    struct Set {
+        std::string name;
+        SpriteArena arena;
+        std::vector<SpriteFrame> frames;
+        bool loaded = false;      // Pixels are valid
+        bool sized = false;       // frames has the sizes (kept after eviction)
+        size_t lastBytes = 0;     // Arena size last time it was decoded
+        size_t scaledBytes = 0;   // Charged by the renderer since then
+        double firstDecodeMs = 0;
+        unsigned long long lastUse = 0;
+        Set(const std::string& n, SpritePool* pool) : name(n), arena(pool) {}
+    };
+
+    SpriteSource* source = nullptr;
+    SpriteEvictListener* listener = nullptr;
+    size_t budget;
+    SpritePool pool;
+    std::vector<Set> sets;
+    unsigned long long useClock = 0;
+    unsigned long long pinnedFrom = ~0ULL;   // Sets used at or after this are pinned
+
+    void Load(int set) {
+        Set& s = sets[set];
+        // Reloading after eviction: make room first, so the decode reuses the victims' chunks
+        if (s.lastBytes) Evict(set, s.lastBytes);
+        s.frames.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!source || !source->Load(s.name, s.arena, s.frames)) s.frames.clear();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (s.sized) {
+            stats.reloadMs += ms;
+        } else {
+            s.firstDecodeMs = ms;
+            stats.firstDecodes++;
+            stats.firstDecodeMs += ms;
+        }
+        if (s.frames.empty()) {
+            // Remember the failure instead of retrying every frame
+            s.arena.Release();
+            stats.failures++;
+        }
+        s.loaded = true;
+        s.sized = true;
+        s.lastBytes = s.arena.Bytes();
+        stats.decodes++;
+        stats.residentSets++;
+        stats.residentBytes += s.lastBytes;
+        if (stats.residentBytes > stats.peakBytes) stats.peakBytes = stats.residentBytes;
+        Evict(set, 0);
+    }
+
+    // Drop least recently used sets (never 'keep' or a pinned one) until
+    // 'incoming' more bytes fit the budget, then only pool as much as the
+    // budget still has room for
+    void Evict(int keep, size_t incoming) {
+        while (stats.residentBytes + incoming > budget) {
+            int victim = -1;
+            for (int i = 0; i < (int)sets.size(); i++) {
+                const Set& c = sets[i];
+                if (i == keep || !c.loaded || c.lastUse >= pinnedFrom || c.arena.Bytes() + c.scaledBytes == 0) continue;
+                if (victim == -1 || c.lastUse < sets[victim].lastUse) victim = i;
+            }
+            if (victim == -1) break;   // Only 'keep' left: a single set may exceed the budget
+            Set& v = sets[victim];
+            stats.residentBytes -= v.arena.Bytes() + v.scaledBytes;
+            stats.scaledBytes -= v.scaledBytes;
+            stats.residentSets--;
+            stats.evictions++;
+            v.arena.Release();
+            for (auto& f : v.frames) f.pixels = nullptr;
+            v.loaded = false;
+            v.scaledBytes = 0;
+            if (listener) listener->Evicted(victim);
+        }
+        pool.Trim(stats.residentBytes < budget ? budget - stats.residentBytes : 0);
+    }
+};
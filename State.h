@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+// ==========================================
+//            CHARACTER STATES
+// ==========================================
+
+enum State {
+    IDLE, WALKING, SITTING, SLEEPING, FALLING, PREPARE_JUMP, LEAPING, WATCHING_MOVIE
+};
+const int STATE_COUNT = 8;
+
+inline std::wstring GetStateName(State s) {
+    switch(s) {
+        case IDLE: return L"IDLE";
+        case WALKING: return L"WALKING";
+        case SITTING: return L"SITTING";
+        case SLEEPING: return L"SLEEPING";
+        case FALLING: return L"FALLING";
+        case PREPARE_JUMP: return L"PREPARE_JUMP";
+        case LEAPING: return L"LEAPING";
+        case WATCHING_MOVIE: return L"WATCHING_MOVIE";
+        default: return L"UNKNOWN";
+    }
+}
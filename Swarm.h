@@ -0,0 +1,324 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include "Simulation.h"
+
+// ==========================================
+//                 SWARM
+// ==========================================
+// Many characters on one desktop. Walker state is stored column-wise (one
+// array per field), each walker rolls its own Random stream, and a tick updates
+// fixed-size chunks of walkers on a pool of worker threads, all reading the
+// snapshot of one Simulation. A walker only ever writes its own slots and
+// draws from its own stream, so the outcome depends on the seed alone, not on
+// the thread count or which thread got which chunk.
+//
+// Each walker runs the Simulation's own rules (WALKER RULES in Simulation.h):
+// a chunk gathers a walker's columns into a Walker, steps it and scatters it
+// back. Only what makes sense for a single character stays out: title rules,
+// multi-hop routes and the ground-check cache. The head checks of a chunk's
+// walkers on the ground go to the window table as one batch.
+
+class Swarm {
+public:
+    static const int CHUNK = 256;   // Walkers per work item
+
+    // --- WALKERS (index = walker) ---
+    std::vector<unsigned char> state;        // State
+    std::vector<unsigned char> facingRight;
+    std::vector<int> posX, posY, velY;
+    std::vector<int> targetX, targetY;
+    std::vector<int> frame;
+    std::vector<unsigned long long> stateTime, frameTime;
+    std::vector<WindowId> carryWindow;      // 0 on a floor or in the air
+
+    explicit Swarm(int threads = 0) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        threadCount = threads < 1 ? 1 : threads;
+        for (int i = 0; i < STATE_COUNT; i++) { animFrames[i] = 0; animSpeed[i] = 0; }
+    }
+
+    ~Swarm() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        startCv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    Swarm(const Swarm&) = delete;
+    Swarm& operator=(const Swarm&) = delete;
+
+    int Count() const { return (int)posX.size(); }
+    int Threads() const { return threadCount; }
+
+    void SetAnimation(State s, int frameCount, int msPerFrame) {
+        animFrames[s] = frameCount;
+        animSpeed[s] = msPerFrame;
+    }
+
+    // 'count' walkers dropped at random spots along the monitor tops. Walker i's
+    // stream is the i-th SplitMix64 output from 'seed', so adding walkers never
+    // changes the ones already there.
+    void Spawn(const Simulation& world, int count, unsigned long long seed, unsigned long long now) {
+        Resize(count);
+        for (int i = 0; i < count; i++) {
+            Random& r = rng[i];
+            r.Seed(seed + 0x9E3779B97F4A7C15ull * (unsigned long long)(i + 1));
+            int x = 0, y = 0;
+            if (!world.monitors.empty()) {
+                const RectArea& m = world.monitors[r.Next((int)world.monitors.size())];
+                x = (int)m.left + r.Next((int)(m.right - m.left) + 1);
+                y = (int)m.top + r.Next((int)(m.bottom - m.top) / 4 + 1);
+            }
+            Walker w;
+            w.currentState = IDLE;
+            w.posX = x;
+            w.posY = y;
+            w.facingRight = r.Next(2) == 0;
+            EnterState(w, r, FALLING, now, L"Spawn");
+            Store(i, w);
+        }
+        lastTickTime = 0;
+    }
+
+    // One step for every walker against world's current snapshot. Call after
+    // world.Tick() (or RefreshSnapshot()) so all walkers see the same desktop.
+    void Tick(const Simulation& world, unsigned long long now) {
+        tickWorld = &world;
+        tickNow = now;
+        tickDt = lastTickTime ? now - lastTickTime : Config::PHYSICS_STEP_MS;
+        lastTickTime = now;
+
+        int chunks = (Count() + CHUNK - 1) / CHUNK;
+        if (chunks <= 1 || threadCount <= 1) {
+            for (int c = 0; c < chunks; c++) UpdateChunk(c);
+            return;
+        }
+        StartWorkers();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunkCount = chunks;
+            nextChunk.store(0, std::memory_order_relaxed);
+            busy = (int)workers.size();
+            job++;
+        }
+        startCv.notify_all();
+        Work();
+        // Every worker has to be out of Work() before the next tick resets it
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCv.wait(lock, [&]() { return busy == 0; });
+    }
+
+    int CountIn(State s) const {
+        int n = 0;
+        for (unsigned char st : state) n += (st == (unsigned char)s);
+        return n;
+    }
+
+    // Walker-ticks moved along with the window underneath, as Simulation::carriedTicks
+    unsigned long long CarriedTicks() const {
+        unsigned long long n = 0;
+        for (unsigned long long c : chunkCarried) n += c;
+        return n;
+    }
+
+private:
+    // Per-walker, only touched by the walker's own update
+    std::vector<Random> rng;
+    std::vector<unsigned char> moveStarted;
+    std::vector<int> moveX, moveY, moveVel;
+    std::vector<unsigned long long> moveStart;
+    std::vector<long long> walkRemainder;
+    std::vector<int> supportSpan, carryIndex;
+    std::vector<long> carryLeft, carryTop, carryWidth;
+    std::vector<unsigned long long> behaviourAt, jumpAt;
+
+    std::vector<unsigned long long> chunkCarried;   // Per chunk, so no two threads share a counter
+
+    int animFrames[STATE_COUNT];
+    int animSpeed[STATE_COUNT];
+
+    unsigned long long lastTickTime = 0;
+
+    // Current tick, read by every chunk
+    const Simulation* tickWorld = nullptr;
+    unsigned long long tickNow = 0, tickDt = 0;
+
+    // --- WORKER POOL ---
+    int threadCount;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCv, doneCv;
+    unsigned long long job = 0;     // Bumped per parallel tick
+    int chunkCount = 0;
+    bool quit = false;
+    int busy = 0;                   // Workers that haven't finished this job yet
+    std::atomic<int> nextChunk{0};
+
+    void Resize(int n) {
+        state.resize(n); facingRight.resize(n);
+        posX.resize(n); posY.resize(n); velY.resize(n);
+        targetX.resize(n); targetY.resize(n);
+        frame.resize(n); stateTime.resize(n); frameTime.resize(n);
+        carryWindow.resize(n);
+        rng.resize(n);
+        moveStarted.resize(n);
+        moveX.resize(n); moveY.resize(n); moveVel.resize(n);
+        moveStart.resize(n); walkRemainder.resize(n);
+        supportSpan.resize(n); carryIndex.resize(n);
+        carryLeft.resize(n); carryTop.resize(n); carryWidth.resize(n);
+        behaviourAt.resize(n); jumpAt.resize(n);
+        chunkCarried.assign((n + CHUNK - 1) / CHUNK, 0);
+    }
+
+    // Walker i's columns to and from the Walker the rules work on
+    void Load(int i, Walker& w) const {
+        w.currentState = (State)state[i];
+        w.currentFrameIndex = frame[i];
+        w.lastFrameTime = frameTime[i];
+        w.lastStateChangeTime = stateTime[i];
+        w.posX = posX[i];
+        w.posY = posY[i];
+        w.velY = velY[i];
+        w.facingRight = facingRight[i] != 0;
+        w.targetX = targetX[i];
+        w.targetY = targetY[i];
+        w.supportSpan = supportSpan[i];
+        w.carryWindow = carryWindow[i];
+        w.moveStarted = moveStarted[i] != 0;
+        w.moveStartTime = moveStart[i];
+        w.moveX = moveX[i];
+        w.moveY = moveY[i];
+        w.moveVel = moveVel[i];
+        w.walkRemainder = walkRemainder[i];
+        w.carryIndex = carryIndex[i];
+        w.carryLeft = carryLeft[i];
+        w.carryTop = carryTop[i];
+        w.carryWidth = carryWidth[i];
+        w.behaviourAt = behaviourAt[i];
+        w.jumpAt = jumpAt[i];
+    }
+
+    void Store(int i, const Walker& w) {
+        state[i] = (unsigned char)w.currentState;
+        frame[i] = w.currentFrameIndex;
+        frameTime[i] = w.lastFrameTime;
+        stateTime[i] = w.lastStateChangeTime;
+        posX[i] = w.posX;
+        posY[i] = w.posY;
+        velY[i] = w.velY;
+        facingRight[i] = (unsigned char)w.facingRight;
+        targetX[i] = w.targetX;
+        targetY[i] = w.targetY;
+        supportSpan[i] = w.supportSpan;
+        carryWindow[i] = w.carryWindow;
+        moveStarted[i] = (unsigned char)w.moveStarted;
+        moveStart[i] = w.moveStartTime;
+        moveX[i] = w.moveX;
+        moveY[i] = w.moveY;
+        moveVel[i] = w.moveVel;
+        walkRemainder[i] = w.walkRemainder;
+        carryIndex[i] = w.carryIndex;
+        carryLeft[i] = w.carryLeft;
+        carryTop[i] = w.carryTop;
+        carryWidth[i] = w.carryWidth;
+        behaviourAt[i] = w.behaviourAt;
+        jumpAt[i] = w.jumpAt;
+    }
+
+    void StartWorkers() {
+        while ((int)workers.size() < threadCount - 1) {
+            workers.emplace_back([this]() {
+                unsigned long long seen = 0;
+                while (true) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        startCv.wait(lock, [&]() { return quit || job != seen; });
+                        if (quit) return;
+                        seen = job;
+                    }
+                    Work();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (--busy == 0) doneCv.notify_one();
+                }
+            });
+        }
+    }
+
+    // Take chunks until there are none left
+    void Work() {
+        while (true) {
+            int c = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunkCount) return;
+            UpdateChunk(c);
+        }
+    }
+
+    // A chunk's walkers, gathered. The ones on the ground find their support
+    // one by one, then ask whether their head is covered as one batch against
+    // the window table, then take their ground step.
+    struct ChunkScratch {
+        Walker walkers[CHUNK];
+        GroundContact contact[CHUNK];
+        uint8_t onGround[CHUNK];
+        int probe;                  // Head probes so far
+        int x[CHUNK], y[CHUNK], limit[CHUNK];
+        uint8_t covered[CHUNK];
+    };
+
+    void UpdateChunk(int c) {
+        int begin = c * CHUNK;
+        int end = begin + CHUNK;
+        if (end > Count()) end = Count();
+        const Simulation& world = *tickWorld;
+        unsigned long long now = tickNow;
+        unsigned long long carried = 0;
+
+        ChunkScratch g;
+        g.probe = 0;
+        for (int i = begin; i < end; i++) {
+            int k = i - begin;
+            Walker& w = g.walkers[k];
+            Load(i, w);
+            g.onGround[k] = !MoveInAir(w, rng[i], world, now);
+            if (!g.onGround[k]) continue;
+            bool moved;
+            bool predicted = CarryWalker(w, world, now, moved);
+            if (moved) carried++;
+            FindSupport(w, world, predicted, g.contact[k]);
+            if (!g.contact[k].supported) continue;
+            g.x[g.probe] = w.posX;
+            g.y[g.probe] = w.posY - 20;
+            g.limit[g.probe] = g.contact[k].windowIndex;
+            g.probe++;
+        }
+        world.windowTable.CoverBatch(g.x, g.y, g.limit, g.probe, g.covered);
+
+        int probe = 0;
+        for (int i = begin; i < end; i++) {
+            int k = i - begin;
+            Walker& w = g.walkers[k];
+            if (g.onGround[k]) {
+                bool covered = g.contact[k].supported && g.covered[probe++];
+                GroundStep(w, rng[i], world, g.contact[k], covered, now, tickDt);
+            }
+            bool behaviourDue = now >= w.behaviourAt, jumpDue = now >= w.jumpAt;
+            if (behaviourDue) w.behaviourAt = Walker::NEVER;
+            if (jumpDue) w.jumpAt = Walker::NEVER;
+            WalkerAI(w, rng[i], now, behaviourDue, jumpDue, [&]() {
+                PickJump(w, rng[i], world.ledgeGraph, world.ledgeGraph.LedgeAt(w.posX, w.posY), now);
+            });
+            AnimateWalker(w, animFrames[w.currentState], animSpeed[w.currentState], now);
+            Store(i, w);
+        }
+        chunkCarried[c] += carried;
+    }
+};
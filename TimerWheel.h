@@ -0,0 +1,265 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ==========================================
+//              TIMER WHEEL
+// ==========================================
+// Hierarchical timing wheel with 1 ms resolution: 4 levels of 64 slots cover
+// 64, 4096, 262144 and 16.7M ms ahead. A timer sits in the coarsest slot that
+// still tells it apart and is moved down a level each time time reaches that
+// slot. Scheduling and cancelling are O(1). The earliest deadline is cached,
+// so an Advance with nothing due is one compare and time stands still; once
+// something is, catching up costs one step per occupied level-0 slot or 64 ms,
+// and stretches longer than that many steps per pending timer are jumped over
+// by re-placing them. Deadlines further out than the top level wait in it and
+// are re-placed on every turn; ones already past wait in a list of their own
+// for the next Advance.
+
+class TimerWheel {
+public:
+    static const int LEVELS = 4;
+    static const int BITS = 6;
+    static const int SLOTS = 1 << BITS;
+    static const int MASK = SLOTS - 1;
+    static const int LATE = LEVELS * SLOTS;     // Bucket for deadlines already past
+
+    explicit TimerWheel(unsigned long long now = 0) { Reset(now); }
+
+    // Drop every timer; time starts at 'now'
+    void Reset(unsigned long long now) {
+        nodes.clear();
+        freeList.clear();
+        for (int i = 0; i <= LATE; i++) { head[i] = tail[i] = -1; }
+        for (int l = 0; l < LEVELS; l++) occupied[l] = 0;
+        current = now;
+        pending = 0;
+        earliest = ~0ull;
+        earliestValid = true;
+    }
+
+    // Fire 'tag' once time reaches 'deadline' (at the next Advance if it
+    // already has). Handles are reused once a timer fires or is cancelled.
+    int Schedule(unsigned long long deadline, int tag) {
+        int h;
+        if (!freeList.empty()) { h = freeList.back(); freeList.pop_back(); }
+        else { h = (int)nodes.size(); nodes.push_back(Node()); }
+        Node& n = nodes[h];
+        n.deadline = deadline;
+        n.tag = tag;
+        n.active = true;
+        if (earliestValid && deadline < earliest) earliest = deadline;
+        Place(h);
+        pending++;
+        return h;
+    }
+
+    void Cancel(int h) {
+        if (h < 0 || h >= (int)nodes.size() || !nodes[h].active) return;
+        if (nodes[h].deadline == earliest) earliestValid = false;
+        Unlink(h);
+        nodes[h].active = false;
+        freeList.push_back(h);
+        pending--;
+    }
+
+    // fire(tag, handle) for every timer due by 'now', earliest deadline first.
+    // Returns how many fired.
+    template <typename Fn>
+    int Advance(unsigned long long now, Fn fire) {
+        if (now < NextDeadline()) return 0;
+        earliestValid = false;
+        int fired = head[LATE] != -1 ? Fire(LATE, fire) : 0;
+        while (current <= now) {
+            if (pending == 0) { current = now + 1; break; }
+            unsigned long long ahead = occupied[0] >> (current & MASK);
+            if (!ahead) {
+                // Nothing left at level 0 this turn: go to the next slot boundary,
+                // or re-place everything when that is cheaper than stepping there
+                unsigned long long boundary = (current | MASK) + 1;
+                unsigned long long next = ScanNextDeadline();
+                unsigned long long target = next < now + 1 ? next : now + 1;
+                if (target <= boundary) MoveTo(target);
+                else if (((target - boundary) >> BITS) > (unsigned long long)pending) Rebase(target);
+                else MoveTo(boundary);
+                continue;
+            }
+            unsigned long long t = current + CountTrailingZeros(ahead);
+            if (t > now) { current = now + 1; break; }
+            Detach((int)(t & MASK));
+            firing.swap(scratch);
+            MoveTo(t + 1);
+            fired += Fire(-1, fire);
+        }
+        return fired;
+    }
+
+    // Earliest pending deadline, ~0ull if there is none
+    unsigned long long NextDeadline() const {
+        if (!earliestValid) {
+            earliest = ScanNextDeadline();
+            earliestValid = true;
+        }
+        return earliest;
+    }
+
+    int Pending() const { return pending; }
+    unsigned long long Now() const { return current; }   // Nothing before this is still pending in a slot
+
+private:
+    struct Node {
+        unsigned long long deadline = 0;
+        int tag = 0;
+        int prev = -1, next = -1;
+        int bucket = -1;
+        bool active = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> freeList;
+    std::vector<int> scratch, firing;
+    int head[LATE + 1];
+    int tail[LATE + 1];
+    uint64_t occupied[LEVELS];      // Bit per non-empty slot
+    unsigned long long current;     // Next millisecond to process
+    int pending;
+    mutable unsigned long long earliest;
+    mutable bool earliestValid;
+
+    unsigned long long ScanNextDeadline() const {
+        unsigned long long best = ~0ull;
+        if (pending == 0) return best;
+        for (int h = head[LATE]; h != -1; h = nodes[h].next) {
+            if (nodes[h].deadline < best) best = nodes[h].deadline;
+        }
+        // Level 0 holds the next 64 ms, one deadline per slot; anything due
+        // before the next boundary beats every level above
+        if (occupied[0]) {
+            unsigned long long t = current + CountTrailingZeros(Rotate(occupied[0], (int)(current & MASK)));
+            if (t < best) best = t;
+            if (t <= (current | MASK)) return best;
+        }
+        for (int l = 1; l < LEVELS; l++) {
+            // Nothing at this level or above is due before its next slot starts
+            if (best < (((current >> (BITS * l)) + 1) << (BITS * l))) break;
+            if (!occupied[l]) continue;
+            // The current slot was already moved down, so it only holds timers
+            // a whole turn away: start after it
+            int start = (int)(((current >> (BITS * l)) + 1) & MASK);
+            int slot = (start + CountTrailingZeros(Rotate(occupied[l], start))) & MASK;
+            for (int h = head[l * SLOTS + slot]; h != -1; h = nodes[h].next) {
+                if (nodes[h].deadline < best) best = nodes[h].deadline;
+            }
+        }
+        return best;
+    }
+
+    // Slot 'start' becomes bit 0
+    static uint64_t Rotate(uint64_t bits, int start) {
+        return start ? (bits >> start) | (bits << (SLOTS - start)) : bits;
+    }
+
+    static int CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return (int)index;
+#else
+        return __builtin_ctzll(mask);
+#endif
+    }
+
+    // Coarsest level the deadline still fits under, relative to 'current'
+    void Place(int h) {
+        Node& n = nodes[h];
+        if (n.deadline < current) { Link(h, LATE); return; }
+        unsigned long long d = n.deadline;
+        unsigned long long delta = d - current;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1ull << (BITS * (level + 1)))) level++;
+        // Beyond the top level: park in the slot that comes round last
+        if (delta >= (1ull << (BITS * LEVELS))) d = current;
+        int slot = (int)((d >> (BITS * level)) & MASK);
+        Link(h, level * SLOTS + slot);
+    }
+
+    void Link(int h, int bucket) {
+        Node& n = nodes[h];
+        n.bucket = bucket;
+        n.next = -1;
+        n.prev = tail[bucket];
+        if (tail[bucket] != -1) nodes[tail[bucket]].next = h;
+        else head[bucket] = h;
+        tail[bucket] = h;
+        if (bucket != LATE) occupied[bucket / SLOTS] |= 1ull << (bucket & MASK);
+    }
+
+    void Unlink(int h) {
+        Node& n = nodes[h];
+        int b = n.bucket;
+        if (n.prev != -1) nodes[n.prev].next = n.next; else head[b] = n.next;
+        if (n.next != -1) nodes[n.next].prev = n.prev; else tail[b] = n.prev;
+        if (head[b] == -1 && b != LATE) occupied[b / SLOTS] &= ~(1ull << (b & MASK));
+        n.bucket = -1;
+    }
+
+    // Take a bucket's timers out, in order
+    void Detach(int bucket) {
+        scratch.clear();
+        for (int h = head[bucket]; h != -1; h = nodes[h].next) scratch.push_back(h);
+        head[bucket] = tail[bucket] = -1;
+        if (bucket != LATE) occupied[bucket / SLOTS] &= ~(1ull << (bucket & MASK));
+    }
+
+    // Fire a bucket (-1: the slot already moved to 'firing', time stepped past it).
+    // Callbacks may schedule or cancel, so they see a settled wheel; the fired
+    // handles are only handed out again afterwards.
+    template <typename Fn>
+    int Fire(int bucket, Fn& fire) {
+        if (bucket != -1) {
+            Detach(bucket);
+            firing.swap(scratch);
+        }
+        if (bucket == LATE) {
+            std::sort(firing.begin(), firing.end(), [this](int a, int b) { return nodes[a].deadline < nodes[b].deadline; });
+        }
+        int count = (int)firing.size();
+        for (int h : firing) {
+            nodes[h].active = false;
+            nodes[h].bucket = -1;
+            pending--;
+        }
+        for (int h : firing) fire(nodes[h].tag, h);
+        for (int h : firing) freeList.push_back(h);
+        return count;
+    }
+
+    // Step to 'to' (at most the next level-0 boundary); crossing a boundary
+    // moves the higher levels' slots for the new time down
+    void MoveTo(unsigned long long to) {
+        current = to;
+        for (int l = 1; l < LEVELS; l++) {
+            if (current & ((1ull << (BITS * l)) - 1)) break;
+            int bucket = l * SLOTS + (int)((current >> (BITS * l)) & MASK);
+            if (head[bucket] == -1) continue;
+            Detach(bucket);
+            for (int h : scratch) Place(h);
+        }
+    }
+
+    // Jump straight to 'to' and re-place every pending timer from there
+    void Rebase(unsigned long long to) {
+        scratch.clear();
+        for (int b = 0; b < LEVELS * SLOTS; b++) {
+            for (int h = head[b]; h != -1; h = nodes[h].next) scratch.push_back(h);
+            head[b] = tail[b] = -1;
+        }
+        for (int l = 0; l < LEVELS; l++) occupied[l] = 0;
+        current = to;
+        for (int h : scratch) Place(h);
+    }
+};
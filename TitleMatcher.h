@@ -0,0 +1,140 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cwctype>
+#include "State.h"
+
+// ==========================================
+//          FOREGROUND TITLE MATCHER
+// ==========================================
+// Aho-Corasick automaton over all rule patterns, so one pass over a title finds
+// every rule that matches. Matching is case-insensitive. When several rules
+// match, the one listed first wins.
+
+struct TitleRule {
+    std::wstring pattern;
+    State state;
+};
+
+class TitleMatcher {
+public:
+    void Build(const std::vector<TitleRule>& newRules) {
+        rules = newRules;
+        nodes.assign(1, Node());
+
+        for (int r = 0; r < (int)rules.size(); r++) {
+            int cur = 0;
+            for (wchar_t c : rules[r].pattern) {
+                c = (wchar_t)towlower(c);
+                int next = Child(cur, c);
+                if (next == -1) {
+                    next = (int)nodes.size();
+                    nodes.push_back(Node());
+                    auto& kids = nodes[cur].children;
+                    kids.insert(std::lower_bound(kids.begin(), kids.end(), std::make_pair(c, 0)), std::make_pair(c, next));
+                }
+                cur = next;
+            }
+            if (cur != 0 && (nodes[cur].best == -1 || r < nodes[cur].best)) nodes[cur].best = r;
+        }
+
+        // BFS for failure links; fold each node's best rule with its suffix's
+        std::vector<int> queue;
+        for (auto& kid : nodes[0].children) { nodes[kid.second].fail = 0; queue.push_back(kid.second); }
+        for (size_t q = 0; q < queue.size(); q++) {
+            int u = queue[q];
+            for (auto& kid : nodes[u].children) {
+                int v = kid.second;
+                int f = nodes[u].fail;
+                while (f != 0 && Child(f, kid.first) == -1) f = nodes[f].fail;
+                int g = Child(f, kid.first);
+                nodes[v].fail = (g != -1 && g != v) ? g : 0;
+                int inherited = nodes[nodes[v].fail].best;
+                if (inherited != -1 && (nodes[v].best == -1 || inherited < nodes[v].best)) nodes[v].best = inherited;
+                queue.push_back(v);
+            }
+        }
+    }
+
+    // Index of the winning rule, or -1
+    int Match(const std::wstring& title) const {
+        int cur = 0;
+        int best = -1;
+        for (wchar_t c : title) {
+            c = (wchar_t)towlower(c);
+            int next;
+            while ((next = Child(cur, c)) == -1 && cur != 0) cur = nodes[cur].fail;
+            cur = (next == -1) ? 0 : next;
+            int b = nodes[cur].best;
+            if (b != -1 && (best == -1 || b < best)) {
+                best = b;
+                if (best == 0) break; // Can't do better than the first rule
+            }
+        }
+        return best;
+    }
+
+    const TitleRule& Rule(int index) const { return rules[index]; }
+    size_t RuleCount() const { return rules.size(); }
+
+private:
+    struct Node {
+        std::vector<std::pair<wchar_t, int>> children;  // Sorted by character
+        int fail = 0;
+        int best = -1;                                  // Lowest rule index ending here (incl. suffixes)
+    };
+    std::vector<Node> nodes;
+    std::vector<TitleRule> rules;
+
+    int Child(int node, wchar_t c) const {
+        const auto& kids = nodes[node].children;
+        auto it = std::lower_bound(kids.begin(), kids.end(), std::make_pair(c, 0));
+        if (it != kids.end() && it->first == c) return it->second;
+        return -1;
+    }
+};
+
+// --- RULE FILE ---
+// One rule per line: "pattern = STATE". Blank lines and '#' comments are ignored.
+// Unknown state names skip the line.
+inline bool ParseStateName(const std::wstring& name, State& out) {
+    for (int s = 0; s < STATE_COUNT; s++) {
+        if (GetStateName((State)s) == name) { out = (State)s; return true; }
+    }
+    return false;
+}
+
+inline std::vector<TitleRule> ParseTitleRules(const std::wstring& text) {
+    std::vector<TitleRule> rules;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(L'\n', pos);
+        if (end == std::wstring::npos) end = text.size();
+        std::wstring line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t hash = line.find(L'#');
+        if (hash != std::wstring::npos) line.erase(hash);
+        size_t eq = line.rfind(L'=');
+        if (eq == std::wstring::npos) continue;
+
+        auto trim = [](std::wstring s) {
+            size_t a = s.find_first_not_of(L" \t\r");
+            size_t b = s.find_last_not_of(L" \t\r");
+            return (a == std::wstring::npos) ? std::wstring() : s.substr(a, b - a + 1);
+        };
+        std::wstring pattern = trim(line.substr(0, eq));
+        std::wstring stateName = trim(line.substr(eq + 1));
+        for (auto& c : stateName) c = (wchar_t)towupper(c);
+
+        State state;
+        if (pattern.empty() || !ParseStateName(stateName, state)) continue;
+        rules.push_back({ pattern, state });
+    }
+    return rules;
+}
+
+inline std::vector<TitleRule> DefaultTitleRules() {
+    return { { L"youtube", WATCHING_MOVIE }, { L"netflix", WATCHING_MOVIE } };
+}
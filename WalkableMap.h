@@ -0,0 +1,305 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cmath>
+#include "Environment.h"
+
+// ==========================================
+//            WALKABLE SEGMENTS
+// ==========================================
+// Every visible stretch of every window top (the top edge minus whatever sits
+// above it in z-order), grouped into rows by height and sorted by x. Spans in
+// one row never overlap: where two tops share a height, the upper window's
+// span cut a hole in the lower one. Monitor floors are kept separately.
+// Built once per snapshot change; support, landing and "where does this
+// ledge end" are then binary searches instead of scans over every window.
+// When only a few windows changed, spans of windows whose top edge none of
+// them touches are carried over, and LedgeGraph reuses the same diff.
+
+struct WalkSpan {
+    long left, right;   // Inclusive, same closed-rect rules as the occlusion checks
+    long y;
+    int windowIndex;    // Index into the snapshot, -1 for a monitor floor
+};
+
+class WalkableMap {
+public:
+    std::vector<WalkSpan> spans;    // Window order (z-order), then left to right
+    std::vector<WalkSpan> floors;   // One per monitor
+    unsigned long long generation = 0;
+    unsigned long long builds = 0;  // Bumps on every Build, so users can tell they saw the previous one
+
+    unsigned long long fullBuilds = 0;
+    unsigned long long windowsReused = 0;
+
+    void Build(const std::vector<RectArea>& windows, const std::vector<RectArea>& monitors, unsigned long long gen) {
+        generation = gen;
+        builds++;
+        int n = (int)windows.size();
+        patched = builds > 1 && SameRects(monitors, prevMonitors) && Diff(windows);
+        if (!patched) {
+            fullBuilds++;
+            previous.assign(n, -1);
+            touched.assign(n, 1);
+        }
+
+        oldSpans.swap(spans);
+        oldFirst.swap(windowFirst);
+        spans.clear();
+        windowFirst.assign(n + 1, 0);
+        windowLeft.resize(n);
+        windowRight.resize(n);
+
+        BuildBands(windows);
+        for (int i = 0; i < n; i++) {
+            windowFirst[i] = (int)spans.size();
+            windowLeft[i] = windows[i].left;
+            windowRight[i] = windows[i].right;
+            if (touched[i]) {
+                VisibleSpans(windows, i);
+            } else {
+                int j = previous[i];
+                for (int k = oldFirst[j]; k < oldFirst[j + 1]; k++) {
+                    spans.push_back(oldSpans[k]);
+                    spans.back().windowIndex = i;
+                }
+                windowsReused++;
+            }
+        }
+        windowFirst[n] = (int)spans.size();
+        prevWindows = windows;
+        prevMonitors = monitors;
+
+        floors.clear();
+        for (const auto& mon : monitors) floors.push_back({ mon.left, mon.right, mon.bottom, -1 });
+
+        // Row index: span ids sorted by (y, left), plus where each height starts
+        order.resize(spans.size());
+        for (size_t i = 0; i < spans.size(); i++) order[i] = (int)i;
+        std::sort(order.begin(), order.end(), [this](int a, int b) {
+            if (spans[a].y != spans[b].y) return spans[a].y < spans[b].y;
+            return spans[a].left < spans[b].left;
+        });
+        rowY.clear();
+        rowStart.clear();
+        for (int k = 0; k < (int)order.size(); k++) {
+            if (rowY.empty() || spans[order[k]].y != rowY.back()) {
+                rowY.push_back(spans[order[k]].y);
+                rowStart.push_back(k);
+            }
+        }
+        rowStart.push_back((int)order.size());
+    }
+
+    // Spans of window i, left to right: ids [WindowBegin(i), WindowEnd(i))
+    int WindowBegin(int i) const { return windowFirst[i]; }
+    int WindowEnd(int i) const { return windowFirst[i + 1]; }
+
+    // Diff against the previous build. Only meaningful when Patched(): window i
+    // was window PreviousIndex(i) last time (-1 if new or moved), and unless
+    // Touched(i) its spans are the same as they were then.
+    bool Patched() const { return patched; }
+    int PreviousIndex(int i) const { return previous[i]; }
+    bool Touched(int i) const { return touched[i] != 0; }
+
+    // Span at exactly height y that contains x, or -1
+    int SpanAt(int x, long y) const {
+        auto row = std::lower_bound(rowY.begin(), rowY.end(), y);
+        if (row == rowY.end() || *row != y) return -1;
+        return FindInRow((int)(row - rowY.begin()), x);
+    }
+
+    // Topmost (lowest z-index) window whose visible top lies in [yMin, yMax]
+    // under x, with x at least 'inset' inside the window's sides. Returns the
+    // span id, or -1. Same answer as scanning every window in z-order.
+    int WindowSupport(int x, long yMin, long yMax, int inset = 0) const {
+        int best = -1;
+        for (int r = (int)(std::lower_bound(rowY.begin(), rowY.end(), yMin) - rowY.begin());
+             r < (int)rowY.size() && rowY[r] <= yMax; r++) {
+            int id = FindInRow(r, x);
+            if (id == -1) continue;
+            int w = spans[id].windowIndex;
+            if (x < windowLeft[w] + inset || x > windowRight[w] - inset) continue;
+            if (best == -1 || w < spans[best].windowIndex) best = id;
+        }
+        return best;
+    }
+
+    // Highest visible top (smallest y) in [yMin, yMax] under x, with x at least
+    // 'inset' inside the window's sides: the first one something moving down
+    // through that range meets. Returns the span id, or -1.
+    int FirstSupport(int x, long yMin, long yMax, int inset = 0) const {
+        for (int r = (int)(std::lower_bound(rowY.begin(), rowY.end(), yMin) - rowY.begin());
+             r < (int)rowY.size() && rowY[r] <= yMax; r++) {
+            int id = FindInRow(r, x);
+            if (id == -1) continue;
+            int w = spans[id].windowIndex;
+            if (x < windowLeft[w] + inset || x > windowRight[w] - inset) continue;
+            return id;
+        }
+        return -1;
+    }
+
+private:
+    static const int MAX_BANDS = 256;
+
+    bool patched = false;
+    std::vector<RectArea> prevWindows;
+    std::vector<RectArea> prevMonitors;
+    std::vector<int> previous;      // Per window: index in prevWindows, -1 if new/moved
+    std::vector<char> touched;      // Per window: spans recomputed this build
+    std::vector<RectArea> dirty;    // New, moved and closed rects of the last diff
+    std::vector<WalkSpan> oldSpans;
+    std::vector<int> oldFirst;
+
+    std::vector<int> windowFirst;   // CSR offsets into spans, n + 1
+    std::vector<long> windowLeft;
+    std::vector<long> windowRight;
+    std::vector<int> order;         // Span ids sorted by (y, left)
+    std::vector<long> rowY;         // Distinct heights, ascending
+    std::vector<int> rowStart;      // CSR offsets into order, rows + 1
+
+    // Horizontal bands listing the windows whose rect crosses them, in z-order,
+    // so finding what covers a top edge only looks at windows near that height
+    std::vector<int> bandStart;
+    std::vector<int> bandItems;
+    std::vector<int> fill;
+    std::vector<std::pair<long, long>> cover;
+    long bandMinY = 0, bandH = 1;
+    int bands = 0;
+
+    static bool SameRect(const RectArea& a, const RectArea& b) {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+    static bool SameRects(const std::vector<RectArea>& a, const std::vector<RectArea>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) if (!SameRect(a[i], b[i])) return false;
+        return true;
+    }
+    static std::tuple<long, long, long, long> Key(const RectArea& r) {
+        return std::make_tuple(r.left, r.top, r.right, r.bottom);
+    }
+
+    // Match windows to the previous snapshot by rect and mark every window whose
+    // top edge a new, moved or closed window touches. Returns false when a full
+    // build is the better (or only correct) option.
+    bool Diff(const std::vector<RectArea>& windows) {
+        previous.assign(windows.size(), -1);
+        dirty.clear();
+
+        // Same count and z-order (a drag or resize): compare slot by slot
+        if (windows.size() == prevWindows.size()) {
+            for (int i = 0; i < (int)windows.size(); i++) {
+                if (SameRect(windows[i], prevWindows[i])) { previous[i] = i; continue; }
+                dirty.push_back(windows[i]);
+                dirty.push_back(prevWindows[i]);
+            }
+            if (dirty.size() * 2 <= windows.size() + 1) return MarkTouched(windows);
+            previous.assign(windows.size(), -1);
+            dirty.clear();
+        }
+
+        // Otherwise match survivors by rect
+        std::map<std::tuple<long, long, long, long>, std::vector<int>> oldByRect;
+        for (int j = (int)prevWindows.size() - 1; j >= 0; j--) oldByRect[Key(prevWindows[j])].push_back(j);
+
+        std::vector<char> oldSurvives(prevWindows.size(), 0);
+        for (int i = 0; i < (int)windows.size(); i++) {
+            auto it = oldByRect.find(Key(windows[i]));
+            if (it != oldByRect.end() && !it->second.empty()) {
+                previous[i] = it->second.back();
+                oldSurvives[previous[i]] = 1;
+                it->second.pop_back();
+            } else {
+                dirty.push_back(windows[i]);
+            }
+        }
+        for (int j = 0; j < (int)prevWindows.size(); j++) if (!oldSurvives[j]) dirty.push_back(prevWindows[j]);
+
+        // Survivors must keep their relative z-order, otherwise coverage changed everywhere
+        int lastOld = -1;
+        for (int i = 0; i < (int)windows.size(); i++) {
+            if (previous[i] == -1) continue;
+            if (previous[i] < lastOld) return false;
+            lastOld = previous[i];
+        }
+        if (dirty.size() * 2 > windows.size() + 1) return false;
+        return MarkTouched(windows);
+    }
+
+    bool MarkTouched(const std::vector<RectArea>& windows) {
+        touched.assign(windows.size(), 0);
+        for (int i = 0; i < (int)windows.size(); i++) {
+            const RectArea& w = windows[i];
+            bool t = (previous[i] == -1);
+            for (size_t d = 0; d < dirty.size() && !t; d++) {
+                const RectArea& r = dirty[d];
+                if (w.top >= r.top && w.top <= r.bottom && r.left <= w.right && r.right >= w.left) t = true;
+            }
+            touched[i] = t ? 1 : 0;
+        }
+        return true;
+    }
+
+    int FindInRow(int r, int x) const {
+        // Last span in the row starting at or before x
+        auto first = order.begin() + rowStart[r];
+        auto last = order.begin() + rowStart[r + 1];
+        auto it = std::upper_bound(first, last, (long)x, [this](long v, int id) { return v < spans[id].left; });
+        if (it == first) return -1;
+        int id = *(it - 1);
+        return (x <= spans[id].right) ? id : -1;
+    }
+
+    void BuildBands(const std::vector<RectArea>& windows) {
+        int n = (int)windows.size();
+        if (n == 0) { bands = 0; bandStart.assign(1, 0); bandItems.clear(); return; }
+        bandMinY = windows[0].top;
+        long maxY = windows[0].bottom;
+        for (const auto& r : windows) {
+            if (r.top < bandMinY) bandMinY = r.top;
+            if (r.bottom > maxY) maxY = r.bottom;
+        }
+        bands = (int)std::sqrt((double)n) * 2;
+        if (bands < 1) bands = 1;
+        if (bands > MAX_BANDS) bands = MAX_BANDS;
+        bandH = (maxY - bandMinY) / bands + 1;
+
+        bandStart.assign(bands + 1, 0);
+        for (const auto& r : windows)
+            for (int b = Band(r.top); b <= Band(r.bottom); b++) bandStart[b + 1]++;
+        for (int b = 0; b < bands; b++) bandStart[b + 1] += bandStart[b];
+        bandItems.resize(bandStart[bands]);
+        fill.assign(bandStart.begin(), bandStart.end() - 1);
+        for (int i = 0; i < n; i++)
+            for (int b = Band(windows[i].top); b <= Band(windows[i].bottom); b++) bandItems[fill[b]++] = i;
+    }
+
+    int Band(long y) const { return (int)((y - bandMinY) / bandH); }
+
+    // Top edge of window i minus the parts covered by windows above it
+    void VisibleSpans(const std::vector<RectArea>& windows, int i) {
+        const RectArea& w = windows[i];
+        cover.clear();
+        int b = Band(w.top);
+        for (int k = bandStart[b]; k < bandStart[b + 1]; k++) {
+            int j = bandItems[k];
+            if (j >= i) break;   // Band lists are in z-order: nothing further is above us
+            const RectArea& c = windows[j];
+            if (w.top < c.top || w.top > c.bottom) continue;
+            if (c.right < w.left || c.left > w.right) continue;
+            cover.push_back(std::make_pair(c.left, c.right));
+        }
+        std::sort(cover.begin(), cover.end());
+
+        long x = w.left;
+        for (const auto& c : cover) {
+            if (c.first > x) spans.push_back({ x, c.first - 1, w.top, i });
+            if (c.second + 1 > x) x = c.second + 1;
+            if (x > w.right) return;
+        }
+        if (x <= w.right) spans.push_back({ x, w.right, w.top, i });
+    }
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include "Config.h"
+#include "Environment.h"
+
+// ==========================================
+//          WINDOW SNAPSHOT CACHE
+// ==========================================
+// Holds the last window enumeration and only re-enumerates after the platform
+// reports a topology event (create/destroy/move/z-order/minimize). Consumers
+// compare 'generation' to know whether the snapshot actually changed.
+
+enum WindowEventType {
+    WINDOW_CREATED, WINDOW_DESTROYED, WINDOW_SHOWN, WINDOW_HIDDEN,
+    WINDOW_MOVED, WINDOW_ZORDER, WINDOW_MINIMIZED, WINDOW_RESTORED
+};
+
+class WindowCache {
+public:
+    unsigned long long generation = 0;          // Bumps only when the rect list differs
+    unsigned long long enumerations = 0;
+    unsigned long long avoidedEnumerations = 0;
+    unsigned long long eventsReceived = 0;
+
+    void OnWindowEvent(WindowEventType type) {
+        (void)type;
+        dirty = true;
+        eventsReceived++;
+    }
+
+    void Invalidate() { dirty = true; }
+
+    // For platforms that can't deliver events: behave like the old per-tick enumeration
+    void SetAlwaysRefresh(bool on) { alwaysRefresh = on; }
+
+    // Re-enumerates into 'snapshot' if an event arrived (or the resync age expired).
+    // 'ids' gets the platform's window ids on every enumeration ('enumerations'
+    // tells when one happened). Returns true if the rects changed.
+    bool Refresh(EnvironmentProvider& env, unsigned long long now, std::vector<RectArea>& snapshot, std::vector<WindowId>& ids) {
+        if (!dirty && !alwaysRefresh && now - lastEnumTime < (unsigned long long)Config::SNAPSHOT_RESYNC_MS) {
+            avoidedEnumerations++;
+            return false;
+        }
+        dirty = false;
+        lastEnumTime = now;
+        enumerations++;
+
+        env.GetWindows(scratch);
+        env.GetWindowIds(ids);
+        if (SameRects(scratch, snapshot)) return false;
+        snapshot.swap(scratch);
+        generation++;
+        return true;
+    }
+
+private:
+    bool dirty = true;
+    bool alwaysRefresh = false;
+    unsigned long long lastEnumTime = 0;
+    std::vector<RectArea> scratch;
+
+    static bool SameRects(const std::vector<RectArea>& a, const std::vector<RectArea>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].left != b[i].left || a[i].top != b[i].top ||
+                a[i].right != b[i].right || a[i].bottom != b[i].bottom) return false;
+        }
+        return true;
+    }
+};
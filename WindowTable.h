@@ -0,0 +1,262 @@
+#pragma once
+#include <vector>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include "Environment.h"
+#include "PixelKernels.h"
+
+// ==========================================
+//              WINDOW TABLE
+// ==========================================
+// The window snapshot as columns (left/top/right/bottom/index), for questions
+// asked about many points at once: head probes, foot probes, jump targets, a
+// whole swarm. Like SpatialIndex the rects are bucketed into a uniform grid,
+// but each cell holds its own copy of the columns, in z-order and padded to a
+// multiple of 8 with rects that contain nothing, so a probe compares 8 windows
+// at a time with no indirection and stops at the first (topmost) hit.
+// Answers are the same as SpatialIndex::TopmostAt and WalkableMap::WindowSupport;
+// the AVX2 path is picked at runtime like the pixel kernels, scalar otherwise.
+
+class WindowTable {
+public:
+    unsigned long long generation = 0;   // Snapshot generation this was built from
+
+    void Build(const std::vector<RectArea>& windows, unsigned long long gen) {
+        generation = gen;
+        count = (int)windows.size();
+        if (count == 0) { cols = rows = 0; cellStart.assign(1, 0); Resize(0); return; }
+
+        minX = windows[0].left; minY = windows[0].top;
+        maxX = windows[0].right; maxY = windows[0].bottom;
+        for (const auto& r : windows) {
+            if (r.left < minX) minX = r.left;
+            if (r.top < minY) minY = r.top;
+            if (r.right > maxX) maxX = r.right;
+            if (r.bottom > maxY) maxY = r.bottom;
+        }
+        int dim = (int)std::sqrt((double)count) * 2;
+        if (dim < 1) dim = 1;
+        if (dim > MAX_DIM) dim = MAX_DIM;
+        cols = rows = dim;
+        // Power-of-two cells, so finding one is two shifts instead of two divides
+        shiftX = Log2Ceil((maxX - minX) / cols + 1);
+        shiftY = Log2Ceil((maxY - minY) / rows + 1);
+        cols = (int)((maxX - minX) >> shiftX) + 1;
+        rows = (int)((maxY - minY) >> shiftY) + 1;
+
+        // Count, pad each cell to a multiple of 8, then fill in z-order
+        std::vector<int> used(cols * rows, 0);
+        for (const auto& r : windows) {
+            int c0, r0, c1, r1;
+            CellRange(r, c0, r0, c1, r1);
+            for (int cy = r0; cy <= r1; cy++)
+                for (int cx = c0; cx <= c1; cx++) used[cy * cols + cx]++;
+        }
+        cellStart.assign(cols * rows + 1, 0);
+        for (int c = 0; c < cols * rows; c++) cellStart[c + 1] = cellStart[c] + ((used[c] + 7) & ~7);
+        Resize(cellStart[cols * rows]);
+
+        for (int c = 0; c < cols * rows; c++) used[c] = cellStart[c];
+        for (int i = 0; i < count; i++) {
+            int c0, r0, c1, r1;
+            CellRange(windows[i], c0, r0, c1, r1);
+            for (int cy = r0; cy <= r1; cy++) {
+                for (int cx = c0; cx <= c1; cx++) {
+                    int k = used[cy * cols + cx]++;
+                    left[k] = (int32_t)windows[i].left;
+                    top[k] = (int32_t)windows[i].top;
+                    right[k] = (int32_t)windows[i].right;
+                    bottom[k] = (int32_t)windows[i].bottom;
+                    index[k] = i;
+                }
+            }
+        }
+    }
+
+    int Count() const { return count; }
+
+    // out[k] = topmost window containing (xs[k], ys[k]) with index < limits[k]
+    // (-1 = any window; null 'limits' means -1 for all), or -1
+    void TopmostBatch(const int* xs, const int* ys, const int* limits, int n, int* out,
+                      PixelKernels::Isa isa = PixelKernels::BestIsa()) const {
+#if defined(PIXEL_KERNELS_X86)
+        if (isa == PixelKernels::ISA_AVX2) {
+            TopmostBatchAvx2(xs, ys, limits, n, out);
+            return;
+        }
+#endif
+        (void)isa;
+        for (int k = 0; k < n; k++) out[k] = TopmostScalar(xs[k], ys[k], Limit(limits ? limits[k] : -1));
+    }
+
+    // covered[k] = 1 if a window with index < limits[k] covers the point (IsPointObscured)
+    void CoverBatch(const int* xs, const int* ys, const int* limits, int n, uint8_t* covered,
+                    PixelKernels::Isa isa = PixelKernels::BestIsa()) const {
+        const int STEP = 64;
+        int tmp[STEP];
+        for (int k = 0; k < n; k += STEP) {
+            int m = (n - k < STEP) ? n - k : STEP;
+            TopmostBatch(xs + k, ys + k, limits ? limits + k : nullptr, m, tmp, isa);
+            for (int j = 0; j < m; j++) covered[k + j] = (uint8_t)(tmp[j] != -1);
+        }
+    }
+
+    // out[k] = topmost window whose visible top lies in [yMins[k], yMaxs[k]]
+    // under xs[k], with xs[k] at least 'inset' inside its sides, or -1.
+    // A window index, not a span id; otherwise WalkableMap::WindowSupport.
+    void SupportBatch(const int* xs, const int* yMins, const int* yMaxs, int n, int inset, int* out,
+                      PixelKernels::Isa isa = PixelKernels::BestIsa()) const {
+#if defined(PIXEL_KERNELS_X86)
+        if (isa == PixelKernels::ISA_AVX2) {
+            SupportBatchAvx2(xs, yMins, yMaxs, n, inset, out);
+            return;
+        }
+#endif
+        (void)isa;
+        for (int k = 0; k < n; k++) out[k] = SupportScalar(xs[k], yMins[k], yMaxs[k], inset);
+    }
+
+private:
+    static const int MAX_DIM = 128;
+
+    int count = 0;
+    std::vector<int> cellStart;                 // Offsets into the columns, cols*rows + 1
+    std::vector<int32_t> left, top, right, bottom;
+    std::vector<int32_t> index;                 // Window index per entry, INT_MAX for padding
+    int cols = 0, rows = 0;
+    long minX = 0, minY = 0, maxX = 0, maxY = 0;
+    int shiftX = 0, shiftY = 0;     // Cell size is 1 << shift
+
+    static int Log2Ceil(long v) {
+        int s = 0;
+        while ((1l << s) < v) s++;
+        return s;
+    }
+
+    void Resize(int n) {
+        left.assign(n, INT_MAX);
+        top.assign(n, INT_MAX);
+        right.assign(n, INT_MIN);
+        bottom.assign(n, INT_MIN);
+        index.assign(n, INT_MAX);
+    }
+
+    int Limit(int limit) const { return (limit < 0 || limit > count) ? count : limit; }
+
+    void CellRange(const RectArea& r, int& c0, int& r0, int& c1, int& r1) const {
+        c0 = (int)((r.left - minX) >> shiftX);
+        r0 = (int)((r.top - minY) >> shiftY);
+        c1 = (int)((r.right - minX) >> shiftX);
+        r1 = (int)((r.bottom - minY) >> shiftY);
+    }
+
+    // Cell holding the point, or -1 off the grid
+    int CellAt(int x, int y) const {
+        if (cols == 0 || x < minX || y < minY || x > maxX || y > maxY) return -1;
+        return (int)((y - minY) >> shiftY) * cols + (int)((x - minX) >> shiftX);
+    }
+
+    // Cells in x's column that a top edge between yMin and yMax could be in
+    bool CellColumn(int x, int yMin, int yMax, int& first, int& last) const {
+        if (cols == 0 || x < minX || x > maxX || yMax < minY || yMin > maxY) return false;
+        int cx = (int)((x - minX) >> shiftX);
+        int r0 = (int)(((yMin > minY ? yMin : minY) - minY) >> shiftY);
+        int r1 = (int)(((yMax < maxY ? yMax : maxY) - minY) >> shiftY);
+        first = r0 * cols + cx;
+        last = r1 * cols + cx;
+        return true;
+    }
+
+    int TopmostScalar(int x, int y, int limit) const {
+        int cell = CellAt(x, y);
+        if (cell == -1) return -1;
+        for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+            if (x >= left[k] && x <= right[k] && y >= top[k] && y <= bottom[k]) return index[k] < limit ? index[k] : -1;
+        }
+        return -1;
+    }
+
+    int SupportScalar(int x, int yMin, int yMax, int inset) const {
+        int first, last;
+        if (!CellColumn(x, yMin, yMax, first, last)) return -1;
+        int best = INT_MAX;
+        for (int cell = first; cell <= last; cell += cols) {
+            for (int k = cellStart[cell]; k < cellStart[cell + 1] && index[k] < best; k++) {
+                if (top[k] < yMin || top[k] > yMax) continue;
+                if (x < left[k] + inset || x > right[k] - inset) continue;
+                // Only the visible part of the top counts
+                if (TopmostScalar(x, top[k], index[k]) == -1) { best = index[k]; break; }
+            }
+        }
+        return best == INT_MAX ? -1 : best;
+    }
+
+#if defined(PIXEL_KERNELS_X86)
+    // Whole batches in one AVX2 function, so the per-point probes inline
+    PIXEL_KERNELS_AVX2 void TopmostBatchAvx2(const int* xs, const int* ys, const int* limits, int n, int* out) const {
+        for (int k = 0; k < n; k++) out[k] = TopmostAvx2(xs[k], ys[k], Limit(limits ? limits[k] : -1));
+    }
+
+    PIXEL_KERNELS_AVX2 void SupportBatchAvx2(const int* xs, const int* yMins, const int* yMaxs, int n, int inset, int* out) const {
+        for (int k = 0; k < n; k++) out[k] = SupportAvx2(xs[k], yMins[k], yMaxs[k], inset);
+    }
+
+    PIXEL_KERNELS_AVX2 int TopmostAvx2(int x, int y, int limit) const {
+        int cell = CellAt(x, y);
+        if (cell == -1) return -1;
+        __m256i vx = _mm256_set1_epi32(x), vy = _mm256_set1_epi32(y);
+        for (int k = cellStart[cell]; k < cellStart[cell + 1]; k += 8) {
+            __m256i out = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&left[k]), vx),
+                                _mm256_cmpgt_epi32(vx, _mm256_loadu_si256((const __m256i*)&right[k]))),
+                _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&top[k]), vy),
+                                _mm256_cmpgt_epi32(vy, _mm256_loadu_si256((const __m256i*)&bottom[k]))));
+            int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF;
+            if (mask) {
+                int hit = index[k + CountTrailingZeros(mask)];
+                return hit < limit ? hit : -1;
+            }
+        }
+        return -1;
+    }
+
+    PIXEL_KERNELS_AVX2 int SupportAvx2(int x, int yMin, int yMax, int inset) const {
+        int first, last;
+        if (!CellColumn(x, yMin, yMax, first, last)) return -1;
+        // top in [yMin, yMax] and left + inset <= x <= right - inset, i.e.
+        // x - inset >= left and x + inset <= right (no overflow on padding)
+        __m256i lo = _mm256_set1_epi32(yMin - 1), hi = _mm256_set1_epi32(yMax + 1);
+        __m256i xl = _mm256_set1_epi32(x - inset), xr = _mm256_set1_epi32(x + inset);
+        int best = INT_MAX;
+        for (int cell = first; cell <= last; cell += cols) {
+            for (int k = cellStart[cell]; k < cellStart[cell + 1] && index[k] < best; k += 8) {
+                __m256i t = _mm256_loadu_si256((const __m256i*)&top[k]);
+                __m256i in = _mm256_and_si256(_mm256_cmpgt_epi32(t, lo), _mm256_cmpgt_epi32(hi, t));
+                __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&left[k]), xl),
+                                              _mm256_cmpgt_epi32(xr, _mm256_loadu_si256((const __m256i*)&right[k])));
+                int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(out, in)));
+                bool found = false;
+                while (mask) {
+                    int c = k + CountTrailingZeros(mask);
+                    mask &= mask - 1;
+                    if (index[c] >= best) break;
+                    if (TopmostAvx2(x, top[c], index[c]) == -1) { best = index[c]; found = true; break; }
+                }
+                if (found) break;
+            }
+        }
+        return best == INT_MAX ? -1 : best;
+    }
+
+    static int CountTrailingZeros(int mask) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, (unsigned long)mask);
+        return (int)idx;
+#else
+        return __builtin_ctz((unsigned)mask);
+#endif
+    }
+#endif
+};
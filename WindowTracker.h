@@ -0,0 +1,175 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <cmath>
+#include "Config.h"
+#include "Environment.h"
+
+// ==========================================
+//              WINDOW TRACKER
+// ==========================================
+// Gives every window in the snapshot an id that survives moves, resizes and
+// z-order changes, plus how far and how fast it moved across the last
+// enumerations. Ids are the platform's (HWND) when it has them; without, a
+// window is matched to the previous snapshot by identical rect, then by same
+// z-slot and size (what a drag keeps). Finding an id again is O(1): its last
+// index is tried first, then a small open-addressed table.
+
+struct WindowMotion {
+    long dx = 0, dy = 0;                // Top-left moved by this much at the last enumeration
+    float velX = 0, velY = 0;           // px per ms, smoothed; 0 as soon as it is seen at rest
+    unsigned long long seenAt = 0;      // Last enumeration
+};
+
+class WindowTracker {
+public:
+    std::vector<WindowId> ids;          // Parallel to the snapshot
+    std::vector<WindowMotion> motion;   // Same
+    unsigned long long matchedByShape = 0;  // Id-less windows recognised after they moved
+
+    // After every enumeration, changed or not. 'platformIds' may be empty.
+    void Update(const std::vector<RectArea>& rects, const std::vector<WindowId>& platformIds, unsigned long long now) {
+        prevIds.swap(ids);
+        prevMotion.swap(motion);
+        prevRects.swap(lastRects);
+        std::swap(prevTable, table);
+        size_t n = rects.size();
+        ids.assign(n, 0);
+        motion.assign(n, WindowMotion());
+        match.assign(n, -1);
+
+        if (platformIds.size() == n) {
+            for (size_t i = 0; i < n; i++) {
+                ids[i] = platformIds[i];
+                match[i] = prevTable.Find(prevIds, ids[i], (int)i);
+            }
+        } else {
+            MatchByShape(rects);
+            for (size_t i = 0; i < n; i++) ids[i] = match[i] != -1 ? prevIds[match[i]] : SYNTHETIC | nextId++;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            WindowMotion& m = motion[i];
+            m.seenAt = now;
+            int j = match[i];
+            if (j == -1) continue;
+            const WindowMotion& p = prevMotion[j];
+            m.dx = rects[i].left - prevRects[j].left;
+            m.dy = rects[i].top - prevRects[j].top;
+            unsigned long long dt = now - p.seenAt;
+            if (!m.dx && !m.dy) continue;
+            if (dt == 0) { m.velX = p.velX; m.velY = p.velY; continue; }
+            float vx = (float)m.dx / dt, vy = (float)m.dy / dt;
+            // Average with the last estimate only while the motion is continuous
+            bool fresh = (p.velX == 0 && p.velY == 0) || dt > (unsigned long long)Config::WINDOW_VELOCITY_MS;
+            m.velX = fresh ? vx : (p.velX + vx) * 0.5f;
+            m.velY = fresh ? vy : (p.velY + vy) * 0.5f;
+        }
+
+        lastRects.assign(rects.begin(), rects.end());
+        table.Build(ids);
+    }
+
+    // Snapshot index of 'id', -1 once it is gone. 'hint': where it was last time.
+    int IndexOf(WindowId id, int hint = -1) const { return table.Find(ids, id, hint); }
+
+    // Where window i's top-left should be at 'now': as last enumerated, carried
+    // on at its velocity for up to WINDOW_PREDICT_MS and held there after that
+    // (going back to the stale rect would snap whatever rides on it back too).
+    // The next enumeration corrects it. True if that is a guess.
+    bool Predict(int i, unsigned long long now, long& left, long& top) const {
+        const WindowMotion& m = motion[i];
+        left = lastRects[i].left;
+        top = lastRects[i].top;
+        unsigned long long age = now - m.seenAt;
+        if (age == 0 || (m.velX == 0 && m.velY == 0)) return false;
+        if (age > (unsigned long long)Config::WINDOW_PREDICT_MS) age = Config::WINDOW_PREDICT_MS;
+        left += std::lround(m.velX * age);
+        top += std::lround(m.velY * age);
+        return true;
+    }
+
+private:
+    static const WindowId SYNTHETIC = 1ull << 63;   // Ids we made up, never an HWND
+
+    // id -> index, linear probing over 2x as many slots as windows
+    struct IdTable {
+        std::vector<int> slots;         // index + 1, 0 = empty
+        int bits = 0;
+
+        static size_t Hash(WindowId id, int bits) { return (size_t)((id * 0x9E3779B97F4A7C15ull) >> (64 - bits)); }
+
+        void Build(const std::vector<WindowId>& ids) {
+            bits = 4;
+            while ((1u << bits) < ids.size() * 2) bits++;
+            slots.assign((size_t)1 << bits, 0);
+            size_t mask = slots.size() - 1;
+            for (size_t i = 0; i < ids.size(); i++) {
+                size_t h = Hash(ids[i], bits);
+                while (slots[h]) h = (h + 1) & mask;
+                slots[h] = (int)i + 1;
+            }
+        }
+
+        int Find(const std::vector<WindowId>& ids, WindowId id, int hint) const {
+            if (hint >= 0 && hint < (int)ids.size() && ids[hint] == id) return hint;
+            if (slots.empty()) return -1;
+            size_t mask = slots.size() - 1;
+            for (size_t h = Hash(id, bits); slots[h]; h = (h + 1) & mask) {
+                if (ids[slots[h] - 1] == id) return slots[h] - 1;
+            }
+            return -1;
+        }
+    };
+
+    std::vector<RectArea> lastRects, prevRects;
+    std::vector<WindowId> prevIds;
+    std::vector<WindowMotion> prevMotion;
+    IdTable table, prevTable;
+    std::vector<int> match;             // Previous index per window, -1 if new
+    std::vector<char> taken;
+    WindowId nextId = 1;
+
+    static bool Same(const RectArea& a, const RectArea& b) {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+
+    void MatchByShape(const std::vector<RectArea>& rects) {
+        size_t n = rects.size(), prevN = prevRects.size();
+        taken.assign(prevN, 0);
+        size_t missing = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (i < prevN && Same(rects[i], prevRects[i])) { match[i] = (int)i; taken[i] = 1; }
+            else missing++;
+        }
+        if (!missing) return;
+
+        // Same rect in another z-slot: raised or lowered (which moves at least two)
+        if (missing > 1) {
+            std::map<std::tuple<long, long, long, long>, std::vector<int>> where;
+            for (int j = (int)prevN - 1; j >= 0; j--) {
+                if (!taken[j]) where[std::make_tuple(prevRects[j].left, prevRects[j].top, prevRects[j].right, prevRects[j].bottom)].push_back(j);
+            }
+            for (size_t i = 0; i < n; i++) {
+                if (match[i] != -1) continue;
+                auto it = where.find(std::make_tuple(rects[i].left, rects[i].top, rects[i].right, rects[i].bottom));
+                if (it == where.end() || it->second.empty()) continue;
+                match[i] = it->second.back();
+                it->second.pop_back();
+                taken[match[i]] = 1;
+            }
+        }
+
+        // Same slot and size somewhere else: dragged
+        for (size_t i = 0; i < n && i < prevN; i++) {
+            if (match[i] != -1 || taken[i]) continue;
+            if (rects[i].right - rects[i].left != prevRects[i].right - prevRects[i].left ||
+                rects[i].bottom - rects[i].top != prevRects[i].bottom - prevRects[i].top) continue;
+            match[i] = (int)i;
+            taken[i] = 1;
+            matchedByShape++;
+        }
+    }
+};
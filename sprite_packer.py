@@ -0,0 +1,98 @@
+from PIL import Image
+from concurrent.futures import ProcessPoolExecutor
+import os
+import re
+import struct
+import sys
+import time
+
+# Packs every assets/<name>_<index>.png into one sprite pack the app can
+# memory-map at startup (see SpritePack.h for the layout).
+
+PACK_VERSION = 1
+FRAME_PATTERN = re.compile(r"^(.+)_(\d+)\.png$", re.IGNORECASE)
+
+def discover_frames(folder):
+    # { "walk": [path_0, path_1, ...] } -- stops at the first gap, like the app
+    found = {}
+    for filename in os.listdir(folder):
+        match = FRAME_PATTERN.match(filename)
+        if match:
+            found.setdefault(match.group(1).lower(), {})[int(match.group(2))] = os.path.join(folder, filename)
+
+    animations = {}
+    for name, frames in sorted(found.items()):
+        paths = []
+        while len(paths) in frames:
+            paths.append(frames[len(paths)])
+        if paths:
+            animations[name] = paths
+    return animations
+
+def decode_frame(path):
+    # Premultiplied BGRA, which is what UpdateLayeredWindow wants
+    img = Image.open(path).convert("RGBA").convert("RGBa")
+    r, g, b, a = img.split()
+    bgra = Image.merge("RGBA", (b, g, r, a))
+    return img.width, img.height, bgra.tobytes()
+
+def align16(n):
+    return (n + 15) & ~15
+
+def write_pack(output_path, animations, decoded):
+    anim_count = len(animations)
+    frame_count = sum(len(paths) for paths in animations.values())
+
+    header_size = 16 + anim_count * 40 + frame_count * 16
+    offset = align16(header_size)
+
+    anim_table = b""
+    frame_table = b""
+    blobs = []
+    first = 0
+    for name, paths in animations.items():
+        anim_table += struct.pack("<32sII", name.encode("utf-8")[:31], first, len(paths))
+        first += len(paths)
+        for path in paths:
+            width, height, pixels = decoded[path]
+            frame_table += struct.pack("<IIQ", width, height, offset)
+            blobs.append((offset, pixels))
+            offset = align16(offset + len(pixels))
+
+    with open(output_path, "wb") as f:
+        f.write(struct.pack("<4sIII", b"DWPK", PACK_VERSION, anim_count, frame_count))
+        f.write(anim_table)
+        f.write(frame_table)
+        for blob_offset, pixels in blobs:
+            f.write(b"\0" * (blob_offset - f.tell()))
+            f.write(pixels)
+
+def pack_folder(folder, output_path):
+    start = time.perf_counter()
+    animations = discover_frames(folder)
+    paths = [p for frames in animations.values() for p in frames]
+    if not paths:
+        print(f"Error: no <name>_<index>.png frames found in {folder}")
+        return
+
+    # PNG decode dominates, so spread it over every core
+    with ProcessPoolExecutor() as pool:
+        decoded = dict(zip(paths, pool.map(decode_frame, paths)))
+    decode_time = time.perf_counter() - start
+
+    write_pack(output_path, animations, decoded)
+    total_time = time.perf_counter() - start
+
+    for name, frames in animations.items():
+        print(f"  {name}: {len(frames)} frames")
+    print(f"Packed {len(paths)} frames into {output_path} "
+          f"({os.path.getsize(output_path) // 1024} KB) in {total_time * 1000:.0f} ms "
+          f"(decode {decode_time * 1000:.0f} ms)")
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("Usage: python sprite_packer.py <assets_folder> [output.pack]")
+    else:
+        folder = sys.argv[1]
+        output = sys.argv[2] if len(sys.argv) > 2 else os.path.join(folder, "sprites.pack")
+        pack_folder(folder, output)